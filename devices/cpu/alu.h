@@ -0,0 +1,671 @@
+/*
+  This file is part of MSP430 Emulator
+
+  MSP430 Emulator is free software: you can redistribute it and/or
+  modify it under the terms of the GNU General Public License as
+  published by the Free Software Foundation, either version 3 of the
+  License, or (at your option) any later version.
+
+  MSP430 Emulator is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with MSP430 Emulator.
+  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+//##########+++ Instruction Execution Units +++##########
+//# The operation part of every instruction, shared by the
+//# reference decoder and the predecoded execute stage.
+//# Operands have already been resolved by the caller.
+//########################################################
+
+#ifndef _ALU_H_
+#define _ALU_H_
+
+#include "../utilities.h"
+#include "flag_handler.h"
+#include "msp430.h"
+#include "opcodes.h"
+#include "registers.h"
+
+/* Specialized handlers rely on inlining to fold constant arguments, which
+ * only pays off in optimized builds */
+#ifdef __OPTIMIZE__
+#define ALWAYS_INLINE inline __attribute__((always_inline))
+#else
+#define ALWAYS_INLINE inline
+#endif
+
+/**
+ * @brief Write back the result of a Format I operation
+ * @param mask Truncate register writes to the low byte in byte mode
+ */
+static ALWAYS_INLINE void alu_write_back(Cpu *cpu, int16_t result,
+                                         uint8_t bw_flag, bool mask,
+                                         bool is_daddr_virtual,
+                                         uint16_t dest_vaddress,
+                                         uint16_t *destination_addr) {
+  if (is_daddr_virtual) {
+    mem_write(&cpu->mcu->bus, dest_vaddress, result, bw_flag);
+  } else {
+    *destination_addr = (mask && bw_flag) ? result & 0xFF : result;
+    register_write_notify(cpu, 1);
+  }
+}
+
+/**
+ * @brief Set C, Z, N and V from a flag-producing Format I operation. With
+ * MSP430_LAZY_FLAGS the operation is only recorded, and the flags are
+ * evaluated when something reads them, see sync_sr()
+ * @param kind FLAGS_ADD, FLAGS_SUB, FLAGS_LOGIC or FLAGS_XOR
+ * @param carry_in Carry into the addition (subtraction: 1 for no borrow)
+ */
+static ALWAYS_INLINE void alu_set_flags(Cpu *cpu, uint8_t kind,
+                                        uint8_t bw_flag, int16_t dest_value,
+                                        int16_t source_value, bool carry_in,
+                                        int16_t result) {
+  cpu->flags.kind = kind;
+  cpu->flags.bw_flag = bw_flag;
+  cpu->flags.carry_in = carry_in;
+  cpu->flags.dst = dest_value;
+  cpu->flags.src = source_value;
+  cpu->flags.result = result;
+
+#ifndef MSP430_LAZY_FLAGS
+  evaluate_flags(cpu);
+#endif
+}
+
+/**
+ * @brief XOR and AND set flags before their write back. A write back to SR
+ * has to replace the flags, so they can't stay pending
+ */
+static inline void alu_sync_before_write_back(Cpu *cpu, bool is_daddr_virtual,
+                                              uint16_t *destination_addr) {
+  if (!is_daddr_virtual && destination_addr == &cpu->sr) {
+    sync_sr(cpu);
+  }
+}
+
+/**
+ * @brief Execute the operation of a Format I (double operand) instruction
+ * @param cpu A pointer to the CPU structure
+ * @param opcode Format I opcode (OP_MOV ... OP_AND)
+ * @param bw_flag Byte or Word flag
+ * @param source_value Resolved source operand
+ * @param dest_value Resolved destination operand (unused for MOV)
+ * @param is_daddr_virtual Destination is in memory rather than a register
+ * @param dest_vaddress Destination address if is_daddr_virtual
+ * @param destination_addr Destination register if !is_daddr_virtual
+ */
+static ALWAYS_INLINE void alu_formatI(Cpu *cpu, uint8_t opcode,
+                                      uint8_t bw_flag, int16_t source_value,
+                                      int16_t dest_value, bool is_daddr_virtual,
+                                      uint16_t dest_vaddress,
+                                      uint16_t *destination_addr) {
+  int16_t result;
+
+  switch (opcode) {
+
+  /* MOV SOURCE, DESTINATION
+   *   Ex: MOV #4, R6
+   *
+   * SOURCE = DESTINATION
+   *
+   * The source operand is moved to the destination. The source operand is
+   * not affected. The previous contents of the destination are lost.
+   *
+   */
+  case OP_MOV: {
+    result = bw_flag ? source_value & 0xFF : source_value;
+    alu_write_back(cpu, result, bw_flag, false, is_daddr_virtual,
+                   dest_vaddress, destination_addr);
+    break;
+  }
+
+    /* ADD SOURCE, DESTINATION
+     *   Ex: ADD R5, R4
+     *
+     * The source operand is added to the destination operand. The source op
+     * is not affected. The previous contents of the destination are lost.
+     *
+     * DESTINATION = SOURCE + DESTINATION
+     *
+     * N: Set if result is negative, reset if positive
+     * Z: Set if result is zero, reset otherwise
+     * C: Set if there is a carry from the result, cleared if not
+     * V: Set if an arithmetic overflow occurs, otherwise reset
+     *
+     */
+  case OP_ADD: {
+    if (bw_flag) {
+      dest_value = truncate_byte(dest_value);
+      source_value = truncate_byte(source_value);
+    }
+
+    result = dest_value + source_value;
+    alu_write_back(cpu, result, bw_flag, false, is_daddr_virtual,
+                   dest_vaddress, destination_addr);
+
+    alu_set_flags(cpu, FLAGS_ADD, bw_flag, dest_value, source_value, 0, result);
+    break;
+  }
+
+    /* ADDC SOURCE, DESTINATION
+     *   Ex: ADDC R5, R4
+     *
+     * DESTINATION += (SOURCE + C)
+     *
+     * N: Set if result is negative, reset if positive
+     * Z: Set if result is zero, reset otherwise
+     * C: Set if there is a carry from the result, cleared if not
+     * V: Set if an arithmetic overflow occurs, otherwise reset
+     *
+     */
+  case OP_ADDC: {
+    if (bw_flag) {
+      dest_value = truncate_byte(dest_value);
+      source_value = truncate_byte(source_value);
+    }
+
+    result = source_value + dest_value + get_carry(cpu);
+    alu_write_back(cpu, result, bw_flag, true, is_daddr_virtual,
+                   dest_vaddress, destination_addr);
+
+    alu_set_flags(cpu, FLAGS_ADD, bw_flag, dest_value, source_value,
+                  get_carry(cpu), result);
+    break;
+  }
+
+    /* SUBC SOURCE, DESTINATION
+     *   Ex: SUB R4, R5
+     *
+     *   DST += ~SRC + C
+     *
+     *  N: Set if result is negative, reset if positive
+     *  Z: Set if result is zero, reset otherwise
+     *  C: Set if there is a carry from the MSB of the result, reset otherwise.
+     *     Set to 1 if no borrow, reset if borrow.
+     *  V: Set if an arithmetic overflow occurs, otherwise reset
+     *
+     *
+     */
+  case OP_SUBC: {
+    if (bw_flag) {
+      dest_value = truncate_byte(dest_value);
+      source_value = truncate_byte(source_value);
+    }
+
+    result = (~source_value) + get_carry(cpu) + dest_value;
+    alu_write_back(cpu, result, bw_flag, true, is_daddr_virtual,
+                   dest_vaddress, destination_addr);
+
+    alu_set_flags(cpu, FLAGS_SUB, bw_flag, dest_value, source_value,
+                  get_carry(cpu), result);
+    break;
+  }
+
+    /* SUB SOURCE, DESTINATION
+     *   Ex: SUB R4, R5
+     *
+     *   DST -= SRC
+     *
+     *  N: Set if result is negative, reset if positive
+     *  Z: Set if result is zero, reset otherwise
+     *  C: Set if there is a carry from the MSB of the result, reset otherwise.
+     *     Set to 1 if no borrow, reset if borrow.
+     *  V: Set if an arithmetic overflow occurs, otherwise reset
+     */
+  case OP_SUB: {
+    if (bw_flag) {
+      dest_value = truncate_byte(dest_value);
+      source_value = truncate_byte(source_value);
+    }
+
+    result = dest_value - source_value;
+    alu_write_back(cpu, result, bw_flag, true, is_daddr_virtual,
+                   dest_vaddress, destination_addr);
+
+    alu_set_flags(cpu, FLAGS_SUB, bw_flag, dest_value, source_value, 1, result);
+    break;
+  }
+
+    /* CMP SOURCE, DESTINATION
+     *
+     * N: Set if result is negative, reset if positive (src ≥ dst)
+     * Z: Set if result is zero, reset otherwise (src = dst)
+     * C: Set if there is a carry from the MSB of the result, reset otherwise
+     * V: Set if an arithmetic overflow occurs, otherwise reset
+     * TODO: Fix overflow error
+     */
+  case OP_CMP: {
+    if (bw_flag) {
+      dest_value = truncate_byte(dest_value);
+      source_value = truncate_byte(source_value);
+    }
+
+    result = dest_value - source_value;
+
+    alu_set_flags(cpu, FLAGS_SUB, bw_flag, dest_value, source_value, 1, result);
+    break;
+  }
+
+    /* DADD SOURCE, DESTINATION
+     *
+     */
+  case OP_DADD: { /* Halt, see cpu_halted() */
+    fprintf(stderr, "ERROR: DADD INSTRUCTION NOT IMPLEMENTED\n");
+    cpu->running = false;
+    break;
+  }
+
+    /* BIT SOURCE, DESTINATION
+     *
+     * N: Set if MSB of result is set, reset otherwise
+     * Z: Set if result is zero, reset otherwise
+     * C: Set if result is not zero, reset otherwise (.NOT. Zero)
+     * V: Reset
+     */
+  case OP_BIT: {
+    result = source_value & dest_value;
+    alu_set_flags(cpu, FLAGS_LOGIC, bw_flag, dest_value, source_value, 0,
+                  result);
+    break;
+  }
+
+    /* BIC SOURCE, DESTINATION
+     *
+     * No status bits affected
+     */
+  case OP_BIC: {
+    result = dest_value & ~source_value;
+    alu_write_back(cpu, result, bw_flag, true, is_daddr_virtual,
+                   dest_vaddress, destination_addr);
+    break;
+  }
+
+    /* BIS SOURCE, DESTINATION
+     * No flags affected
+     */
+  case OP_BIS: {
+    result = dest_value | source_value;
+    alu_write_back(cpu, result, bw_flag, true, is_daddr_virtual,
+                   dest_vaddress, destination_addr);
+    break;
+  }
+
+    /* XOR SOURCE, DESTINATION
+     *
+     * N: Set if result MSB is set, reset if not set
+     * Z: Set if result is zero, reset otherwise
+     * C: Set if result is not zero, reset otherwise ( = .NOT. Zero)
+     * V: Set if both operands are negative
+     */
+  case OP_XOR: {
+    result = dest_value ^ source_value;
+
+    alu_set_flags(cpu, FLAGS_XOR, bw_flag, dest_value, source_value, 0,
+                  result);
+    alu_sync_before_write_back(cpu, is_daddr_virtual, destination_addr);
+
+    alu_write_back(cpu, result, bw_flag, true, is_daddr_virtual,
+                   dest_vaddress, destination_addr);
+    break;
+  }
+
+    /* AND SOURCE, DESTINATION
+     *
+     *  N: Set if result MSB is set, reset if not set
+     *  Z: Set if result is zero, reset otherwise
+     *  C: Set if result is not zero, reset otherwise ( = .NOT. Zero)
+     *  V: Reset
+     */
+  case OP_AND: {
+    result = dest_value & source_value;
+
+    alu_set_flags(cpu, FLAGS_LOGIC, bw_flag, dest_value, source_value, 0,
+                  result);
+    alu_sync_before_write_back(cpu, is_daddr_virtual, destination_addr);
+
+    alu_write_back(cpu, result, bw_flag, true, is_daddr_virtual,
+                   dest_vaddress, destination_addr);
+    break;
+  }
+  default: {
+    fprintf(stderr, "INVALID FORMAT I OPCODE, EXITING.");
+    exit(1);
+  }
+
+  } //# End of switch
+}
+
+/**
+ * @brief Execute the operation of a Format II (single operand) instruction
+ * @param cpu A pointer to the CPU structure
+ * @param opcode Format II opcode (OP_RRC ... OP_RETI)
+ * @param bw_flag Byte or Word flag
+ * @param source_value Resolved operand
+ * @param is_saddr_virtual Operand is in memory rather than a register
+ * @param source_vaddress Operand address if is_saddr_virtual
+ * @param source_address Operand register if !is_saddr_virtual
+ * @return true if the instruction wrote PC
+ */
+static ALWAYS_INLINE bool alu_formatII(Cpu *cpu, uint8_t opcode,
+                                       uint8_t bw_flag, int16_t source_value,
+                                       bool is_saddr_virtual,
+                                       uint16_t source_vaddress,
+                                       uint16_t *source_address) {
+  bus_t *bus = &cpu->mcu->bus;
+  int16_t result;
+  bool c, z, n, v;
+
+  switch (opcode) {
+
+  /*  RRC Rotate right through carry
+   *    C → MSB → MSB-1 .... LSB+1 → LSB → C
+   *
+   *  Description The destination operand is shifted right one position
+   *  as shown in Figure 3-18. The carry bit (C) is shifted into the MSB,
+   *  the LSB is shifted into the carry bit (C).
+   *
+   * N: Set if result is negative, reset if positive
+   * Z: Set if result is zero, reset otherwise
+   * C: Loaded from the LSB
+   * V: Reset
+   */
+  case OP_RRC: {
+    uint16_t CF = get_carry(cpu);
+
+    result = source_value;
+    result >>= 1;
+
+    if (bw_flag == WORD) {
+      result &= ~(1u << 15); // Clear MSB
+      result |= (CF << 15);  // Insert carry on MSB
+
+    } else if (bw_flag == BYTE) {
+      result &= ~(1u << 7); // Clear MSB
+      result |= (CF << 7);  // Insert carry on MSB
+    }
+
+    if (is_saddr_virtual) { // Write result to memory
+      mem_write(bus, source_vaddress, result, bw_flag);
+    } else { // Write result to register
+      *source_address = bw_flag ? result & 0xFF : result;
+      register_write_notify(cpu, 1);
+    }
+
+    c = source_value & 1u; // set next c from LSB
+    n = CF;                // Previous CF is now MSB
+    z = is_zero(result, bw_flag);
+    v = false;
+    set_sr_flags(cpu, c, z, n, v);
+    break;
+  }
+
+    /* SWPB Swap bytes
+     * bw flag always 0 (word)
+     * Bits 15 to 8 ↔ bits 7 to 0
+     * No flags affected
+     */
+  case OP_SWPB: {
+    uint16_t upper, lower;
+
+    upper = (source_value & 0xFF00);
+    lower = (source_value & 0x00FF);
+    result = (lower << 8) | (upper >> 8);
+
+    if (is_saddr_virtual) { // Write result to memory
+      mem_write(bus, source_vaddress, result, WORD);
+    } else { // Write result to register
+      *source_address = result;
+      register_write_notify(cpu, 1);
+    }
+    break;
+  }
+
+    /* RRA Rotate right arithmetic
+     *   MSB → MSB, MSB → MSB-1, ... LSB+1 → LSB, LSB → C
+     *
+     * N: Set if result is negative, reset if positive
+     * Z: Set if result is zero, reset otherwise
+     * C: Loaded from the LSB
+     * V: Reset
+     */
+  case OP_RRA: {
+    if (bw_flag == WORD) {
+      result = (source_value & (1 << 15)) | // MSB
+               (source_value >> 1);
+    } else {
+      result = (source_value & (1 << 7)) | // MSB
+               (source_value >> 1);
+    }
+
+    if (is_saddr_virtual) { // Write result to memory
+      mem_write(bus, source_vaddress, result, bw_flag);
+    } else { // Write result to register
+      *source_address = bw_flag ? result & 0xFF : result;
+      register_write_notify(cpu, 1);
+    }
+
+    c = source_value & 1;
+    v = false;
+    n = is_negative(result, bw_flag);
+    z = is_zero(result, bw_flag);
+    set_sr_flags(cpu, c, z, n, v);
+    break;
+  }
+
+    /* SXT Sign extend byte to word
+     *   bw flag always 0 (word)
+     *
+     * Bit 7 → Bit 8 ......... Bit 15
+     *
+     * N: Set if result is negative, reset if positive
+     * Z: Set if result is zero, reset otherwise
+     * C: Set if result is not zero, reset otherwise (.NOT. Zero)
+     * V: Reset
+     */
+  case OP_SXT: {
+    result = (source_value & (1 << 7)) ? source_value | 0xFF00
+                                       : source_value & 0x00FF;
+
+    if (is_saddr_virtual) { // Write result to memory
+      mem_write(bus, source_vaddress, result, WORD);
+    } else { // Write result to register
+      *source_address = result;
+      register_write_notify(cpu, 1);
+    }
+
+    z = is_zero(result, bw_flag);
+    n = is_negative(result, bw_flag);
+    c = !z;
+    v = false;
+    set_sr_flags(cpu, c, z, n, v);
+    break;
+  }
+
+    /* PUSH push value on to the stack
+     *
+     *   SP - 2 → SP
+     *   src → @SP
+     *
+     */
+  case OP_PUSH: {
+    cpu->sp -= 2; /* Yes, even for BYTE Instructions */
+    register_write_notify(cpu, 1);
+
+    // Write result to memory
+    mem_write(bus, cpu->sp, source_value, bw_flag);
+    break;
+  }
+
+    /* CALL SUBROUTINE:
+     *     PUSH PC and PC = SRC
+     *
+     *     This is always a word instruction. Supporting all addressing modes
+     */
+  case OP_CALL: {
+    // Push PC
+    cpu->sp -= 2;
+    register_write_notify(cpu, 1);
+    mem_write(bus, cpu->sp, cpu->pc, WORD);
+
+    // Jump
+    cpu->pc = source_value;
+    register_write_notify(cpu, 1);
+    return true;
+  }
+
+    //# RETI Return from interrupt: Pop SR then pop PC
+  case OP_RETI: {
+    uint16_t frame[2]; /* SR, then PC, read in one burst */
+
+    mem_read_words(bus, cpu->sp, frame, 2);
+
+    // 1 Pop SR from the stack, replacing any pending flags
+    cpu->flags.kind = FLAGS_NONE;
+    cpu->sr = frame[0];
+    cpu->sp += 2;
+    register_write_notify(cpu, 2);
+
+    // 2 Pop PC from stack
+    cpu->pc = frame[1];
+    cpu->sp += 2;
+    register_write_notify(cpu, 2);
+    return true;
+  }
+  default: { /* Halt, see cpu_halted() */
+    fprintf(stderr, "INVALID FORMAT II OPCODE, HALTING.\n");
+    cpu->running = false;
+    break;
+  }
+
+  } //# End of Switch
+
+  return false;
+}
+
+/**
+ * @brief Evaluate the condition of a Format III (jump) instruction
+ * @param cpu A pointer to the CPU structure
+ * @param condition The 3-bit condition field
+ * @return true if the jump is taken
+ */
+static inline bool alu_jump_taken(Cpu *cpu, uint8_t condition) {
+  switch (condition) {
+
+  /* JNE/JNZ Jump if not equal/zero
+   *
+   * If Z = 0: PC + 2 offset → PC
+   * If Z = 1: execute following instruction
+   */
+  case 0x0:
+    return get_zero_flag(cpu) == false;
+
+    /* JEQ/JZ Jump is equal/zero
+     * If Z = 1: PC + 2 offset → PC
+     * If Z = 0: execute following instruction
+     */
+  case 0x1:
+    return get_zero_flag(cpu) == true;
+
+    /* JNC/JLO Jump if no carry/lower
+     *
+     *  if C = 0: PC + 2 offset → PC
+     *  if C = 1: execute following instruction
+     */
+  case 0x2:
+    return get_carry(cpu) == false;
+
+    /* JC/JHS Jump if carry/higher or same
+     *
+     * If C = 1: PC + 2 offset → PC
+     * If C = 0: execute following instruction
+     */
+  case 0x3:
+    return get_carry(cpu) == true;
+
+    /* JN Jump if negative
+     *
+     *  if N = 1: PC + 2 ×offset → PC
+     *  if N = 0: execute following instruction
+     */
+  case 0x4:
+    return get_negative_flag(cpu) == true;
+
+    /* JGE Jump if greater or equal (N == V)
+     *
+     *  If (N .XOR. V) = 0 then jump to label: PC + 2 P offset → PC
+     *  If (N .XOR. V) = 1 then execute the following instruction
+     */
+  case 0x5:
+    return (get_negative_flag(cpu) ^ get_overflow_flag(cpu)) == false;
+
+    /* JL Jump if less (N != V)
+     *
+     *  If (N .XOR. V) = 1 then jump to label: PC + 2 offset → PC
+     *  If (N .XOR. V) = 0 then execute following instruction
+     */
+  case 0x6:
+    return (get_negative_flag(cpu) ^ get_overflow_flag(cpu)) == true;
+
+    /* JMP Jump Unconditionally
+     *
+     *  PC + 2 × offset → PC
+     *
+     */
+  default:
+    return true;
+  }
+}
+
+/**
+ * @brief Test a jump condition against the flags of a pending operation
+ * without evaluating the flags it does not test, see lazy_flags_t
+ * @param f The pending operation
+ * @param kind f->kind, as a constant for the compiler to fold
+ * @param condition Format III condition
+ */
+static ALWAYS_INLINE bool alu_pending_jump_taken(const lazy_flags_t *f,
+                                                 uint8_t kind,
+                                                 uint8_t condition) {
+  bool c, n, v;
+
+  switch (condition) {
+  case 0x0:
+    return !is_zero(f->result, f->bw_flag);
+  case 0x1:
+    return is_zero(f->result, f->bw_flag);
+  case 0x2:
+  case 0x3:
+    if (kind == FLAGS_ADD) {
+      c = is_add_carry(f->dst, f->src, f->carry_in, f->bw_flag);
+    } else if (kind == FLAGS_SUB) {
+      c = is_sub_carry(f->dst, f->src, f->carry_in, f->bw_flag);
+    } else { /* C = !Z */
+      c = !is_zero(f->result, f->bw_flag);
+    }
+    return condition == 0x3 ? c : !c;
+  case 0x4:
+    return is_negative(f->result, f->bw_flag);
+  case 0x5:
+  case 0x6:
+    n = is_negative(f->result, f->bw_flag);
+    if (kind == FLAGS_ADD) {
+      v = is_add_overflow(f->dst, f->src, f->carry_in, f->bw_flag);
+    } else if (kind == FLAGS_SUB) {
+      v = is_sub_overflow(f->dst, f->src, f->carry_in, f->bw_flag);
+    } else {
+      v = false;
+    }
+    return condition == 0x6 ? n ^ v : !(n ^ v);
+  default:
+    return true;
+  }
+}
+
+#endif
@@ -0,0 +1,164 @@
+/*
+  This file is part of MSP430 Emulator
+
+  MSP430 Emulator is free software: you can redistribute it and/or
+  modify it under the terms of the GNU General Public License as
+  published by the Free Software Foundation, either version 3 of the
+  License, or (at your option) any later version.
+
+  MSP430 Emulator is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with MSP430 Emulator.
+  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+//##########+++ Basic Block Cache +++##########
+//# Blocks are built from the predecoded instruction cache
+//# and copied into a pool. When the pool is exhausted all
+//# blocks are dropped and rebuilt on demand.
+//#############################################
+
+#include "block.h"
+#include "fusion.h"
+#include "jit.h"
+#include "msp430.h"
+#include "opcodes.h"
+#include "profiler.h"
+
+/* Longest span of memory a block can cover */
+#define MAX_BLOCK_BYTES (MAX_BLOCK_OPS * 6)
+
+bool ends_block(const decoded_op_t *op) {
+  switch (op->format) {
+  case 1:
+    return op->dst_mode == MODE_REGISTER && op->destination == REG_PC;
+  case 2:
+    if (op->opcode == OP_PUSH) {
+      return false;
+    } else if (op->opcode >= OP_CALL) { /* CALL, RETI, invalid */
+      return true;
+    }
+    return op->src_mode == MODE_REGISTER && op->source == REG_PC;
+  default: /* Jumps */
+    return true;
+  }
+}
+
+static basic_block_t *build_block(msp430_t *mcu, uint16_t address) {
+  basic_block_t *block;
+  uint16_t pc = address;
+  uint16_t count = 0;
+
+  if (mcu->blocks_used == MAX_BLOCKS ||
+      mcu->pool_used + MAX_BLOCK_OPS > BLOCK_POOL_OPS) {
+    flush_blocks(mcu);
+  }
+
+  block = &mcu->blocks[mcu->blocks_used];
+  block->ops = &mcu->block_pool[mcu->pool_used];
+  block->reg_reads = block->cycles = 0;
+  block->hits = 0;
+  block->native = NULL;
+
+  while (count < MAX_BLOCK_OPS) {
+    const decoded_op_t *op = get_decoded_op(mcu, pc);
+
+    if (op->handler == 0) { /* Left to the reference decoder */
+      break;
+    }
+
+    block->ops[count++] = *op;
+    block->reg_reads += op->reg_reads;
+    block->cycles += op->cycles;
+    pc += 2 * op->length;
+
+    if (ends_block(op)) {
+      break;
+    }
+  }
+
+  if (count == 0) {
+    return NULL;
+  }
+
+#ifdef MSP430_FUSION
+  fuse_ops(block->ops, count);
+#endif
+
+  block->address = address;
+  block->end = pc;
+  block->count = count;
+  mcu->blocks_used++;
+  mcu->pool_used += count;
+  mcu->block_map[address >> 1] = block;
+  return block;
+}
+
+basic_block_t *get_block(msp430_t *mcu, uint16_t address) {
+  basic_block_t *block = mcu->block_map[address >> 1];
+  return block ? block : build_block(mcu, address);
+}
+
+void charge_block(Cpu *cpu, const basic_block_t *block, uint16_t executed) {
+  uint16_t reg_reads = block->reg_reads, cycles = block->cycles;
+  uint16_t i;
+
+  if (executed < block->count) {
+    reg_reads = cycles = 0;
+    for (i = 0; i < executed; i++) {
+      reg_reads += block->ops[i].reg_reads;
+      cycles += block->ops[i].cycles;
+    }
+  }
+
+  register_read_notify(cpu, reg_reads);
+  if (cycles) {
+    consume_cycles(cpu, cycles);
+  }
+#ifdef MSP430_PROFILER
+  if (cpu->mcu->profile != NULL) {
+    profile_block(cpu, block, executed);
+  }
+#endif
+}
+
+void invalidate_blocks(msp430_t *mcu, uint16_t address, size_t len) {
+  /* Blocks starting up to MAX_BLOCK_BYTES before the write may cover it */
+  uint32_t first = (address & ~1u) + 0x10000 - (MAX_BLOCK_BYTES - 2);
+  uint32_t last = (uint32_t)address + 0x10000 + len - 1;
+  uint32_t a;
+
+  if (len >= 0x10000) {
+    flush_blocks(mcu);
+    return;
+  }
+
+  for (a = first; a <= last; a += 2) {
+    basic_block_t *block = mcu->block_map[(a & 0xFFFF) >> 1];
+
+    if (block == NULL) {
+      continue;
+    }
+
+    /* Either the write starts inside the block, or the block starts inside
+     * the write */
+    if ((uint16_t)(address - block->address) <
+            (uint16_t)(block->end - block->address) ||
+        (uint16_t)(block->address - address) < len) {
+      mcu->block_map[(a & 0xFFFF) >> 1] = NULL;
+      mcu->block_generation++;
+    }
+  }
+}
+
+void flush_blocks(msp430_t *mcu) {
+  memset(mcu->block_map, 0, sizeof mcu->block_map);
+  mcu->blocks_used = 0;
+  mcu->pool_used = 0;
+  mcu->block_generation++;
+  jit_flush(mcu);
+}
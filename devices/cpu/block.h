@@ -0,0 +1,85 @@
+/*
+  This file is part of MSP430 Emulator
+
+  MSP430 Emulator is free software: you can redistribute it and/or
+  modify it under the terms of the GNU General Public License as
+  published by the Free Software Foundation, either version 3 of the
+  License, or (at your option) any later version.
+
+  MSP430 Emulator is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with MSP430 Emulator.
+  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef _BLOCK_H_
+#define _BLOCK_H_
+
+#include "predecode.h"
+#include "registers.h"
+#include <stdbool.h>
+
+#define MAX_BLOCK_OPS 32
+
+/* Size of the block cache of an MCU, see msp430.h */
+#define MAX_BLOCKS 4096
+#define BLOCK_POOL_OPS (MAX_BLOCKS * 8)
+
+/* A basic block: straight-line predecoded instructions, ending at a jump,
+ * CALL, RETI, any other write to PC, or MAX_BLOCK_OPS */
+typedef struct basic_block {
+  uint16_t address;   /* Address of the first instruction */
+  uint16_t end;       /* Address following the last instruction */
+  uint16_t count;     /* Number of instructions */
+  uint16_t reg_reads; /* Sum of the static register read notifications */
+  uint16_t cycles;    /* Sum of the cycles of its instructions */
+  uint16_t hits;      /* Times run, counted by the JIT up to its threshold */
+  decoded_op_t *ops;  /* The instructions, in order */
+  uint16_t (*native)(Cpu *cpu); /* Translated code, see jit.h */
+} basic_block_t;
+
+/**
+ * @brief Check if a predecoded instruction ends a basic block
+ * @param op The predecoded instruction
+ * @return true for jumps, CALL, RETI and other writes to PC
+ */
+bool ends_block(const decoded_op_t *op);
+
+/**
+ * @brief Look up the basic block starting at an (even) address, building it
+ * from the predecoded instruction cache on a miss
+ * @param mcu The MCU
+ * @param address Address of the first instruction
+ * @return The block, or NULL if the first instruction can't be part of one
+ */
+basic_block_t *get_block(msp430_t *mcu, uint16_t address);
+
+/**
+ * @brief Charge the static register read notifications and cycles of the
+ * first instructions of a block
+ * @param cpu A pointer to the CPU structure
+ * @param block The block
+ * @param executed Number of instructions of the block that ran
+ */
+void charge_block(Cpu *cpu, const basic_block_t *block, uint16_t executed);
+
+/**
+ * @brief Drop cached blocks overlapping a range of memory. Called from
+ * invalidate_decoded_ops()
+ * @param mcu The MCU
+ * @param address First byte written
+ * @param len Number of bytes written
+ */
+void invalidate_blocks(msp430_t *mcu, uint16_t address, size_t len);
+
+/**
+ * @brief Drop all cached blocks. Called from flush_decoded_ops()
+ * @param mcu The MCU
+ */
+void flush_blocks(msp430_t *mcu);
+
+#endif
@@ -0,0 +1,519 @@
+/*
+  This file is part of MSP430 Emulator
+
+  MSP430 Emulator is free software: you can redistribute it and/or
+  modify it under the terms of the GNU General Public License as
+  published by the Free Software Foundation, either version 3 of the
+  License, or (at your option) any later version.
+
+  MSP430 Emulator is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with MSP430 Emulator.
+  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+//##########+++ Checkpoint Files +++##########
+//# A checkpoint file is a header followed by records:
+//#   type (1 byte), payload length (4 bytes), payload
+//# Each checkpoint appends the pages that changed since the
+//# previous one, the registers, the pending interrupts and
+//# the registered state blocks, and ends with a COMMIT
+//# record holding a CRC-32 of its records. Records after
+//# the last intact COMMIT are ignored, so a process that
+//# dies while writing loses only that checkpoint.
+//#
+//# Pages are compressed with PackBits: a control byte n
+//# below 128 is followed by n + 1 literal bytes, one above
+//# 128 by a byte repeated 257 - n times.
+//############################################
+
+#include "checkpoint.h"
+#include "interrupt.h"
+#include "msp430.h"
+#include "snapshot.h"
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define HEADER_LEN (sizeof CHECKPOINT_MAGIC - 1 + 4)
+#define RECORD_HEADER_LEN 5
+#define RECORD_HEAD_MAX 34 /* Fixed fields before the payload of a record */
+
+/* Worst case of PackBits on a page, one control byte per 128 */
+#define PACKED_PAGE_MAX (MEM_PAGE_SIZE + (MEM_PAGE_SIZE + 127) / 128)
+
+enum {
+  RECORD_PAGE = 1,   /* Page number (2), packed contents */
+  RECORD_CPU,        /* R0-R15 (2 each), running (1) */
+  RECORD_INTERRUPTS, /* Asserted lines (2) */
+  RECORD_STATE,      /* Block index (4), contents */
+  RECORD_COMMIT,     /* Sequence number (8), CRC-32 of the records (4) */
+};
+
+static void put16(uint8_t *p, uint16_t v) {
+  p[0] = v;
+  p[1] = v >> 8;
+}
+
+static void put32(uint8_t *p, uint32_t v) {
+  put16(p, v);
+  put16(p + 2, v >> 16);
+}
+
+static uint16_t get16(const uint8_t *p) { return p[0] | p[1] << 8; }
+
+static uint32_t get32(const uint8_t *p) {
+  return get16(p) | (uint32_t)get16(p + 2) << 16;
+}
+
+static uint32_t crc32_update(uint32_t crc, const uint8_t *data, size_t len) {
+  int bit;
+
+  crc = ~crc;
+  while (len--) {
+    crc ^= *data++;
+    for (bit = 0; bit < 8; bit++) {
+      crc = (crc >> 1) ^ (0xEDB88320u & -(crc & 1));
+    }
+  }
+  return ~crc;
+}
+
+/* Length of the run of equal bytes at page[i], at most 128 */
+static size_t run_length(const uint8_t *page, size_t i) {
+  size_t run;
+
+  for (run = 1; i + run < MEM_PAGE_SIZE && run < 128 &&
+                page[i + run] == page[i];
+       run++) {
+  }
+  return run;
+}
+
+/* Runs of two stay in literals, as in Apple's PackBits: ending a literal for
+ * them can cost a header per two bytes, so that PACKED_PAGE_MAX would not
+ * hold */
+static size_t pack_page(const uint8_t *page, uint8_t *out) {
+  size_t i = 0, len = 0, run, literals;
+
+  while (i < MEM_PAGE_SIZE) {
+    run = run_length(page, i);
+    if (run > 2) {
+      out[len++] = 257 - run;
+      out[len++] = page[i];
+      i += run;
+      continue;
+    }
+
+    // Literals up to the next run of at least three
+    for (literals = 1; i + literals < MEM_PAGE_SIZE && literals < 128 &&
+                       run_length(page, i + literals) < 3;
+         literals++) {
+    }
+    out[len++] = literals - 1;
+    memcpy(&out[len], &page[i], literals);
+    len += literals;
+    i += literals;
+  }
+  return len;
+}
+
+static bool unpack_page(const uint8_t *in, size_t len, uint8_t *page) {
+  size_t i = 0, out = 0, n;
+
+  while (i < len) {
+    uint8_t control = in[i++];
+
+    if (control < 128) {
+      n = control + 1;
+      if (i + n > len || out + n > MEM_PAGE_SIZE) {
+        return false;
+      }
+      memcpy(&page[out], &in[i], n);
+      i += n;
+    } else if (control > 128) {
+      n = 257 - control;
+      if (i == len || out + n > MEM_PAGE_SIZE) {
+        return false;
+      }
+      memset(&page[out], in[i++], n);
+    } else {
+      continue;
+    }
+    out += n;
+  }
+  return out == MEM_PAGE_SIZE;
+}
+
+/*##########+++ Writing +++##########*/
+
+/* The record header and head go out in one write, the file is unbuffered */
+static bool write_record(checkpoint_t *ck, uint8_t type, const uint8_t *head,
+                         size_t head_len, const void *body, size_t body_len,
+                         uint32_t *crc) {
+  uint8_t header[RECORD_HEADER_LEN + RECORD_HEAD_MAX];
+
+  header[0] = type;
+  put32(&header[1], head_len + body_len);
+  memcpy(&header[RECORD_HEADER_LEN], head, head_len);
+  *crc = crc32_update(*crc, header, RECORD_HEADER_LEN + head_len);
+  *crc = crc32_update(*crc, body, body_len);
+
+  return fwrite(header, RECORD_HEADER_LEN + head_len, 1, ck->file) == 1 &&
+         (body_len == 0 || fwrite(body, 1, body_len, ck->file) == body_len);
+}
+
+bool write_checkpoint(checkpoint_t *ck, Cpu *cpu) {
+  const msp430_t *mcu = cpu->mcu;
+  uint8_t head[RECORD_HEAD_MAX], packed[PACKED_PAGE_MAX];
+  bool written[MEM_PAGES] = {false};
+  uint32_t crc = 0, i;
+  uint16_t page;
+  size_t len;
+  void *state;
+  bool ok;
+
+  /* After a failed checkpoint, the file may not end where it should */
+  ok = fseek(ck->file, ck->end, SEEK_SET) == 0;
+
+  for (page = 0; page < MEM_PAGES && ok; page++) {
+    const uint8_t *host = writable_host_page(&mcu->bus, page);
+    const uint8_t *shadow = ck->shadow + (page << MEM_PAGE_SHIFT);
+
+    if (host == NULL || (ck->stored[page] && !memcmp(host, shadow,
+                                                     MEM_PAGE_SIZE))) {
+      continue;
+    }
+    written[page] = true;
+
+    put16(head, page);
+    ok = write_record(ck, RECORD_PAGE, head, 2, packed,
+                      pack_page(host, packed), &crc);
+  }
+
+  sync_sr(cpu);
+  for (i = 0; i < 16; i++) {
+    put16(&head[2 * i], cpu->regs[i]);
+  }
+  head[32] = cpu->running;
+  ok = ok && write_record(ck, RECORD_CPU, head, 33, NULL, 0, &crc);
+
+  put16(head, mcu->interrupt_requests);
+  ok = ok && write_record(ck, RECORD_INTERRUPTS, head, 2, NULL, 0, &crc);
+
+  for (i = 0; (state = snapshot_state(mcu, i, &len)) != NULL && ok; i++) {
+    put32(head, i);
+    ok = write_record(ck, RECORD_STATE, head, 4, state, len, &crc);
+  }
+
+  // The commit record is not part of its own CRC
+  put32(head, ck->sequence);
+  put32(&head[4], ck->sequence >> 32);
+  put32(&head[8], crc);
+  ok = ok && write_record(ck, RECORD_COMMIT, head, 12, NULL, 0, &crc);
+
+  ok = ok && fflush(ck->file) == 0 && fsync(fileno(ck->file)) == 0;
+  if (!ok) {
+    /* Cut off the records of this checkpoint. The pages count as not
+     * stored, so the next checkpoint writes them again */
+    clearerr(ck->file);
+    if (ftruncate(fileno(ck->file), ck->end) != 0) {
+      fprintf(stderr, "Cannot cut off a failed checkpoint\n");
+    }
+    return false;
+  }
+
+  for (page = 0; page < MEM_PAGES; page++) {
+    if (written[page]) {
+      memcpy(ck->shadow + (page << MEM_PAGE_SHIFT),
+             writable_host_page(&mcu->bus, page), MEM_PAGE_SIZE);
+      ck->stored[page] = true;
+    }
+  }
+  ck->end = ftell(ck->file);
+  ck->sequence++;
+  return true;
+}
+
+/*##########+++ Reading +++##########*/
+
+/* The newest committed records in a mapped file */
+typedef struct checkpoint_view {
+  const uint8_t *pages[MEM_PAGES]; /* RECORD_PAGE payloads */
+  uint32_t page_len[MEM_PAGES];
+  const uint8_t *states[SNAPSHOT_STATES]; /* RECORD_STATE payloads */
+  uint32_t state_len[SNAPSHOT_STATES];
+  const uint8_t *cpu, *interrupts;
+  size_t end;        /* Just past the last COMMIT */
+  uint64_t sequence; /* Checkpoints committed */
+} checkpoint_view_t;
+
+static bool check_header(const uint8_t *file, size_t len) {
+  return len >= HEADER_LEN &&
+         !memcmp(file, CHECKPOINT_MAGIC, sizeof CHECKPOINT_MAGIC - 1) &&
+         get16(file + HEADER_LEN - 4) == CHECKPOINT_VERSION &&
+         get16(file + HEADER_LEN - 2) == MEM_PAGE_SIZE;
+}
+
+/* Walk the records, keeping those of complete checkpoints only. Returns
+ * false if memory could not be allocated, and the view is then empty */
+static bool scan_records(const uint8_t *file, size_t len,
+                         checkpoint_view_t *view) {
+  checkpoint_view_t *pending = malloc(sizeof *pending);
+  size_t pos = HEADER_LEN;
+  uint32_t crc = 0;
+
+  memset(view, 0, sizeof *view);
+  view->end = HEADER_LEN;
+  if (pending == NULL) {
+    return false;
+  }
+  *pending = *view;
+
+  while (len - pos >= RECORD_HEADER_LEN) {
+    const uint8_t *body = file + pos + RECORD_HEADER_LEN;
+    uint32_t body_len = get32(file + pos + 1);
+    uint8_t type = file[pos];
+
+    if (body_len > len - pos - RECORD_HEADER_LEN) {
+      break; /* Cut off */
+    }
+
+    if (type == RECORD_COMMIT) {
+      if (body_len != 12 || get32(body + 8) != crc) {
+        break;
+      }
+      pos += RECORD_HEADER_LEN + body_len;
+      pending->end = pos;
+      pending->sequence++;
+      *view = *pending;
+      crc = 0;
+      continue;
+    }
+
+    crc = crc32_update(crc, file + pos, RECORD_HEADER_LEN + body_len);
+    if (type == RECORD_PAGE && body_len >= 2 && get16(body) < MEM_PAGES) {
+      pending->pages[get16(body)] = body + 2;
+      pending->page_len[get16(body)] = body_len - 2;
+    } else if (type == RECORD_STATE && body_len >= 4 &&
+               get32(body) < SNAPSHOT_STATES) {
+      pending->states[get32(body)] = body + 4;
+      pending->state_len[get32(body)] = body_len - 4;
+    } else if (type == RECORD_CPU && body_len == 33) {
+      pending->cpu = body;
+    } else if (type == RECORD_INTERRUPTS && body_len == 2) {
+      pending->interrupts = body;
+    }
+    pos += RECORD_HEADER_LEN + body_len;
+  }
+  free(pending);
+  return true;
+}
+
+static const uint8_t *map_file(const char *path, size_t *len) {
+  struct stat st;
+  void *file;
+  int fd = open(path, O_RDONLY);
+
+  if (fd < 0 || fstat(fd, &st) < 0 || st.st_size == 0) {
+    if (fd >= 0) {
+      close(fd);
+    }
+    return NULL;
+  }
+
+  *len = st.st_size;
+  file = mmap(NULL, *len, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  return file == MAP_FAILED ? NULL : file;
+}
+
+/* Check that the checkpoint fits the current mapping and state blocks
+ * before anything is changed */
+static bool view_fits(const msp430_t *mcu, const checkpoint_view_t *view) {
+  uint8_t page_data[MEM_PAGE_SIZE];
+  uint32_t page, i;
+  size_t len;
+
+  if (view->cpu == NULL || view->interrupts == NULL) {
+    fprintf(stderr, "Checkpoint has no complete checkpoint\n");
+    return false;
+  }
+
+  for (page = 0; page < MEM_PAGES; page++) {
+    if (view->pages[page] == NULL) {
+      continue;
+    }
+    if (writable_host_page(&mcu->bus, page) == NULL) {
+      fprintf(stderr, "Checkpoint page %04X is not writable host memory\n",
+              page << MEM_PAGE_SHIFT);
+      return false;
+    }
+    if (!unpack_page(view->pages[page], view->page_len[page], page_data)) {
+      fprintf(stderr, "Checkpoint page %04X is corrupt\n",
+              page << MEM_PAGE_SHIFT);
+      return false;
+    }
+  }
+
+  for (i = 0; i < SNAPSHOT_STATES; i++) {
+    if (view->states[i] == NULL && snapshot_state(mcu, i, &len) == NULL) {
+      continue;
+    }
+    if (view->states[i] == NULL || snapshot_state(mcu, i, &len) == NULL ||
+        len != view->state_len[i]) {
+      fprintf(stderr, "Checkpoint state block %u does not fit\n", i);
+      return false;
+    }
+  }
+  return true;
+}
+
+bool resume_checkpoint(const char *path, Cpu *cpu) {
+  msp430_t *mcu = cpu->mcu;
+  checkpoint_view_t *view = malloc(sizeof *view);
+  const uint8_t *file;
+  uint32_t page, i;
+  size_t len = 0, state_len;
+  bool ok = false;
+
+  file = map_file(path, &len);
+  if (view == NULL) {
+    fprintf(stderr, "Out of memory reading %s\n", path);
+  } else if (file == NULL || !check_header(file, len)) {
+    fprintf(stderr, "%s is not a version %d checkpoint file\n", path,
+            CHECKPOINT_VERSION);
+  } else if (!scan_records(file, len, view)) {
+    fprintf(stderr, "Out of memory reading %s\n", path);
+  } else {
+    ok = view_fits(mcu, view);
+  }
+
+  if (ok) {
+    for (page = 0; page < MEM_PAGES; page++) {
+      if (view->pages[page] == NULL) {
+        continue;
+      }
+      unpack_page(view->pages[page], view->page_len[page],
+                  writable_host_page(&mcu->bus, page));
+      /* Cached code may be stale */
+      mem_write_notify(&mcu->bus, page << MEM_PAGE_SHIFT, MEM_PAGE_SIZE);
+    }
+
+    for (i = 0; i < SNAPSHOT_STATES && view->states[i] != NULL; i++) {
+      memcpy(snapshot_state(mcu, i, &state_len), view->states[i],
+             view->state_len[i]);
+    }
+
+    for (i = 0; i < 16; i++) {
+      cpu->regs[i] = get16(view->cpu + 2 * i);
+    }
+    cpu->running = view->cpu[32];
+    cpu->flags.kind = FLAGS_NONE;
+    mcu->interrupt_requests = get16(view->interrupts);
+  }
+
+  if (file != NULL) {
+    munmap((void *)file, len);
+  }
+  free(view);
+  return ok;
+}
+
+/*##########+++ Opening +++##########*/
+
+bool open_checkpoint(checkpoint_t *ck, const msp430_t *mcu, const char *path,
+                     bool append) {
+  uint8_t header[HEADER_LEN];
+  size_t end = 0, len = 0;
+  bool scanned = true;
+  uint16_t page;
+
+  memset(ck, 0, sizeof *ck);
+  ck->shadow = malloc(0x10000);
+  if (ck->shadow == NULL) {
+    return false;
+  }
+
+  if (append) { /* Find the end of the last complete checkpoint */
+    const uint8_t *file = map_file(path, &len);
+    checkpoint_view_t *view = malloc(sizeof *view);
+    bool valid = file != NULL && check_header(file, len);
+
+    /* Without the records, the end of the last checkpoint is unknown, and
+     * nothing may be truncated */
+    if (valid) {
+      scanned = view != NULL && scan_records(file, len, view);
+    }
+    if (valid && scanned) {
+      end = view->end;
+      ck->sequence = view->sequence;
+
+      // Memory is as resumed from the file, so later checkpoints are deltas
+      for (page = 0; page < MEM_PAGES; page++) {
+        const uint8_t *host = writable_host_page(&mcu->bus, page);
+
+        if (host != NULL && view->pages[page] != NULL) {
+          memcpy(ck->shadow + (page << MEM_PAGE_SHIFT), host, MEM_PAGE_SIZE);
+          ck->stored[page] = true;
+        }
+      }
+    }
+    if (file != NULL) {
+      munmap((void *)file, len);
+    }
+    free(view);
+
+    if (!scanned) {
+      fprintf(stderr, "Out of memory reading %s\n", path);
+      close_checkpoint(ck);
+      return false;
+    }
+  }
+
+  /* Records go straight to the file: after a failed write there must be
+   * nothing left in a buffer to land past the truncation */
+  if (end) {
+    ck->file = fopen(path, "r+b");
+    if (ck->file != NULL &&
+        (setvbuf(ck->file, NULL, _IONBF, 0) != 0 ||
+         ftruncate(fileno(ck->file), end) != 0 ||
+         fseek(ck->file, end, SEEK_SET) != 0)) {
+      fclose(ck->file);
+      ck->file = NULL;
+    }
+  } else if (!append || len == 0) {
+    ck->file = fopen(path, "wb");
+    memcpy(header, CHECKPOINT_MAGIC, sizeof CHECKPOINT_MAGIC - 1);
+    put16(&header[HEADER_LEN - 4], CHECKPOINT_VERSION);
+    put16(&header[HEADER_LEN - 2], MEM_PAGE_SIZE);
+    if (ck->file != NULL &&
+        (setvbuf(ck->file, NULL, _IONBF, 0) != 0 ||
+         fwrite(header, sizeof header, 1, ck->file) != 1)) {
+      fclose(ck->file);
+      ck->file = NULL;
+    }
+  }
+
+  if (ck->file == NULL) {
+    fprintf(stderr, "Cannot open checkpoint file %s\n", path);
+    close_checkpoint(ck);
+    return false;
+  }
+  ck->end = end ? end : HEADER_LEN;
+  return true;
+}
+
+void close_checkpoint(checkpoint_t *ck) {
+  if (ck->file != NULL) {
+    fclose(ck->file);
+  }
+  free(ck->shadow);
+  memset(ck, 0, sizeof *ck);
+}
@@ -0,0 +1,85 @@
+/*
+  This file is part of MSP430 Emulator
+
+  MSP430 Emulator is free software: you can redistribute it and/or
+  modify it under the terms of the GNU General Public License as
+  published by the Free Software Foundation, either version 3 of the
+  License, or (at your option) any later version.
+
+  MSP430 Emulator is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with MSP430 Emulator.
+  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#ifndef _CHECKPOINT_H_
+#define _CHECKPOINT_H_
+
+#include "../utilities.h"
+#include "registers.h"
+
+/* Checkpoint files start with CHECKPOINT_MAGIC, then the version and the
+ * page size as 16-bit words. All numbers are little-endian */
+#define CHECKPOINT_MAGIC "MSP430CK"
+#define CHECKPOINT_VERSION 1
+
+/* A checkpoint file open for writing */
+typedef struct checkpoint {
+  FILE *file;
+  uint8_t *shadow; /* Writable host pages as of the last checkpoint */
+  bool stored[MEM_PAGES]; /* Page is in the file, and in shadow */
+  uint64_t sequence;      /* Checkpoints in the file */
+  size_t end;             /* Just past the last COMMIT */
+} checkpoint_t;
+
+/**
+ * @brief Open a checkpoint file for write_checkpoint(). Checkpoints are
+ * appended, each storing only the host memory pages that changed since the
+ * one before, so the file is a series of increments. To keep adding to a file
+ * that resume_checkpoint() was just called on, open it with append set: an
+ * incomplete checkpoint at its end, from a process that died while writing
+ * it, is cut off
+ * @param ck Receives the open file
+ * @param mcu The MCU the checkpoints are of
+ * @param path The file
+ * @param append Add to the file, instead of starting a new one
+ * @return false if the file could not be opened, or is not a checkpoint file
+ */
+bool open_checkpoint(checkpoint_t *ck, const msp430_t *mcu, const char *path,
+                     bool append);
+
+/**
+ * @brief Append a checkpoint and flush it to disk. Stores the registers, the
+ * pending interrupts, the blocks registered with register_snapshot_state(),
+ * and the writable host memory pages, see map_host_memory(), that changed
+ * since the last checkpoint, compressed. Memory behind the callbacks and
+ * devices is saved through registered blocks. If writing fails, the file is
+ * cut back to the previous checkpoint and the next call stores the same pages
+ * again, so it can be retried
+ * @param ck The open file
+ * @param cpu A pointer to the CPU structure
+ * @return false if writing failed
+ */
+bool write_checkpoint(checkpoint_t *ck, Cpu *cpu);
+
+void close_checkpoint(checkpoint_t *ck);
+
+/**
+ * @brief Return to the last complete checkpoint in a file. The file is
+ * mapped, not read, and only the newest copy of each page is decompressed.
+ * Host memory must be mapped, and state blocks registered, as when the file
+ * was written
+ * @param path The file
+ * @param cpu A pointer to the CPU structure
+ * @return false if the file could not be read, is not a checkpoint file of
+ * this version, holds no complete checkpoint, or does not fit the current
+ * mapping and state blocks. Errors are reported on stderr
+ */
+bool resume_checkpoint(const char *path, Cpu *cpu);
+
+#endif
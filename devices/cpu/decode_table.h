@@ -0,0 +1,60 @@
+/*
+  This file is part of MSP430 Emulator
+
+  MSP430 Emulator is free software: you can redistribute it and/or
+  modify it under the terms of the GNU General Public License as
+  published by the Free Software Foundation, either version 3 of the
+  License, or (at your option) any later version.
+
+  MSP430 Emulator is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with MSP430 Emulator.
+  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef _DECODE_TABLE_H_
+#define _DECODE_TABLE_H_
+
+#include "predecode.h"
+#include <stdbool.h>
+#include <stdint.h>
+
+/* The part of a decoded_op_t that depends only on the instruction word */
+typedef struct decode_entry {
+  uint8_t format;      /* Format I, II or III, 0 if invalid */
+  uint8_t opcode;      /* Opcode, or condition for Format III */
+  uint8_t bw_flag;     /* Byte or Word */
+  uint8_t src_mode;    /* operand_mode_t of the (only) source operand */
+  uint8_t dst_mode;    /* operand_mode_t of the Format I destination */
+  uint8_t source;      /* Source register number */
+  uint8_t destination; /* Destination register number */
+  uint8_t length;      /* Length in words */
+  uint8_t reg_reads;   /* Static register read notifications */
+  uint8_t cycles[CPU_MODELS]; /* Cycles taken, per cpu_model_t */
+  uint16_t handler;    /* Handler index for the threaded interpreter */
+  int16_t constant;    /* Generated constant or jump offset */
+} decode_entry_t;
+
+/* Indexed by instruction word. Generated at build time by gen_decode_table
+ * from decode_word() */
+extern const decode_entry_t decode_table[0x10000];
+
+/**
+ * @brief Decode everything that follows from an instruction word
+ * @param instruction The instruction word
+ * @param op Entry to fill in
+ */
+void decode_word(uint16_t instruction, decode_entry_t *op);
+
+/**
+ * @brief Check if an operand mode takes an extension word
+ * @param mode An operand_mode_t
+ * @return true for indexed, symbolic, absolute and immediate operands
+ */
+bool has_extension_word(uint8_t mode);
+
+#endif
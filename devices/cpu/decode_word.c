@@ -0,0 +1,331 @@
+/*
+  This file is part of MSP430 Emulator
+
+  MSP430 Emulator is free software: you can redistribute it and/or
+  modify it under the terms of the GNU General Public License as
+  published by the Free Software Foundation, either version 3 of the
+  License, or (at your option) any later version.
+
+  MSP430 Emulator is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with MSP430 Emulator.
+  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+//##########+++ Instruction Word Decoder +++##########
+//# Everything about an instruction that follows from its
+//# first word. gen_decode_table runs decode_word() for all
+//# 64K words at build time to produce decode_table.
+//####################################################
+
+#include "decode_table.h"
+#include "decoder.h"
+#include "handlers.h"
+
+static const uint8_t src_class[] = {
+    [MODE_REGISTER] = 0, [MODE_CONSTANT] = 1, [MODE_IMMEDIATE] = 1,
+    [MODE_INDEXED] = 2,  [MODE_SYMBOLIC] = 3, [MODE_ABSOLUTE] = 3,
+    [MODE_INDIRECT] = 4, [MODE_AUTOINC] = 5};
+
+static const uint8_t dst_class[] = {[MODE_REGISTER] = 0,
+                                    [MODE_INDEXED] = 1,
+                                    [MODE_SYMBOLIC] = 2,
+                                    [MODE_ABSOLUTE] = 2};
+
+/* Instructions that can halt the CPU, by writing SR or by being invalid or
+ * unimplemented, are left to the reference decoder so that the engines can
+ * check for a halt after them only */
+static bool may_halt(const decode_entry_t *op) {
+  switch (op->format) {
+  case 1:
+    return op->opcode == OP_DADD ||
+           (op->dst_mode == MODE_REGISTER && op->destination == REG_SR &&
+            op->opcode != OP_CMP && op->opcode != OP_BIT);
+  case 2:
+    return op->opcode >= OP_RETI ||
+           (op->src_mode == MODE_REGISTER && op->source == REG_SR &&
+            op->opcode <= OP_SXT);
+  default:
+    return op->format == 0;
+  }
+}
+
+static uint16_t threaded_handler(const decode_entry_t *op) {
+  if (may_halt(op)) {
+    return 0;
+  }
+
+  switch (op->format) {
+  case 1:
+    return FORMATI_BASE +
+           (((op->opcode - OP_MOV) * SRC_CLASSES + src_class[op->src_mode]) *
+                DST_CLASSES +
+            dst_class[op->dst_mode]) *
+               2 +
+           op->bw_flag;
+  case 2:
+    return FORMATII_BASE +
+           (op->opcode * SRC_CLASSES + src_class[op->src_mode]) * 2 +
+           op->bw_flag;
+  case 3:
+    return FORMATIII_BASE + op->opcode;
+  default:
+    return 0;
+  }
+}
+
+/* Register reads the reference decoder notifies per operand mode */
+static const uint8_t src_mode_reads[] = {
+    [MODE_REGISTER] = 1, [MODE_CONSTANT] = 1, [MODE_INDEXED] = 1,
+    [MODE_SYMBOLIC] = 1, [MODE_ABSOLUTE] = 0, [MODE_INDIRECT] = 1,
+    [MODE_AUTOINC] = 1,  [MODE_IMMEDIATE] = 0};
+
+static const uint8_t dst_mode_reads[] = {[MODE_REGISTER] = 1,
+                                         [MODE_INDEXED] = 1,
+                                         [MODE_SYMBOLIC] = 1,
+                                         [MODE_ABSOLUTE] = 0};
+
+/* Cycle tables of the family user's guides (SLAU144 for CPU_MSP430,
+ * SLAU208 for CPU_MSP430X). Rows are source operands: Rn (and constant
+ * generator constants), @Rn, @Rn+, #N, X(Rn), EDE and &EDE */
+enum { CYC_RN, CYC_IND, CYC_INC, CYC_IMM, CYC_IDX, CYC_SYM, CYC_ABS };
+
+static const uint8_t cycle_src[] = {
+    [MODE_REGISTER] = CYC_RN,  [MODE_CONSTANT] = CYC_RN,
+    [MODE_INDEXED] = CYC_IDX,  [MODE_SYMBOLIC] = CYC_SYM,
+    [MODE_ABSOLUTE] = CYC_ABS, [MODE_INDIRECT] = CYC_IND,
+    [MODE_AUTOINC] = CYC_INC,  [MODE_IMMEDIATE] = CYC_IMM};
+
+/* Format I, by destination: Rm, PC, then X(Rm), EDE and &EDE alike */
+static const uint8_t formatI_cycles[CPU_MODELS][7][3] = {
+    [CPU_MSP430] = {{1, 2, 4},
+                    {2, 2, 5},
+                    {2, 3, 5},
+                    {2, 3, 5},
+                    {3, 3, 6},
+                    {3, 3, 6},
+                    {3, 3, 6}},
+    [CPU_MSP430X] = {{1, 3, 4},
+                     {2, 4, 5},
+                     {2, 4, 5},
+                     {2, 3, 5},
+                     {3, 5, 6},
+                     {3, 5, 6},
+                     {3, 5, 6}}};
+
+/* Format II, by instruction: RRA, RRC, SWPB and SXT, then PUSH, then CALL.
+ * #N only makes sense for the last two */
+static const uint8_t formatII_cycles[CPU_MODELS][7][3] = {
+    [CPU_MSP430] = {{1, 3, 4},
+                    {3, 4, 4},
+                    {3, 5, 5},
+                    {3, 4, 5},
+                    {4, 5, 5},
+                    {4, 5, 5},
+                    {4, 5, 5}},
+    [CPU_MSP430X] = {{1, 3, 4},
+                     {3, 3, 4},
+                     {3, 3, 4},
+                     {3, 3, 4},
+                     {4, 4, 5},
+                     {4, 4, 5},
+                     {4, 4, 6}}};
+
+/* RETI, which SLAU208 lists as 3 cycles on the CPUX against 5 */
+static const uint8_t reti_cycles[CPU_MODELS] = {[CPU_MSP430] = 5,
+                                                [CPU_MSP430X] = 3};
+
+#define JUMP_CYCLES 2 /* Taken or not */
+
+static uint8_t formatI_timing(const decode_entry_t *op, cpu_model_t model) {
+  uint8_t dst = 0, cycles;
+
+  if (op->dst_mode != MODE_REGISTER) {
+    dst = 2;
+  } else if (op->destination == REG_PC) {
+    dst = 1;
+  }
+  cycles = formatI_cycles[model][cycle_src[op->src_mode]][dst];
+
+  /* The CPUX saves the write back cycle where there is none */
+  if (model == CPU_MSP430X && dst == 2 &&
+      (op->opcode == OP_MOV || op->opcode == OP_BIT || op->opcode == OP_CMP)) {
+    cycles--;
+  }
+  return cycles;
+}
+
+static uint8_t formatII_timing(const decode_entry_t *op, cpu_model_t model) {
+  uint8_t kind = op->opcode == OP_PUSH ? 1 : op->opcode == OP_CALL ? 2 : 0;
+
+  if (op->opcode == OP_RETI) {
+    return reti_cycles[model];
+  } else if (op->opcode > OP_RETI) {
+    return 0; /* Invalid */
+  }
+  return formatII_cycles[model][cycle_src[op->src_mode]][kind];
+}
+
+static uint8_t source_mode(uint8_t source, uint8_t as_flag) {
+  /* Spot CG1 and CG2 Constant generator instructions */
+  if ((source == 2 && as_flag > 1) || source == 3) {
+    return MODE_CONSTANT;
+  }
+
+  switch (as_flag) {
+  case 0:
+    return MODE_REGISTER;
+  case 1:
+    return source == 0 ? MODE_SYMBOLIC
+                       : (source == 2 ? MODE_ABSOLUTE : MODE_INDEXED);
+  case 2:
+    return MODE_INDIRECT;
+  default:
+    return source == 0 ? MODE_IMMEDIATE : MODE_AUTOINC;
+  }
+}
+
+bool has_extension_word(uint8_t mode) {
+  return mode == MODE_INDEXED || mode == MODE_SYMBOLIC ||
+         mode == MODE_ABSOLUTE || mode == MODE_IMMEDIATE;
+}
+
+static uint8_t word_length(uint16_t instruction) {
+  uint8_t format_id = instruction >> 12;
+  uint8_t as_flag = (instruction & 0x0030) >> 4;
+
+  if (format_id == 0x1) {
+    return 1 + has_extension_word(source_mode(instruction & 0x000F, as_flag));
+  } else if (format_id >= 0x4) {
+    return 1 +
+           has_extension_word(source_mode((instruction & 0x0F00) >> 8,
+                                          as_flag)) +
+           ((instruction & 0x0080) >> 7);
+  }
+
+  return 1;
+}
+
+void decode_word(uint16_t instruction, decode_entry_t *op) {
+  uint8_t format_id = instruction >> 12;
+  uint8_t as_flag = (instruction & 0x0030) >> 4;
+  cpu_model_t model;
+
+  memset(op, 0, sizeof *op);
+  op->length = word_length(instruction);
+  op->reg_reads = op->length; /* One per fetched word */
+
+  if (format_id == 0x1) {
+    op->format = 2;
+    op->opcode = (instruction & 0x0380) >> 7;
+    op->bw_flag = (instruction & 0x0040) >> 6;
+    op->source = instruction & 0x000F;
+    op->src_mode = source_mode(op->source, as_flag);
+  } else if (format_id == 0x2 || format_id == 0x3) {
+    op->format = 3;
+    op->opcode = (instruction & 0x1C00) >> 10;
+    op->constant = (instruction & 0x03FF) * 2;
+    if (instruction & (1u << 9)) { /* Sign extend */
+      op->constant |= 0xF800;
+    }
+
+    op->cycles[CPU_MSP430] = op->cycles[CPU_MSP430X] = JUMP_CYCLES;
+    op->handler = threaded_handler(op);
+    return;
+  } else if (format_id >= 0x4) {
+    op->format = 1;
+    op->opcode = format_id;
+    op->bw_flag = (instruction & 0x0040) >> 6;
+    op->source = (instruction & 0x0F00) >> 8;
+    op->destination = instruction & 0x000F;
+    op->src_mode = source_mode(op->source, as_flag);
+
+    if ((instruction & 0x0080) == 0) {
+      op->dst_mode = MODE_REGISTER;
+    } else if (op->destination == 0) {
+      op->dst_mode = MODE_SYMBOLIC;
+    } else if (op->destination == 2) {
+      op->dst_mode = MODE_ABSOLUTE;
+    } else {
+      op->dst_mode = MODE_INDEXED;
+    }
+    op->reg_reads += dst_mode_reads[op->dst_mode];
+  } else {
+    op->format = 0; /* Invalid, left to the reference decoder to report */
+    return;
+  }
+
+  op->reg_reads += src_mode_reads[op->src_mode];
+  if (op->src_mode == MODE_CONSTANT) {
+    op->constant = run_constant_generator(op->source, as_flag);
+  }
+
+  for (model = 0; model < CPU_MODELS; model++) {
+    op->cycles[model] = op->format == 1 ? formatI_timing(op, model)
+                                        : formatII_timing(op, model);
+  }
+
+  op->handler = threaded_handler(op);
+}
+
+int16_t run_constant_generator(uint8_t source, uint8_t as_flag) {
+  int16_t generated_constant = 0;
+
+  switch (source) {
+  case 2: { /* Register R2/SR/CG1 */
+
+    switch (as_flag) {
+    case 0b10: { /* +4, bit processing */
+      generated_constant = 4;
+      break;
+    }
+    case 0b11: { /* +8, bit processing */
+      generated_constant = 8;
+      break;
+    }
+    default: {
+      printf("Invalid as_flag for CG1\n");
+    }
+    }
+
+    break;
+  }
+
+  case 3: { /* Register R3/CG2*/
+
+    switch (as_flag) {
+    case 0b00: { /* 0, word processing */
+      generated_constant = 0;
+      break;
+    }
+    case 0b01: { /* +1 */
+      generated_constant = 1;
+      break;
+    }
+    case 0b10: { /* +2, bit processing */
+      generated_constant = 2;
+      break;
+    }
+    case 0b11: { /* -1, word processing */
+      generated_constant = -1;
+      break;
+    }
+    default: {
+      printf("Invalid as_flag for CG2\n");
+    }
+    }
+
+    break;
+  }
+
+  default: {
+    printf("Invalid source register for constant generation.\n");
+  }
+  }
+
+  return generated_constant;
+}
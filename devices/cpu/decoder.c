@@ -17,96 +17,128 @@
 */
 
 #include "decoder.h"
+#include "decode_table.h"
+#include "disassembler.h"
+#include "execute.h"
+#include "interrupt.h"
+#include "jit.h"
+#include "predecode.h"
+#include "profiler.h"
+#include "threaded.h"
+
+void set_engine(msp430_t *mcu, engine_t new_engine) {
+  mcu->engine = new_engine;
+}
+
+engine_t get_engine(const msp430_t *mcu) { return mcu->engine; }
+
+void set_cpu_model(msp430_t *mcu, cpu_model_t model) {
+  mcu->cpu_model = model;
+  flush_decoded_ops(mcu); /* Cached cycle counts */
+}
+
+cpu_model_t get_cpu_model(const msp430_t *mcu) { return mcu->cpu_model; }
 
 /*##########+++ CPU Fetch Cycle  +++##########*/
 uint16_t fetch(Cpu *cpu) {
-  uint16_t word = mem_read(cpu->pc, WORD);
-  register_read_notify_cb(1);
+  uint16_t word = mem_read(&cpu->mcu->bus, cpu->pc, WORD);
+  register_read_notify(cpu, 1);
   cpu->pc += 2;
   return word;
 }
 
 /*##########+++ CPU Decode Cycle +++##########*/
 void decode(Cpu *cpu, uint16_t instruction, char *disas, instruction_t *instr) {
-  uint8_t format_id;
+  uint8_t format_id, cycles;
   instr->isDestPC = false; // default value
 
+  if (disas != NULL) { /* Disassemble before executing changes PC */
+    uint16_t words[3] = {instruction};
+
+    mem_read_words(&cpu->mcu->bus, cpu->pc, &words[1],
+                   instruction_length(instruction) - 1);
+    disassemble(cpu->pc - 2, words, disas);
+    strncpy(instr->mnemonic, instruction_mnemonic(instruction),
+            sizeof(instr->mnemonic) - 1);
+  }
+
+  /* All cycles of the instruction in one charge */
+  cycles = decode_table[instruction].cycles[cpu->mcu->cpu_model];
+  consume_cycles(cpu, cycles);
+  profile_instructions(cpu, cpu->pc - 2, 1, cycles);
   format_id = (uint8_t)(instruction >> 12);
 
   if (format_id == 0x1) {
     // format II (single operand) instruction //
     instr->format = 2;
-    decode_formatII(cpu, instruction, disas, instr);
+    decode_formatII(cpu, instruction, instr);
   } else if (format_id >= 0x2 && format_id <= 3) {
     // format III (jump) instruction //
     instr->format = 3;
-    decode_formatIII(cpu, instruction, disas, instr);
+    decode_formatIII(cpu, instruction, instr);
   } else if (format_id >= 0x4) {
     // format I (two operand) instruction //
     instr->format = 1;
-    decode_formatI(cpu, instruction, disas, instr);
+    decode_formatI(cpu, instruction, instr);
   } else {
     printf("%04X\t[INVALID INSTRUCTION]\n", instruction);
-    exit(0);
     cpu->pc -= 2;
     cpu->running = false;
   }
 }
 
-int16_t run_constant_generator(uint8_t source, uint8_t as_flag) {
-  int16_t generated_constant = 0;
+/*##########+++ CPU Predecoded Step +++##########*/
+void step(Cpu *cpu, instruction_t *instr) {
+  if (cpu->pc & 1) { /* Misaligned PC, not cached */
+    decode(cpu, fetch(cpu), NULL, instr);
+    flush_register_notify(cpu);
+    return;
+  }
 
-  switch (source) {
-  case 2: { /* Register R2/SR/CG1 */
+  execute(cpu, get_decoded_op(cpu->mcu, cpu->pc), instr);
+  flush_register_notify(cpu);
+}
 
-    switch (as_flag) {
-    case 0b10: { /* +4, bit processing */
-      generated_constant = 4;
-      break;
-    }
-    case 0b11: { /* +8, bit processing */
-      generated_constant = 8;
-      break;
-    }
-    default: {
-      printf("Invalid as_flag for CG1\n");
-    }
-    }
+/*##########+++ CPU Run Loop +++##########*/
+uint32_t run_instructions(Cpu *cpu, uint32_t count) {
+  instruction_t instr;
+  uint32_t i, executed = count;
 
-    break;
+  cpu->running = true;
+  poll_interrupts(cpu); /* May wake the CPU */
+  if (cpu->sr & SR_CPU_OFF) {
+    return 0;
   }
 
-  case 3: { /* Register R3/CG2*/
-
-    switch (as_flag) {
-    case 0b00: { /* 0, word processing */
-      generated_constant = 0;
-      break;
-    }
-    case 0b01: { /* +1 */
-      generated_constant = 1;
-      break;
-    }
-    case 0b10: { /* +2, bit processing */
-      generated_constant = 2;
-      break;
-    }
-    case 0b11: { /* -1, word processing */
-      generated_constant = -1;
-      break;
-    }
-    default: {
-      printf("Invalid as_flag for CG2\n");
+  switch (cpu->mcu->engine) {
+  case ENGINE_THREADED:
+    executed = run_threaded(cpu, count);
+    break;
+  case ENGINE_BLOCK:
+    executed = run_blocks(cpu, count);
+    break;
+  case ENGINE_JIT:
+    executed = run_jit(cpu, count);
+    break;
+  case ENGINE_PREDECODE:
+    for (i = 0; i < count && !cpu_halted(cpu); i++) {
+      poll_interrupts(cpu);
+      step(cpu, &instr);
     }
+    executed = i;
+    break;
+  default:
+    for (i = 0; i < count && !cpu_halted(cpu); i++) {
+      poll_interrupts(cpu);
+      decode(cpu, fetch(cpu), NULL, &instr);
+      flush_register_notify(cpu);
     }
-
+    executed = i;
     break;
   }
 
-  default: {
-    printf("Invalid source register for constant generation.\n");
-  }
-  }
-
-  return generated_constant;
+  sync_sr(cpu); /* Leave SR up to date for the caller */
+  flush_register_notify(cpu);
+  cpu->mcu->stats.instructions += executed;
+  return executed;
 }
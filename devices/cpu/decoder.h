@@ -27,14 +27,62 @@
 #include "formatI.h"
 #include "formatII.h"
 #include "formatIII.h"
+#include "msp430.h"
 #include "registers.h"
 
 #define DISAS_STR_LEN 80
 
 int16_t run_constant_generator(uint8_t source, uint8_t as_flag);
 
+/**
+ * @brief Decode and execute an instruction whose first word has been fetched
+ * @param cpu A pointer to the CPU structure
+ * @param instruction The instruction word, as returned by fetch()
+ * @param disas Receives the disassembly and instr->mnemonic is filled in,
+ * see disassembler.h. Pass NULL to execute without formatting any strings
+ * @param instr Receives format and isDestPC
+ */
 void decode(Cpu *cpu, uint16_t instruction, char *disas, instruction_t *instr);
 
 uint16_t fetch(Cpu *cpu);
 
+/**
+ * @brief Fetch, decode and execute one instruction through the predecoded
+ * instruction cache. Equivalent to fetch() followed by decode() without
+ * disassembly, except that instr->mnemonic is not filled in.
+ * @param cpu A pointer to the CPU structure
+ * @param instr Receives format and isDestPC
+ */
+void step(Cpu *cpu, instruction_t *instr);
+
+/**
+ * @brief Select the execution engine of an MCU, see engine_t
+ * @param mcu The MCU
+ * @param new_engine The engine
+ */
+void set_engine(msp430_t *mcu, engine_t new_engine);
+engine_t get_engine(const msp430_t *mcu);
+
+/**
+ * @brief Select the CPU generation whose cycle counts an MCU charges, see
+ * cpu_model_t. Every instruction charges the cycles the user's guide gives
+ * for it, in one call to consume_cycles_cb, or one per basic block with
+ * ENGINE_BLOCK and ENGINE_JIT. Drops the instruction caches
+ * @param mcu The MCU
+ * @param model The CPU generation
+ */
+void set_cpu_model(msp430_t *mcu, cpu_model_t model);
+cpu_model_t get_cpu_model(const msp430_t *mcu);
+
+/**
+ * @brief Execute a number of instructions with the selected engine. Sets
+ * cpu->running, and stops early once cpu_halted(): after an invalid
+ * instruction, or one that sets SR_CPU_OFF. Pending interrupts are taken
+ * between instructions, and may wake the CPU, see interrupt.h
+ * @param cpu A pointer to the CPU structure
+ * @param count Number of instructions to execute
+ * @return Number of instructions executed, including one that halted the CPU
+ */
+uint32_t run_instructions(Cpu *cpu, uint32_t count);
+
 #endif
@@ -0,0 +1,220 @@
+/*
+  This file is part of MSP430 Emulator
+
+  MSP430 Emulator is free software: you can redistribute it and/or
+  modify it under the terms of the GNU General Public License as
+  published by the Free Software Foundation, either version 3 of the
+  License, or (at your option) any later version.
+
+  MSP430 Emulator is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with MSP430 Emulator.
+  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+//##########+++ Bulk Image Disassembler +++##########
+//# Disassembles whole memory images without executing
+//# them. Instruction boundaries are found by a cheap
+//# sequential scan over the length table, then the
+//# chunks between them are formatted on worker threads.
+//###################################################
+
+#include "disas_image.h"
+#include "decoder.h"
+#include "disassembler.h"
+#include "predecode.h"
+#include <pthread.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#define MAX_THREADS 64
+#define MIN_CHUNK_WORDS 2048
+
+/* Longest line format_line() writes: a JSON object with three words */
+#define LINE_LEN (DISAS_STR_LEN + 96)
+
+typedef struct disas_chunk {
+  const uint8_t *image;
+  uint16_t base;
+  disas_format_t format;
+  uint32_t first, last; /* Word indices, first is an instruction boundary */
+  char *text;           /* Formatted lines */
+  size_t text_len;
+  long count; /* Instructions formatted */
+} disas_chunk_t;
+
+static inline uint16_t image_word(const uint8_t *image, uint32_t index) {
+  return image[2 * index] | image[2 * index + 1] << 8;
+}
+
+static size_t format_line(char *out, disas_format_t format, uint16_t address,
+                          const uint16_t *words, uint8_t length,
+                          const char *disas) {
+  char hex[3 * sizeof "\"0x0000\","] = {0}; /* Three words, as JSON */
+  size_t pos = 0;
+  uint8_t i;
+
+  for (i = 0; i < length; i++) {
+    if (format == DISAS_JSON) {
+      pos += sprintf(hex + pos, "%s\"0x%04X\"", i ? "," : "", words[i]);
+    } else {
+      pos += sprintf(hex + pos, "%s%04X", i ? " " : "", words[i]);
+    }
+  }
+
+  if (format == DISAS_JSON) {
+    return snprintf(out, LINE_LEN,
+                    "{\"address\":\"0x%04X\",\"words\":[%s],\"text\":\"%s\"}\n",
+                    address, hex, disas);
+  }
+  return snprintf(out, LINE_LEN, "%04X: %-14s  %s\n", address, hex, disas);
+}
+
+static void *disassemble_chunk(void *arg) {
+  disas_chunk_t *chunk = arg;
+  uint16_t words[3];
+  char disas[DISAS_STR_LEN];
+  uint32_t i = chunk->first;
+  uint8_t length, j;
+
+  /* Every instruction is at least one word long */
+  chunk->text = malloc((size_t)(chunk->last - chunk->first) * LINE_LEN + 1);
+  if (chunk->text == NULL) {
+    return NULL;
+  }
+
+  while (i < chunk->last) {
+    uint16_t address = chunk->base + 2 * i;
+
+    words[0] = image_word(chunk->image, i);
+    length = instruction_length(words[0]);
+    for (j = 1; j < length; j++) {
+      words[j] = image_word(chunk->image, i + j);
+    }
+
+    disassemble(address, words, disas);
+    chunk->text_len += format_line(chunk->text + chunk->text_len,
+                                   chunk->format, address, words, length,
+                                   disas);
+    chunk->count++;
+    i += length;
+  }
+
+  return NULL;
+}
+
+static unsigned worker_count(unsigned threads) {
+  if (threads == 0) {
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    threads = cpus > 0 ? (unsigned)cpus : 1;
+  }
+  return threads > MAX_THREADS ? MAX_THREADS : threads;
+}
+
+long disassemble_image(const uint8_t *image, size_t len, uint16_t base,
+                       disas_format_t format, unsigned threads, FILE *out) {
+  disas_chunk_t chunks[MAX_THREADS] = {0};
+  pthread_t workers[MAX_THREADS];
+  bool started[MAX_THREADS] = {0};
+  uint32_t words = len / 2;
+  uint32_t code_end = 0; /* Start of the words too short for an instruction */
+  uint32_t i;
+  unsigned n, c;
+  long count = 0;
+  char line[LINE_LEN];
+
+  if (len > 0x10000u - base) {
+    return -1;
+  }
+
+  n = worker_count(threads);
+  if (n > words / MIN_CHUNK_WORDS) {
+    n = words / MIN_CHUNK_WORDS ? words / MIN_CHUNK_WORDS : 1;
+  }
+
+  /* Split at the first instruction boundary after each nth of the image */
+  for (c = 0; c < n; c++) {
+    uint32_t target = (uint64_t)words * c / n;
+    uint8_t length = 1;
+
+    while (code_end < target) {
+      length = instruction_length(image_word(image, code_end));
+      if (code_end + length > words) {
+        break;
+      }
+      code_end += length;
+    }
+    if (code_end < target) { /* The image ends mid-instruction */
+      break;
+    }
+    chunks[c].first = code_end;
+  }
+  n = c;
+
+  while (code_end < words) {
+    uint8_t length = instruction_length(image_word(image, code_end));
+    if (code_end + length > words) {
+      break;
+    }
+    code_end += length;
+  }
+
+  for (c = 0; c < n; c++) {
+    chunks[c].image = image;
+    chunks[c].base = base;
+    chunks[c].format = format;
+    chunks[c].last = c + 1 < n ? chunks[c + 1].first : code_end;
+  }
+
+  /* Chunk 0 runs on the calling thread, as does any chunk that can't get
+   * a thread of its own */
+  for (c = 1; c < n; c++) {
+    started[c] =
+        pthread_create(&workers[c], NULL, disassemble_chunk, &chunks[c]) == 0;
+  }
+  for (c = 0; c < n; c++) {
+    if (started[c]) {
+      pthread_join(workers[c], NULL);
+    } else {
+      disassemble_chunk(&chunks[c]);
+    }
+  }
+
+  for (c = 0; c < n; c++) {
+    if (chunks[c].text == NULL && chunks[c].last > chunks[c].first) {
+      count = -1;
+    } else if (count >= 0) {
+      fwrite(chunks[c].text, 1, chunks[c].text_len, out);
+      count += chunks[c].count;
+    }
+    free(chunks[c].text);
+  }
+
+  if (count < 0) {
+    return -1;
+  }
+
+  /* Words past the last complete instruction, and an odd byte */
+  for (i = code_end; i < words; i++) {
+    uint16_t word = image_word(image, i);
+    char disas[20];
+
+    sprintf(disas, ".word 0x%04X", word);
+    fwrite(line, 1,
+           format_line(line, format, base + 2 * i, &word, 1, disas), out);
+  }
+  if (len & 1) {
+    uint16_t byte = image[len - 1];
+    char disas[20];
+
+    sprintf(disas, ".byte 0x%02X", byte);
+    fwrite(line, 1, format_line(line, format, base + len - 1, &byte, 1, disas),
+           out);
+  }
+
+  return ferror(out) ? -1 : count;
+}
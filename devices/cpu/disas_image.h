@@ -0,0 +1,51 @@
+/*
+  This file is part of MSP430 Emulator
+
+  MSP430 Emulator is free software: you can redistribute it and/or
+  modify it under the terms of the GNU General Public License as
+  published by the Free Software Foundation, either version 3 of the
+  License, or (at your option) any later version.
+
+  MSP430 Emulator is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with MSP430 Emulator.
+  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef _DISAS_IMAGE_H_
+#define _DISAS_IMAGE_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+/* Output formats of disassemble_image() */
+typedef enum {
+  DISAS_TEXT, /* "ADDR: WORDS  DISASSEMBLY", one instruction per line */
+  DISAS_JSON, /* One JSON object per line (JSON Lines) */
+} disas_format_t;
+
+/**
+ * @brief Disassemble a memory image by linear sweep, without executing it or
+ * touching CPU state and emulated memory. The image is split into chunks at
+ * instruction boundaries, which are disassembled in parallel and written in
+ * address order, so the output does not depend on the number of threads.
+ * Trailing words too short for their instruction are written as .word, an
+ * odd trailing byte as .byte
+ * @param image The image, in MSP430 (little-endian) byte order
+ * @param len Length of the image in bytes, at most 0x10000 - base
+ * @param base Address of the first byte of the image, should be even
+ * @param format Output format
+ * @param threads Number of worker threads, 0 for one per online CPU
+ * @param out Stream to write to
+ * @return Number of instructions written, -1 if len is out of range, memory
+ * could not be allocated or writing failed
+ */
+long disassemble_image(const uint8_t *image, size_t len, uint16_t base,
+                       disas_format_t format, unsigned threads, FILE *out);
+
+#endif
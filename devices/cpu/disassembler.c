@@ -0,0 +1,132 @@
+/*
+  This file is part of MSP430 Emulator
+
+  MSP430 Emulator is free software: you can redistribute it and/or
+  modify it under the terms of the GNU General Public License as
+  published by the Free Software Foundation, either version 3 of the
+  License, or (at your option) any later version.
+
+  MSP430 Emulator is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with MSP430 Emulator.
+  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+//##########+++ Disassembler +++##########
+//# Formats instructions from their predecoded fields.
+//# Kept apart from the decoders so that executing an
+//# instruction never formats strings; decode() only
+//# calls in here when asked for disassembly.
+//########################################
+
+#include "disassembler.h"
+#include "decoder.h"
+#include "opcodes.h"
+#include "predecode.h"
+
+static const char *const formatI_mnemonics[16] = {
+    [OP_MOV] = "MOV",   [OP_ADD] = "ADD",   [OP_ADDC] = "ADDC",
+    [OP_SUBC] = "SUBC", [OP_SUB] = "SUB",   [OP_CMP] = "CMP",
+    [OP_DADD] = "DADD", [OP_BIT] = "BIT",   [OP_BIC] = "BIC",
+    [OP_BIS] = "BIS",   [OP_XOR] = "XOR",   [OP_AND] = "AND"};
+
+static const char *const formatII_mnemonics[8] = {
+    [OP_RRC] = "RRC",   [OP_SWPB] = "SWPB", [OP_RRA] = "RRA",
+    [OP_SXT] = "SXT",   [OP_PUSH] = "PUSH", [OP_CALL] = "CALL",
+    [OP_RETI] = "RETI", [7] = "???"};
+
+static const char *const formatIII_mnemonics[8] = {
+    "JNZ", "JZ", "JNC", "JC", "JN", "JGE", "JL", "JMP"};
+
+static void format_operand(char *out, size_t len, uint8_t mode, uint8_t reg,
+                           uint16_t word, uint8_t bw_flag) {
+  char reg_name[10];
+  reg_num_to_name(reg, reg_name);
+
+  switch (mode) {
+  case MODE_REGISTER:
+    snprintf(out, len, "%s", reg_name);
+    break;
+  case MODE_CONSTANT:
+    snprintf(out, len, "C#0x%04X", word);
+    break;
+  case MODE_INDEXED:
+    snprintf(out, len, "0x%04X(%s)", word, reg_name);
+    break;
+  case MODE_SYMBOLIC:
+    snprintf(out, len, "0x%04X", word);
+    break;
+  case MODE_ABSOLUTE:
+    snprintf(out, len, "&0x%04X", word);
+    break;
+  case MODE_INDIRECT:
+    snprintf(out, len, "@%s", reg_name);
+    break;
+  case MODE_AUTOINC:
+    snprintf(out, len, "@%s+", reg_name);
+    break;
+  default: /* Immediate */
+    snprintf(out, len, "#0x%04X", bw_flag == BYTE ? word & 0xFF : word);
+    break;
+  }
+}
+
+const char *instruction_mnemonic(uint16_t instruction) {
+  uint8_t format_id = instruction >> 12;
+
+  if (format_id == 0x1) {
+    return formatII_mnemonics[(instruction & 0x0380) >> 7];
+  } else if (format_id == 0x2 || format_id == 0x3) {
+    return formatIII_mnemonics[(instruction & 0x1C00) >> 10];
+  } else if (format_id >= 0x4) {
+    return formatI_mnemonics[format_id];
+  }
+
+  return "???";
+}
+
+uint8_t disassemble(uint16_t address, const uint16_t *words, char *disas) {
+  decoded_op_t op;
+  char src[20], dst[20];
+  const char *suffix;
+
+  predecode_words(address, words, CPU_MSP430, &op);
+  suffix = op.bw_flag == BYTE ? ".B" : "";
+
+  switch (op.format) {
+  case 1:
+    format_operand(src, sizeof src, op.src_mode, op.source, op.src_word,
+                   op.bw_flag);
+    format_operand(dst, sizeof dst, op.dst_mode, op.destination, op.dst_word,
+                   op.bw_flag);
+    snprintf(disas, DISAS_STR_LEN, "%s%s %s, %s",
+             formatI_mnemonics[op.opcode], suffix, src, dst);
+    break;
+  case 2:
+    if (op.opcode == OP_RETI) {
+      snprintf(disas, DISAS_STR_LEN, "RETI");
+      break;
+    } else if (op.opcode == OP_SWPB || op.opcode == OP_SXT ||
+               op.opcode == OP_CALL) { /* Word only */
+      suffix = "";
+    }
+    format_operand(src, sizeof src, op.src_mode, op.source, op.src_word,
+                   op.bw_flag);
+    snprintf(disas, DISAS_STR_LEN, "%s%s %s", formatII_mnemonics[op.opcode],
+             suffix, src);
+    break;
+  case 3:
+    snprintf(disas, DISAS_STR_LEN, "%s 0x%04X", formatIII_mnemonics[op.opcode],
+             (uint16_t)(address + 2 + op.src_word));
+    break;
+  default:
+    snprintf(disas, DISAS_STR_LEN, "[INVALID INSTRUCTION]");
+    break;
+  }
+
+  return op.length;
+}
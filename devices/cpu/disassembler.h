@@ -0,0 +1,43 @@
+/*
+  This file is part of MSP430 Emulator
+
+  MSP430 Emulator is free software: you can redistribute it and/or
+  modify it under the terms of the GNU General Public License as
+  published by the Free Software Foundation, either version 3 of the
+  License, or (at your option) any later version.
+
+  MSP430 Emulator is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with MSP430 Emulator.
+  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef _DISASSEMBLER_H_
+#define _DISASSEMBLER_H_
+
+#include <stdint.h>
+
+/**
+ * @brief Disassemble an instruction. Reads no memory or CPU state, so it
+ * can be used on any code, executed or not
+ * @param address Address of the instruction word, for symbolic operands and
+ * jump targets
+ * @param words The instruction word followed by its extension words, see
+ * instruction_length()
+ * @param disas Receives the disassembly, DISAS_STR_LEN bytes
+ * @return Length of the instruction in words
+ */
+uint8_t disassemble(uint16_t address, const uint16_t *words, char *disas);
+
+/**
+ * @brief Get the mnemonic of an instruction, without width suffix
+ * @param instruction The instruction word
+ * @return Mnemonic, "???" if the instruction is invalid
+ */
+const char *instruction_mnemonic(uint16_t instruction);
+
+#endif
@@ -0,0 +1,55 @@
+/*
+  This file is part of MSP430 Emulator
+
+  MSP430 Emulator is free software: you can redistribute it and/or
+  modify it under the terms of the GNU General Public License as
+  published by the Free Software Foundation, either version 3 of the
+  License, or (at your option) any later version.
+
+  MSP430 Emulator is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with MSP430 Emulator.
+  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+//##########+++ Execute Predecoded Instructions +++##########
+//# All fields and extension words have been extracted by the
+//# predecoder, so this stage only resolves operands that
+//# depend on register or memory contents.
+//###########################################################
+
+#include "execute.h"
+#include "decoder.h"
+#include "execute_impl.h"
+
+void execute(Cpu *cpu, const decoded_op_t *op, instruction_t *instr) {
+  instr->isDestPC = false;
+  instr->format = op->format;
+
+  if (op->format == 0) { /* Let the reference decoder report it */
+    decode(cpu, fetch(cpu), NULL, instr);
+    return;
+  }
+
+  exec_prologue(cpu, op);
+
+  switch (op->format) {
+  case 1:
+    exec_formatI(cpu, op, op->opcode, op->src_mode, op->dst_mode,
+                 op->bw_flag);
+    instr->isDestPC =
+        op->dst_mode == MODE_REGISTER && op->destination == REG_PC;
+    break;
+  case 2:
+    instr->isDestPC =
+        exec_formatII(cpu, op, op->opcode, op->src_mode, op->bw_flag);
+    break;
+  default:
+    instr->isDestPC = exec_formatIII(cpu, op, op->opcode);
+    break;
+  }
+}
@@ -0,0 +1,36 @@
+/*
+  This file is part of MSP430 Emulator
+
+  MSP430 Emulator is free software: you can redistribute it and/or
+  modify it under the terms of the GNU General Public License as
+  published by the Free Software Foundation, either version 3 of the
+  License, or (at your option) any later version.
+
+  MSP430 Emulator is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with MSP430 Emulator.
+  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef _EXECUTE_H_
+#define _EXECUTE_H_
+
+#include "../utilities.h"
+#include "predecode.h"
+#include "registers.h"
+
+/**
+ * @brief Execute a predecoded instruction. cpu->pc must hold the address the
+ * instruction was decoded from; it is advanced past the instruction words
+ * exactly as fetch() and decode() would.
+ * @param cpu A pointer to the CPU structure
+ * @param op The predecoded instruction
+ * @param instr Receives format and isDestPC; the mnemonic is not filled in
+ */
+void execute(Cpu *cpu, const decoded_op_t *op, instruction_t *instr);
+
+#endif
@@ -0,0 +1,209 @@
+/*
+  This file is part of MSP430 Emulator
+
+  MSP430 Emulator is free software: you can redistribute it and/or
+  modify it under the terms of the GNU General Public License as
+  published by the Free Software Foundation, either version 3 of the
+  License, or (at your option) any later version.
+
+  MSP430 Emulator is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with MSP430 Emulator.
+  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+//##########+++ Predecoded Instruction Bodies +++##########
+//# Operand resolution for predecoded instructions. Opcode,
+//# operand modes and width are parameters rather than read
+//# from the record, so engines that call these with
+//# constants get a specialized copy with the mode, opcode
+//# and byte/word checks folded away.
+//#
+//# The PC has already been advanced past the whole
+//# instruction. This matches the reference decoder, which
+//# fetches all extension words before it reads any register
+//# operand.
+//#########################################################
+
+#ifndef _EXECUTE_IMPL_H_
+#define _EXECUTE_IMPL_H_
+
+#include "alu.h"
+#include "predecode.h"
+#include "profiler.h"
+
+/* Modes that use the register named in the instruction */
+#define SRC_USES_REG(mode)                                                     \
+  ((mode) == MODE_REGISTER || (mode) == MODE_INDEXED ||                        \
+   (mode) == MODE_INDIRECT || (mode) == MODE_AUTOINC)
+#define DST_USES_REG(mode) ((mode) == MODE_REGISTER || (mode) == MODE_INDEXED)
+
+static ALWAYS_INLINE void exec_formatI(Cpu *cpu, const decoded_op_t *op,
+                                       uint8_t opcode, uint8_t src_mode,
+                                       uint8_t dst_mode, uint8_t bw_flag) {
+  bus_t *bus = &cpu->mcu->bus;
+  uint16_t *s_reg =
+      SRC_USES_REG(src_mode) ? get_reg_ptr(cpu, op->source) : NULL;
+  uint16_t *d_reg =
+      DST_USES_REG(dst_mode) ? get_reg_ptr(cpu, op->destination) : NULL;
+  int16_t source_value, dest_value = 0;
+  uint16_t dest_vaddress = 0;
+  bool is_daddr_virtual = dst_mode != MODE_REGISTER;
+
+#ifdef MSP430_LAZY_FLAGS
+  /* R2 is only SR in register mode, otherwise it selects &ADDR or #C */
+  if ((src_mode == MODE_REGISTER && op->source == REG_SR) ||
+      (dst_mode == MODE_REGISTER && op->destination == REG_SR)) {
+    sync_sr(cpu);
+  }
+#endif
+
+  switch (src_mode) {
+  case MODE_REGISTER:
+    source_value = *s_reg;
+    break;
+  case MODE_INDEXED:
+    source_value = mem_read(bus, *s_reg + op->src_word, bw_flag);
+    break;
+  case MODE_SYMBOLIC:
+  case MODE_ABSOLUTE:
+    source_value = mem_read(bus, op->src_word, bw_flag);
+    break;
+  case MODE_INDIRECT:
+    source_value = mem_read(bus, *s_reg, bw_flag);
+    break;
+  case MODE_AUTOINC:
+    source_value = mem_read(bus, *s_reg, bw_flag);
+    *s_reg += bw_flag ? 1 : 2;
+    register_write_notify(cpu, 1);
+    break;
+  default: /* Constant or immediate */
+    source_value = op->src_word;
+    break;
+  }
+
+  switch (dst_mode) {
+  case MODE_REGISTER:
+    dest_value = *d_reg;
+    break;
+  case MODE_INDEXED:
+    dest_vaddress = *d_reg + op->dst_word;
+    break;
+  default: /* Symbolic or absolute */
+    dest_vaddress = op->dst_word;
+    break;
+  }
+
+  if (is_daddr_virtual && opcode != OP_MOV) {
+    dest_value = mem_read(bus, dest_vaddress, bw_flag);
+  }
+
+  alu_formatI(cpu, opcode, bw_flag, source_value, dest_value,
+              is_daddr_virtual, dest_vaddress, d_reg);
+}
+
+static ALWAYS_INLINE bool exec_formatII(Cpu *cpu, const decoded_op_t *op,
+                                        uint8_t opcode, uint8_t src_mode,
+                                        uint8_t bw_flag) {
+  bus_t *bus = &cpu->mcu->bus;
+  uint16_t *reg =
+      SRC_USES_REG(src_mode) ? get_reg_ptr(cpu, op->source) : NULL;
+  uint16_t bogus_reg; /* For immediate values to be operated on */
+  uint16_t *source_address = reg;
+  uint16_t source_vaddress = 0;
+  int16_t source_value;
+  bool is_saddr_virtual = true;
+
+#ifdef MSP430_LAZY_FLAGS
+  if (src_mode == MODE_REGISTER && op->source == REG_SR) {
+    sync_sr(cpu);
+  }
+#endif
+
+  switch (src_mode) {
+  case MODE_REGISTER:
+    source_value = *reg;
+    is_saddr_virtual = false;
+    break;
+  case MODE_SYMBOLIC:
+  case MODE_ABSOLUTE:
+    source_vaddress = op->src_word;
+    if (opcode == OP_CALL) {
+      // Special case for CALL instruction!
+      source_value = source_vaddress;
+    } else {
+      source_value = mem_read(bus, source_vaddress, bw_flag);
+    }
+    break;
+  case MODE_INDEXED:
+    source_vaddress = *reg + op->src_word;
+    source_value = mem_read(bus, source_vaddress, bw_flag);
+    break;
+  case MODE_INDIRECT:
+    source_vaddress = *reg;
+    source_value = mem_read(bus, source_vaddress, bw_flag);
+    break;
+  case MODE_AUTOINC:
+    source_vaddress = *reg;
+    source_value = mem_read(bus, source_vaddress, bw_flag);
+    *reg += bw_flag ? 1 : 2;
+    register_write_notify(cpu, 1);
+    break;
+  default: /* Constant or immediate */
+    source_value = bogus_reg = op->src_word;
+    source_address = &bogus_reg;
+    is_saddr_virtual = false;
+    break;
+  }
+
+  return alu_formatII(cpu, opcode, bw_flag, source_value,
+                      is_saddr_virtual, source_vaddress, source_address);
+}
+
+/**
+ * @brief Execute the prologue shared by every predecoded instruction:
+ * advance PC past the instruction and charge static notifications.
+ */
+static ALWAYS_INLINE void exec_prologue(Cpu *cpu, const decoded_op_t *op) {
+  profile_instructions(cpu, cpu->pc, 1, op->cycles);
+  cpu->pc += 2 * op->length;
+  register_read_notify(cpu, op->reg_reads);
+  consume_cycles(cpu, op->cycles);
+}
+
+static ALWAYS_INLINE bool exec_formatIII(Cpu *cpu, const decoded_op_t *op,
+                                         uint8_t condition) {
+  if (alu_jump_taken(cpu, condition)) {
+    cpu->pc += op->src_word;
+    register_write_notify(cpu, 1);
+    return true;
+  }
+  return false;
+}
+
+/**
+ * @brief Execute the jump of a fused ALU + Jcc pair, see fusion.h. With
+ * MSP430_LAZY_FLAGS the condition is tested against the pending ALU
+ * operation, and SR stays pending
+ * @param kind Flag kind of the ALU operation (FLAGS_ADD, FLAGS_SUB or
+ * FLAGS_LOGIC)
+ */
+static ALWAYS_INLINE void exec_fused_jump(Cpu *cpu, const decoded_op_t *op,
+                                          uint8_t kind) {
+#ifdef MSP430_LAZY_FLAGS
+  bool taken = alu_pending_jump_taken(&cpu->flags, kind, op->opcode);
+#else
+  bool taken = alu_jump_taken(cpu, op->opcode);
+#endif
+
+  if (taken) {
+    cpu->pc += op->src_word;
+    register_write_notify(cpu, 1);
+  }
+}
+
+#endif
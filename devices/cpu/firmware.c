@@ -0,0 +1,425 @@
+/*
+  This file is part of MSP430 Emulator
+
+  MSP430 Emulator is free software: you can redistribute it and/or
+  modify it under the terms of the GNU General Public License as
+  published by the Free Software Foundation, either version 3 of the
+  License, or (at your option) any later version.
+
+  MSP430 Emulator is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with MSP430 Emulator.
+  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+//##########+++ Firmware Loader +++##########
+//# Loads ELF, Intel HEX and TI-TXT images. Files are
+//# mapped, not read, and whole pages of ELF segments are
+//# mapped into the address space straight from the file,
+//# so booting an instance copies little more than the
+//# pages that segments share.
+//###########################################
+
+#include "firmware.h"
+#include <elf.h>
+#include <fcntl.h>
+#include <stddef.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define RESET_VECTOR 0xFFFE
+#define NO_ENTRY UINT32_MAX
+
+/* Where each page comes from while an image is loaded */
+typedef struct loader {
+  firmware_t *fw;
+  const uint8_t *direct[MEM_PAGES]; /* Filled entirely from the file */
+  bool copied[MEM_PAGES];           /* In fw->image */
+  uint32_t entry;                   /* From the file, or NO_ENTRY */
+} loader_t;
+
+/* Move a page to fw->image, keeping what it holds */
+static bool copy_page(loader_t *ld, uint16_t page) {
+  uint8_t *image;
+
+  if (ld->fw->image == NULL) {
+    ld->fw->image = malloc(0x10000);
+    if (ld->fw->image == NULL) {
+      fprintf(stderr, "Out of memory for the firmware image\n");
+      return false;
+    }
+    memset(ld->fw->image, 0xFF, 0x10000);
+  }
+
+  image = ld->fw->image + (page << MEM_PAGE_SHIFT);
+  if (ld->direct[page] != NULL) {
+    memcpy(image, ld->direct[page], MEM_PAGE_SIZE);
+    ld->direct[page] = NULL;
+  }
+  ld->copied[page] = true;
+  return true;
+}
+
+static bool load_bytes(loader_t *ld, uint32_t address, const uint8_t *data,
+                       size_t len, bool from_file) {
+  uint32_t end;
+
+  if (address > 0x10000 || len > 0x10000 - address) {
+    fprintf(stderr, "Firmware data at %05X is beyond 0xFFFF\n", address);
+    return false;
+  }
+  end = address + len;
+
+  while (address < end) {
+    uint16_t page = address >> MEM_PAGE_SHIFT;
+    uint32_t stop = (uint32_t)(page + 1) << MEM_PAGE_SHIFT;
+
+    if (stop > end) {
+      stop = end;
+    }
+
+    if (from_file && !(address & (MEM_PAGE_SIZE - 1)) &&
+        stop - address == MEM_PAGE_SIZE && ld->direct[page] == NULL &&
+        !ld->copied[page]) {
+      ld->direct[page] = data;
+    } else {
+      if (!ld->copied[page] && !copy_page(ld, page)) {
+        return false;
+      }
+      memcpy(ld->fw->image + address, data, stop - address);
+    }
+
+    data += stop - address;
+    address = stop;
+  }
+  return true;
+}
+
+/* ELF fields are little-endian, whatever the host is */
+static uint32_t elf_field(const uint8_t *p, size_t size) {
+  uint32_t value = 0;
+
+  while (size--) {
+    value = value << 8 | p[size];
+  }
+  return value;
+}
+
+#define EHDR(file, field)                                                      \
+  elf_field((file) + offsetof(Elf32_Ehdr, field),                              \
+            sizeof(((Elf32_Ehdr *)0)->field))
+#define PHDR(ph, field)                                                        \
+  elf_field((ph) + offsetof(Elf32_Phdr, field),                                \
+            sizeof(((Elf32_Phdr *)0)->field))
+
+static bool load_elf(loader_t *ld, const uint8_t *file, size_t len) {
+  uint32_t phoff, phentsize, phnum, i;
+
+  if (len < sizeof(Elf32_Ehdr) || memcmp(file, ELFMAG, SELFMAG) ||
+      file[EI_CLASS] != ELFCLASS32 || file[EI_DATA] != ELFDATA2LSB ||
+      EHDR(file, e_machine) != EM_MSP430) {
+    fprintf(stderr, "Not a 32-bit MSP430 ELF file\n");
+    return false;
+  }
+
+  phoff = EHDR(file, e_phoff);
+  phentsize = EHDR(file, e_phentsize);
+  phnum = EHDR(file, e_phnum);
+  if (phentsize < sizeof(Elf32_Phdr) || phoff > len ||
+      (uint64_t)phnum * phentsize > len - phoff) {
+    fprintf(stderr, "Malformed ELF program headers\n");
+    return false;
+  }
+
+  for (i = 0; i < phnum; i++) {
+    const uint8_t *ph = file + phoff + i * phentsize;
+    uint32_t offset = PHDR(ph, p_offset);
+    uint32_t filesz = PHDR(ph, p_filesz);
+
+    if (PHDR(ph, p_type) != PT_LOAD || filesz == 0) {
+      continue;
+    }
+    if (offset > len || filesz > len - offset) {
+      fprintf(stderr, "ELF segment %u is outside the file\n", i);
+      return false;
+    }
+    if (!load_bytes(ld, PHDR(ph, p_paddr), file + offset, filesz, true)) {
+      return false;
+    }
+  }
+
+  ld->entry = EHDR(file, e_entry);
+  return true;
+}
+
+static int hex_digit(char c) {
+  if (c >= '0' && c <= '9') {
+    return c - '0';
+  } else if (c >= 'a' && c <= 'f') {
+    return c - 'a' + 10;
+  } else if (c >= 'A' && c <= 'F') {
+    return c - 'A' + 10;
+  }
+  return -1;
+}
+
+/* Two hex digits at *p, which is advanced */
+static bool hex_byte(const char **p, const char *end, uint8_t *out) {
+  int hi, lo;
+
+  if (end - *p < 2 || (hi = hex_digit((*p)[0])) < 0 ||
+      (lo = hex_digit((*p)[1])) < 0) {
+    return false;
+  }
+  *out = hi << 4 | lo;
+  *p += 2;
+  return true;
+}
+
+static const char *skip_space(const char *p, const char *end,
+                              unsigned *line) {
+  while (p < end && (*p == ' ' || *p == '\t' || *p == '\r' || *p == '\n')) {
+    *line += *p++ == '\n';
+  }
+  return p;
+}
+
+static bool load_ihex(loader_t *ld, const char *p, const char *end) {
+  uint32_t base = 0;
+  unsigned line = 1;
+
+  while ((p = skip_space(p, end, &line)) < end) {
+    uint8_t record[5 + 255]; /* Count, address, type, data, checksum */
+    uint8_t sum = 0, count, type;
+    uint16_t offset, i;
+
+    if (*p++ != ':' || !hex_byte(&p, end, &record[0])) {
+      fprintf(stderr, "Intel HEX line %u: expected a record\n", line);
+      return false;
+    }
+    for (i = 1; i < record[0] + 5u; i++) {
+      if (!hex_byte(&p, end, &record[i])) {
+        fprintf(stderr, "Intel HEX line %u: record too short\n", line);
+        return false;
+      }
+    }
+    for (i = 0; i < record[0] + 5u; i++) {
+      sum += record[i];
+    }
+    if (sum != 0) {
+      fprintf(stderr, "Intel HEX line %u: bad checksum\n", line);
+      return false;
+    }
+
+    count = record[0];
+    offset = record[1] << 8 | record[2];
+    type = record[3];
+    if ((type == 0x02 || type == 0x04) && count != 2) {
+      fprintf(stderr, "Intel HEX line %u: bad address record\n", line);
+      return false;
+    } else if ((type == 0x03 || type == 0x05) && count != 4) {
+      fprintf(stderr, "Intel HEX line %u: bad start address record\n", line);
+      return false;
+    }
+
+    switch (type) {
+    case 0x00: /* Data */
+      if (!load_bytes(ld, base + offset, &record[4], count, false)) {
+        return false;
+      }
+      break;
+    case 0x01: /* End of file */
+      return true;
+    case 0x02: /* Extended segment address */
+      base = (record[4] << 8 | record[5]) << 4;
+      break;
+    case 0x03: /* Start segment address, CS:IP */
+      ld->entry = ((record[4] << 8 | record[5]) << 4) +
+                  (record[6] << 8 | record[7]);
+      break;
+    case 0x04: /* Extended linear address */
+      base = (uint32_t)(record[4] << 8 | record[5]) << 16;
+      break;
+    case 0x05: /* Start linear address */
+      ld->entry = (uint32_t)record[4] << 24 | record[5] << 16 |
+                  record[6] << 8 | record[7];
+      break;
+    default:
+      fprintf(stderr, "Intel HEX line %u: unknown record type %02X\n", line,
+              type);
+      return false;
+    }
+  }
+  return true;
+}
+
+static bool load_titxt(loader_t *ld, const char *p, const char *end) {
+  uint32_t address = 0;
+  unsigned line = 1;
+  uint8_t byte;
+
+  while ((p = skip_space(p, end, &line)) < end) {
+    if (*p == 'q' || *p == 'Q') {
+      return true;
+    } else if (*p == '@') {
+      int digit;
+
+      address = 0;
+      for (p++; p < end && (digit = hex_digit(*p)) >= 0; p++) {
+        address = (address << 4 | digit) & 0xFFFFF;
+      }
+    } else if (hex_byte(&p, end, &byte)) {
+      if (!load_bytes(ld, address++, &byte, 1, false)) {
+        return false;
+      }
+    } else {
+      fprintf(stderr, "TI-TXT line %u: expected @address, data or q\n",
+              line);
+      return false;
+    }
+  }
+  return true;
+}
+
+/* Map runs of pages that are contiguous in host memory with one call */
+static void map_pages(loader_t *ld) {
+  uint32_t page = 0, run;
+
+  while (page < MEM_PAGES) {
+    const uint8_t *host;
+
+    if (ld->direct[page] != NULL) {
+      host = ld->direct[page];
+    } else if (ld->copied[page]) {
+      host = ld->fw->image + (page << MEM_PAGE_SHIFT);
+    } else {
+      page++;
+      continue;
+    }
+
+    for (run = 1; page + run < MEM_PAGES; run++) {
+      const uint8_t *next =
+          ld->copied[page + run]
+              ? ld->fw->image + ((page + run) << MEM_PAGE_SHIFT)
+              : ld->direct[page + run];
+
+      if (next != host + (run << MEM_PAGE_SHIFT)) {
+        break;
+      }
+    }
+
+    map_host_memory(&ld->fw->mcu->bus, page << MEM_PAGE_SHIFT,
+                    (uint8_t *)host, run << MEM_PAGE_SHIFT, false);
+    for (; run; run--, page++) {
+      ld->fw->mapped[page >> 3] |= 1u << (page & 7);
+    }
+  }
+}
+
+static firmware_format_t detect_format(const uint8_t *file, size_t len) {
+  size_t i;
+
+  if (len >= SELFMAG && !memcmp(file, ELFMAG, SELFMAG)) {
+    return FIRMWARE_ELF;
+  }
+  for (i = 0; i < len && strchr(" \t\r\n", file[i]) != NULL; i++) {
+  }
+  return i < len && file[i] == ':' ? FIRMWARE_IHEX : FIRMWARE_TITXT;
+}
+
+bool load_firmware(const char *path, firmware_format_t format, Cpu *cpu,
+                   firmware_t *fw) {
+  loader_t *ld;
+  struct stat st;
+  bool ok = false;
+  int fd;
+
+  memset(fw, 0, sizeof *fw);
+  fw->mcu = cpu->mcu;
+
+  fd = open(path, O_RDONLY);
+  if (fd < 0 || fstat(fd, &st) < 0 || st.st_size == 0) {
+    fprintf(stderr, "Cannot read %s\n", path);
+    if (fd >= 0) {
+      close(fd);
+    }
+    return false;
+  }
+
+  fw->file_len = st.st_size;
+  fw->file = mmap(NULL, fw->file_len, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd); /* The mapping stays */
+  if (fw->file == MAP_FAILED) {
+    fprintf(stderr, "Cannot map %s\n", path);
+    fw->file = NULL;
+    return false;
+  }
+
+  ld = calloc(1, sizeof *ld);
+  if (ld == NULL) {
+    unload_firmware(fw);
+    return false;
+  }
+  ld->fw = fw;
+  ld->entry = NO_ENTRY;
+
+  if (format == FIRMWARE_AUTO) {
+    format = detect_format(fw->file, fw->file_len);
+  }
+  switch (format) {
+  case FIRMWARE_ELF:
+    ok = load_elf(ld, fw->file, fw->file_len);
+    break;
+  case FIRMWARE_IHEX:
+    ok = load_ihex(ld, fw->file, (const char *)fw->file + fw->file_len);
+    break;
+  default:
+    ok = load_titxt(ld, fw->file, (const char *)fw->file + fw->file_len);
+    break;
+  }
+
+  if (ok) {
+    map_pages(ld);
+
+    // The reset vector, if the image has one, as erased flash is 0xFFFF
+    if ((ld->direct[RESET_VECTOR >> MEM_PAGE_SHIFT] != NULL ||
+         ld->copied[RESET_VECTOR >> MEM_PAGE_SHIFT]) &&
+        mem_read(&fw->mcu->bus, RESET_VECTOR, WORD) != 0xFFFF) {
+      cpu->pc = mem_read(&fw->mcu->bus, RESET_VECTOR, WORD);
+    } else if (ld->entry <= 0xFFFF) {
+      cpu->pc = ld->entry;
+    } else {
+      fprintf(stderr, "%s has no reset vector or entry point\n", path);
+      ok = false;
+    }
+  }
+
+  free(ld);
+  if (!ok) {
+    unload_firmware(fw);
+  }
+  return ok;
+}
+
+void unload_firmware(firmware_t *fw) {
+  uint32_t page;
+
+  for (page = 0; page < MEM_PAGES; page++) {
+    if (fw->mapped[page >> 3] & (1u << (page & 7))) {
+      unmap_host_memory(&fw->mcu->bus, page << MEM_PAGE_SHIFT,
+                        MEM_PAGE_SIZE);
+    }
+  }
+
+  if (fw->file != NULL) {
+    munmap(fw->file, fw->file_len);
+  }
+  free(fw->image);
+  memset(fw, 0, sizeof *fw);
+}
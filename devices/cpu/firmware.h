@@ -0,0 +1,72 @@
+/*
+  This file is part of MSP430 Emulator
+
+  MSP430 Emulator is free software: you can redistribute it and/or
+  modify it under the terms of the GNU General Public License as
+  published by the Free Software Foundation, either version 3 of the
+  License, or (at your option) any later version.
+
+  MSP430 Emulator is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with MSP430 Emulator.
+  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#ifndef _FIRMWARE_H_
+#define _FIRMWARE_H_
+
+#include "../utilities.h"
+#include "msp430.h"
+
+/* File formats read by load_firmware() */
+typedef enum {
+  FIRMWARE_AUTO,  /* Detected from the first bytes of the file */
+  FIRMWARE_ELF,   /* 32-bit MSP430 ELF executable */
+  FIRMWARE_IHEX,  /* Intel HEX */
+  FIRMWARE_TITXT, /* TI-TXT: @address lines, hex bytes, q */
+} firmware_format_t;
+
+/* A loaded image, released with unload_firmware() */
+typedef struct firmware {
+  msp430_t *mcu; /* The MCU it is loaded into */
+  void *file; /* The file, mapped into the host's memory */
+  size_t file_len;
+  uint8_t *image;                 /* Pages not mapped from the file, or NULL */
+  uint8_t mapped[MEM_PAGES >> 3]; /* Pages mapped by the loader */
+} firmware_t;
+
+/**
+ * @brief Load a firmware image into the address space and set PC from the
+ * reset vector. The file is mapped into the host's memory, and pages that an
+ * ELF segment fills entirely are mapped from it read-only with
+ * map_host_memory(), without being copied. Segments are loaded at their
+ * physical (load) address. Other pages that hold image data are copied to a
+ * buffer, where bytes not in the image read 0xFF, as erased flash does.
+ * Addresses the image does not touch keep their previous mapping.
+ *
+ * If the image has no reset vector, PC is set from the ELF entry point or the
+ * start address record of an Intel HEX file.
+ * @param path The file
+ * @param format Its format, or FIRMWARE_AUTO
+ * @param cpu A pointer to the CPU of the MCU to load it into
+ * @param fw Receives the loaded image, which must stay loaded while the CPU
+ * runs it
+ * @return false if the file could not be read, is malformed, or has data
+ * beyond 0xFFFF, or no start address. Errors are reported on stderr
+ */
+bool load_firmware(const char *path, firmware_format_t format, Cpu *cpu,
+                   firmware_t *fw);
+
+/**
+ * @brief Unmap the pages of a loaded image, see unmap_host_memory(), and
+ * release the file and buffer
+ * @param fw The image
+ */
+void unload_firmware(firmware_t *fw);
+
+#endif
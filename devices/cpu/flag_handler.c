@@ -166,3 +166,37 @@ uint8_t is_overflowed(uint16_t source_value, uint16_t destination_value,
 
   return false;
 }
+
+/**
+ * @brief Evaluate C, Z, N and V from the last flag-producing operation and
+ * write them to SR
+ * @param cpu A pointer to the CPU structure
+ */
+void evaluate_flags(Cpu *cpu) {
+  const lazy_flags_t *f = &cpu->flags;
+  bool c, z, n, v;
+
+  z = is_zero(f->result, f->bw_flag);
+  n = is_negative(f->result, f->bw_flag);
+
+  switch (f->kind) {
+  case FLAGS_ADD:
+    c = is_add_carry(f->dst, f->src, f->carry_in, f->bw_flag);
+    v = is_add_overflow(f->dst, f->src, f->carry_in, f->bw_flag);
+    break;
+  case FLAGS_SUB:
+    c = is_sub_carry(f->dst, f->src, f->carry_in, f->bw_flag);
+    v = is_sub_overflow(f->dst, f->src, f->carry_in, f->bw_flag);
+    break;
+  case FLAGS_XOR: /* V: Set if both operands are negative */
+    c = !z;
+    v = is_negative(f->dst, f->bw_flag) && is_negative(f->src, f->bw_flag);
+    break;
+  default: /* BIT, AND */
+    c = !z;
+    v = false;
+    break;
+  }
+
+  set_sr_flags(cpu, c, z, n, v);
+}
@@ -22,5 +22,5 @@
 #include "flag_handler.h"
 #include "decoder.h"
 
-void decode_formatII(Cpu *cpu, uint16_t instruction, char *disas, instruction_t *instr);
+void decode_formatII(Cpu *cpu, uint16_t instruction, instruction_t *instr);
 #endif
@@ -21,6 +21,6 @@
 
 #include "decoder.h"
 
-void decode_formatIII(Cpu *cpu, uint16_t instruction, char *disas, instruction_t *instr);
+void decode_formatIII(Cpu *cpu, uint16_t instruction, instruction_t *instr);
 
 #endif
@@ -0,0 +1,108 @@
+/*
+  This file is part of MSP430 Emulator
+
+  MSP430 Emulator is free software: you can redistribute it and/or
+  modify it under the terms of the GNU General Public License as
+  published by the Free Software Foundation, either version 3 of the
+  License, or (at your option) any later version.
+
+  MSP430 Emulator is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with MSP430 Emulator.
+  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+//##########+++ Superinstruction Fusion +++##########
+//# Recognizes instruction pairs that compiled code is
+//# full of, when a basic block is built, and gives the
+//# first of them a fused handler. Fused handlers run both
+//# instructions exactly as the block interpreter would one
+//# after the other, minus the dispatch in between.
+//###################################################
+
+#include "fusion.h"
+#include "msp430.h"
+#include "opcodes.h"
+
+static const char *const fusion_names[FUSION_KINDS] = {
+    [FUSION_ADD_JCC] = "ADD+Jcc", [FUSION_SUB_JCC] = "SUB+Jcc",
+    [FUSION_CMP_JCC] = "CMP+Jcc", [FUSION_BIT_JCC] = "BIT+Jcc",
+    [FUSION_COPY] = "MOV@+ +ADD"};
+
+/* Position of ALU opcodes among the ALU + Jcc handlers, see handlers.h */
+static int8_t jcc_index(uint8_t opcode) {
+  switch (opcode) {
+  case OP_ADD:
+    return 0;
+  case OP_SUB:
+    return 1;
+  case OP_CMP:
+    return 2;
+  case OP_BIT:
+    return 3;
+  default:
+    return -1;
+  }
+}
+
+static bool is_value(uint8_t mode) {
+  return mode == MODE_CONSTANT || mode == MODE_IMMEDIATE;
+}
+
+static uint16_t fused_handler(const decoded_op_t *first,
+                              const decoded_op_t *second) {
+  if (first->format != 1) {
+    return 0;
+  }
+
+  /* Register-only ALU operation setting the flags a conditional jump tests */
+  if (second->format == 3 && second->opcode != 7 &&
+      jcc_index(first->opcode) >= 0 && first->dst_mode == MODE_REGISTER &&
+      first->destination != REG_PC &&
+      (first->src_mode == MODE_REGISTER || is_value(first->src_mode))) {
+    return FUSED_JCC_BASE +
+           ((jcc_index(first->opcode) * 2 + is_value(first->src_mode)) * 2 +
+            first->bw_flag);
+  }
+
+  /* Copy step, advancing the destination pointer */
+  if (first->opcode == OP_MOV && first->src_mode == MODE_AUTOINC &&
+      first->dst_mode == MODE_INDEXED && second->format == 1 &&
+      second->opcode == OP_ADD && is_value(second->src_mode) &&
+      second->dst_mode == MODE_REGISTER && second->bw_flag == WORD &&
+      second->destination == first->destination) {
+    return FUSED_COPY_BASE + first->bw_flag;
+  }
+
+  return 0;
+}
+
+void fuse_ops(decoded_op_t *ops, uint16_t count) {
+  uint16_t i, handler;
+
+  for (i = 0; i + 1 < count; i++) {
+    handler = fused_handler(&ops[i], &ops[i + 1]);
+    if (handler) {
+      ops[i].handler = handler;
+      i++;
+    }
+  }
+}
+
+void print_fusion_stats(const msp430_t *mcu, FILE *out) {
+  int i;
+
+  fprintf(out, "%-12s %s\n", "Fusion", "Fired");
+  for (i = 0; i < FUSION_KINDS; i++) {
+    fprintf(out, "%-12s %llu\n", fusion_names[i],
+            (unsigned long long)mcu->stats.fusions[i]);
+  }
+}
+
+void reset_fusion_stats(msp430_t *mcu) {
+  memset(mcu->stats.fusions, 0, sizeof mcu->stats.fusions);
+}
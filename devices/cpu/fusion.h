@@ -0,0 +1,80 @@
+/*
+  This file is part of MSP430 Emulator
+
+  MSP430 Emulator is free software: you can redistribute it and/or
+  modify it under the terms of the GNU General Public License as
+  published by the Free Software Foundation, either version 3 of the
+  License, or (at your option) any later version.
+
+  MSP430 Emulator is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with MSP430 Emulator.
+  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef _FUSION_H_
+#define _FUSION_H_
+
+#include "decode_table.h"
+#include "handlers.h"
+#include "predecode.h"
+#include <stdio.h>
+
+/* Kinds of superinstructions */
+typedef enum {
+  FUSION_ADD_JCC, /* ADD #C/Rs, Rd ; Jcc   (ADD #-1 countdowns) */
+  FUSION_SUB_JCC, /* SUB #C/Rs, Rd ; Jcc   (DEC countdowns) */
+  FUSION_CMP_JCC, /* CMP #C/Rs, Rd ; Jcc */
+  FUSION_BIT_JCC, /* BIT #C/Rs, Rd ; Jcc */
+  FUSION_COPY,    /* MOV @Rs+, X(Rd) ; ADD #C, Rd   (copy loops) */
+  FUSION_KINDS,
+} fusion_t;
+
+/**
+ * @brief Replace the handlers of instruction pairs in a basic block by fused
+ * handlers, which run both instructions with one dispatch. Pairs are matched
+ * left to right and do not overlap; the second instruction of a pair keeps
+ * its record so the block can still be charged per instruction
+ * @param ops The instructions of the block
+ * @param count Number of instructions
+ */
+void fuse_ops(decoded_op_t *ops, uint16_t count);
+
+/**
+ * @brief Get the handler of an instruction as if it was not fused, for
+ * engines that run pairs as two instructions
+ * @param op The (possibly fused) instruction
+ * @return Handler index below HANDLER_COUNT
+ */
+static inline uint16_t unfused_handler(const decoded_op_t *op) {
+  return op->handler < HANDLER_COUNT ? op->handler
+                                     : decode_table[op->instruction].handler;
+}
+
+/**
+ * @brief Get the kind of superinstruction a fused instruction starts
+ * @param op The first instruction of a pair, whose handler is at or above
+ * HANDLER_COUNT
+ * @return The kind, counted in msp430_stats_t
+ */
+static inline fusion_t fusion_kind(const decoded_op_t *op) {
+  return op->handler >= FUSED_COPY_BASE
+             ? FUSION_COPY
+             : (fusion_t)((op->handler - FUSED_JCC_BASE) / 4);
+}
+
+/**
+ * @brief Write how often each superinstruction ran on an MCU, see
+ * msp430_stats_t
+ * @param mcu The MCU
+ * @param out Stream to write to
+ */
+void print_fusion_stats(const msp430_t *mcu, FILE *out);
+
+void reset_fusion_stats(msp430_t *mcu);
+
+#endif
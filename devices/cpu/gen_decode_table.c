@@ -0,0 +1,70 @@
+/*
+  This file is part of MSP430 Emulator
+
+  MSP430 Emulator is free software: you can redistribute it and/or
+  modify it under the terms of the GNU General Public License as
+  published by the Free Software Foundation, either version 3 of the
+  License, or (at your option) any later version.
+
+  MSP430 Emulator is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with MSP430 Emulator.
+  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+//##########+++ Decode Table Generator +++##########
+//# Build-time tool writing decode_table, the result of
+//# decode_word() for every instruction word, as C source.
+//#
+//# usage: gen_decode_table <output.c>
+//##################################################
+
+#include "decode_table.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+int main(int argc, char **argv) {
+  FILE *out;
+  decode_entry_t op;
+  uint32_t word;
+  int model;
+
+  if (argc != 2) {
+    fprintf(stderr, "usage: %s <output.c>\n", argv[0]);
+    exit(1);
+  }
+
+  out = fopen(argv[1], "w");
+  if (out == NULL) {
+    fprintf(stderr, "ERROR: Can't open %s\n", argv[1]);
+    exit(1);
+  }
+
+  fprintf(out, "/* Generated by gen_decode_table, do not edit */\n\n"
+               "#include \"decode_table.h\"\n\n"
+               "const decode_entry_t decode_table[0x10000] = {\n");
+
+  for (word = 0; word < 0x10000; word++) {
+    decode_word(word, &op);
+    fprintf(out, "{%u,%u,%u,%u,%u,%u,%u,%u,%u,{", op.format, op.opcode,
+            op.bw_flag, op.src_mode, op.dst_mode, op.source, op.destination,
+            op.length, op.reg_reads);
+    for (model = 0; model < CPU_MODELS; model++) {
+      fprintf(out, model ? ",%u" : "%u", op.cycles[model]);
+    }
+    fprintf(out, "},%u,%d},\n", op.handler, op.constant);
+  }
+
+  fprintf(out, "};\n");
+
+  if (fclose(out) != 0) {
+    fprintf(stderr, "ERROR: Can't write %s\n", argv[1]);
+    exit(1);
+  }
+
+  return 0;
+}
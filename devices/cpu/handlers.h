@@ -0,0 +1,103 @@
+/*
+  This file is part of MSP430 Emulator
+
+  MSP430 Emulator is free software: you can redistribute it and/or
+  modify it under the terms of the GNU General Public License as
+  published by the Free Software Foundation, either version 3 of the
+  License, or (at your option) any later version.
+
+  MSP430 Emulator is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with MSP430 Emulator.
+  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+//##########+++ Specialized Handler Layout +++##########
+//# Handlers are specialized by opcode, operand class and
+//# width (W, B), grouping modes that execute alike:
+//#   Source:      REG, VAL (#C, #N), IDX, DIR (ADDR, &ADDR),
+//#                IND, INC
+//#   Destination: REG, IDX, DIR (ADDR, &ADDR)
+//#
+//# Engines instantiate the handler lists below by defining
+//# FI, FII and FIII before use.
+//#####################################################
+
+#ifndef _HANDLERS_H_
+#define _HANDLERS_H_
+
+#include "opcodes.h"
+#include "predecode.h"
+
+#define SRC_REG MODE_REGISTER
+#define SRC_VAL MODE_IMMEDIATE
+#define SRC_IDX MODE_INDEXED
+#define SRC_DIR MODE_ABSOLUTE
+#define SRC_IND MODE_INDIRECT
+#define SRC_INC MODE_AUTOINC
+#define SRC_CLASSES 6
+
+#define DST_REG MODE_REGISTER
+#define DST_IDX MODE_INDEXED
+#define DST_DIR MODE_ABSOLUTE
+#define DST_CLASSES 3
+
+#define BW_W 0
+#define BW_B 1
+
+#define OP_INVALID_II 0x7
+
+/* Handler index layout */
+#define FORMATI_BASE 1
+#define FORMATII_BASE (FORMATI_BASE + 12 * SRC_CLASSES * DST_CLASSES * 2)
+#define FORMATIII_BASE (FORMATII_BASE + 8 * SRC_CLASSES * 2)
+#define HANDLER_COUNT (FORMATIII_BASE + 8)
+
+/* Superinstructions, see fusion.h. Only run_blocks() runs these */
+#define FUSED_JCC_BASE HANDLER_COUNT
+#define FUSED_COPY_BASE (FUSED_JCC_BASE + 4 * 2 * 2)
+#define FUSED_HANDLER_END (FUSED_COPY_BASE + 2)
+
+/* Handler lists, in handler index order */
+#define FI_BW(OPC, S, D) FI(OPC, S, D, W) FI(OPC, S, D, B)
+#define FI_DST(OPC, S) FI_BW(OPC, S, REG) FI_BW(OPC, S, IDX) FI_BW(OPC, S, DIR)
+#define FI_SRC(OPC)                                                            \
+  FI_DST(OPC, REG)                                                             \
+  FI_DST(OPC, VAL)                                                             \
+  FI_DST(OPC, IDX) FI_DST(OPC, DIR) FI_DST(OPC, IND) FI_DST(OPC, INC)
+#define FII_BW(OPC, S) FII(OPC, S, W) FII(OPC, S, B)
+#define FII_SRC(OPC)                                                           \
+  FII_BW(OPC, REG)                                                             \
+  FII_BW(OPC, VAL)                                                             \
+  FII_BW(OPC, IDX) FII_BW(OPC, DIR) FII_BW(OPC, IND) FII_BW(OPC, INC)
+
+#define FORMATI_HANDLERS                                                       \
+  FI_SRC(MOV)                                                                  \
+  FI_SRC(ADD)                                                                  \
+  FI_SRC(ADDC)                                                                 \
+  FI_SRC(SUBC)                                                                 \
+  FI_SRC(SUB)                                                                  \
+  FI_SRC(CMP)                                                                  \
+  FI_SRC(DADD)                                                                 \
+  FI_SRC(BIT) FI_SRC(BIC) FI_SRC(BIS) FI_SRC(XOR) FI_SRC(AND)
+#define FORMATII_HANDLERS                                                      \
+  FII_SRC(RRC)                                                                 \
+  FII_SRC(SWPB)                                                                \
+  FII_SRC(RRA)                                                                 \
+  FII_SRC(SXT) FII_SRC(PUSH) FII_SRC(CALL) FII_SRC(RETI) FII_SRC(INVALID_II)
+#define FORMATIII_HANDLERS                                                     \
+  FIII(0) FIII(1) FIII(2) FIII(3) FIII(4) FIII(5) FIII(6) FIII(7)
+
+#define ALL_HANDLERS FORMATI_HANDLERS FORMATII_HANDLERS FORMATIII_HANDLERS
+
+/* Fused handler lists, defined through FJ (ALU + Jcc) and FC (copy) */
+#define FJ_BW(OPC, S) FJ(OPC, S, W) FJ(OPC, S, B)
+#define FJ_SRC(OPC) FJ_BW(OPC, REG) FJ_BW(OPC, VAL)
+#define FUSED_HANDLERS                                                         \
+  FJ_SRC(ADD) FJ_SRC(SUB) FJ_SRC(CMP) FJ_SRC(BIT) FC(W) FC(B)
+
+#endif
@@ -0,0 +1,94 @@
+/*
+  This file is part of MSP430 Emulator
+
+  MSP430 Emulator is free software: you can redistribute it and/or
+  modify it under the terms of the GNU General Public License as
+  published by the Free Software Foundation, either version 3 of the
+  License, or (at your option) any later version.
+
+  MSP430 Emulator is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with MSP430 Emulator.
+  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+//##########+++ Interrupt Controller +++##########
+//# Peripherals assert and deassert prioritized lines.
+//# The engines test interrupt_requests at instruction or
+//# block boundaries; only when a line is asserted does
+//# accept_interrupt() look at SR_GIE and the priorities.
+//################################################
+
+#include "interrupt.h"
+#include "../utilities.h"
+
+void assert_interrupt(msp430_t *mcu, uint8_t line) {
+  if (line < INTERRUPT_LINES) {
+    mcu->interrupt_requests |= 1u << line;
+  }
+}
+
+void deassert_interrupt(msp430_t *mcu, uint8_t line) {
+  if (line < INTERRUPT_LINES) {
+    mcu->interrupt_requests &= ~(1u << line);
+  }
+}
+
+void set_nonmaskable_interrupts(msp430_t *mcu, uint16_t lines) {
+  mcu->nonmaskable_interrupts = lines;
+}
+
+void set_interrupt_accept_cb(msp430_t *mcu,
+                             void (*fptr)(void *user, uint8_t line)) {
+  mcu->interrupt_accept_cb = fptr;
+}
+
+/* Lines that can be taken now */
+static uint16_t enabled_requests(const Cpu *cpu) {
+  const msp430_t *mcu = cpu->mcu;
+
+  return mcu->interrupt_requests &
+         ((cpu->sr & SR_GIE) ? 0xFFFF : mcu->nonmaskable_interrupts);
+}
+
+bool interrupt_ready(const Cpu *cpu) { return enabled_requests(cpu) != 0; }
+
+bool accept_interrupt(Cpu *cpu) {
+  msp430_t *mcu = cpu->mcu;
+  uint16_t ready = enabled_requests(cpu);
+  uint8_t line = INTERRUPT_LINES - 1;
+
+  if (!ready) {
+    return false;
+  }
+  while (!(ready & (1u << line))) {
+    line--;
+  }
+
+  sync_sr(cpu); /* SR is pushed with its flags */
+
+  // Push PC, then SR, in one burst
+  cpu->sp -= 4;
+  mem_write_words(&mcu->bus, cpu->sp, (const uint16_t[]){cpu->sr, cpu->pc},
+                  2);
+  register_write_notify(cpu, 2);
+
+  if (mcu->interrupt_accept_cb != NULL) {
+    mcu->interrupt_accept_cb(mcu->user, line);
+  }
+
+  // Leave any low-power mode with interrupts disabled, and jump
+  cpu->sr &= SR_SCG0;
+  cpu->pc = mem_read(&mcu->bus, INTERRUPT_VECTORS + 2 * line, WORD);
+  register_write_notify(cpu, 2);
+
+  consume_cycles(cpu, INTERRUPT_ENTRY_CYCLES);
+  flush_register_notify(cpu);
+  mcu->stats.interrupts++;
+  return true;
+}
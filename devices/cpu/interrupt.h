@@ -0,0 +1,97 @@
+/*
+  This file is part of MSP430 Emulator
+
+  MSP430 Emulator is free software: you can redistribute it and/or
+  modify it under the terms of the GNU General Public License as
+  published by the Free Software Foundation, either version 3 of the
+  License, or (at your option) any later version.
+
+  MSP430 Emulator is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with MSP430 Emulator.
+  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#ifndef _INTERRUPT_H_
+#define _INTERRUPT_H_
+
+#include "msp430.h"
+#include "registers.h"
+
+/* Interrupt lines, line n is vectored through 0xFFE0 + 2n. A higher line has
+ * higher priority. 0xFFFE holds the reset vector, which is not a line */
+#define INTERRUPT_LINES 15
+#define INTERRUPT_VECTORS 0xFFE0
+#define INTERRUPT_NMI 14 /* 0xFFFC, non-maskable by default */
+
+/* Cycles to push PC and SR and load the vector */
+#define INTERRUPT_ENTRY_CYCLES 6
+
+/**
+ * @brief Request an interrupt. The line stays asserted, and is taken again
+ * after RETI, until deassert_interrupt(): from the accept callback for
+ * single-source interrupts, or when the handler clears the peripheral's flag
+ * @param mcu The MCU
+ * @param line Interrupt line, below INTERRUPT_LINES
+ */
+void assert_interrupt(msp430_t *mcu, uint8_t line);
+
+/**
+ * @brief Withdraw a request made with assert_interrupt()
+ * @param mcu The MCU
+ * @param line Interrupt line, below INTERRUPT_LINES
+ */
+void deassert_interrupt(msp430_t *mcu, uint8_t line);
+
+/**
+ * @brief Choose which lines are taken while SR_GIE is clear. By default only
+ * INTERRUPT_NMI. Since accepting clears SR_GIE only, a non-maskable line has
+ * to be deasserted when it is accepted, or it is taken again right away
+ * @param mcu The MCU
+ * @param lines One bit per line
+ */
+void set_nonmaskable_interrupts(msp430_t *mcu, uint16_t lines);
+
+/**
+ * @brief Tell a peripheral that one of its lines was accepted, before the
+ * handler runs. NULL, the default, for none
+ * @param mcu The MCU
+ * @param fptr The callback, gets the user pointer of the MCU and the line
+ */
+void set_interrupt_accept_cb(msp430_t *mcu,
+                             void (*fptr)(void *user, uint8_t line));
+
+/**
+ * @brief Check whether an asserted line would be taken at the next
+ * instruction boundary, which also wakes the CPU from a low-power mode
+ * @param cpu A pointer to the CPU structure
+ */
+bool interrupt_ready(const Cpu *cpu);
+
+/**
+ * @brief Take the highest asserted line that SR_GIE allows: push PC and SR,
+ * clear SR except SR_SCG0, and load PC from the line's vector. Charges
+ * INTERRUPT_ENTRY_CYCLES through consume_cycles_cb. RETI returns
+ * @param cpu A pointer to the CPU structure
+ * @return true if an interrupt was taken
+ */
+bool accept_interrupt(Cpu *cpu);
+
+/**
+ * @brief Take a pending interrupt, at an instruction boundary. Costs a single
+ * load-and-test while no line is asserted. The engines poll before every
+ * instruction, except ENGINE_BLOCK and ENGINE_JIT, which poll between blocks
+ * @param cpu A pointer to the CPU structure
+ */
+static inline void poll_interrupts(Cpu *cpu) {
+  if (cpu->mcu->interrupt_requests) {
+    accept_interrupt(cpu);
+  }
+}
+
+#endif
@@ -0,0 +1,1167 @@
+/*
+  This file is part of MSP430 Emulator
+
+  MSP430 Emulator is free software: you can redistribute it and/or
+  modify it under the terms of the GNU General Public License as
+  published by the Free Software Foundation, either version 3 of the
+  License, or (at your option) any later version.
+
+  MSP430 Emulator is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with MSP430 Emulator.
+  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+//##########+++ x86-64 Block Translator +++##########
+//# Hot basic blocks are translated to x86-64 code. R4-R15
+//# live in host registers for the whole block and are
+//# written back to the Cpu at every exit. SP, SR, R3 and
+//# PC stay in the Cpu, and SR is kept up to date, so the
+//# JIT doesn't use lazy flags. Flags no later instruction
+//# or exit can see are not computed.
+//#
+//# Memory operands go through bus.read_pages and
+//# bus.write_pages inline. Pages without host memory, words
+//# that straddle two pages and writes to lines that hold
+//# cached code take an out of line path through
+//# mem_read() and mem_write(). After such a write the code
+//# checks block_generation and returns early when the write
+//# dropped cached code.
+//#
+//# Instructions the translator doesn't handle itself run
+//# their threaded handler. Fused pairs are translated as
+//# their two instructions, and still counted in the stats
+//# of the MCU. Each MCU has its own code memory, which is
+//# never writable and executable at once.
+//#
+//# Registers in translated code:
+//#   rbp          cpu
+//#   rbx r12-r15  R4-R8
+//#   rsi rdi      R9, R10
+//#   r8-r11 rdx   R11-R14, R15
+//#   rax rcx      scratch
+//#   [rsp]        block_generation at entry
+//##################################################
+
+#include "jit.h"
+#include "interrupt.h"
+#include "threaded.h"
+
+uint32_t run_jit(Cpu *cpu, uint32_t count) {
+  msp430_t *mcu = cpu->mcu;
+  uint32_t executed = 0;
+
+  while (executed < count && !cpu_halted(cpu)) {
+    basic_block_t *block;
+    uint16_t ran;
+
+    poll_interrupts(cpu); /* Between blocks only */
+    block = (cpu->pc & 1) ? NULL : get_block(mcu, cpu->pc);
+    if (block == NULL || block->count > count - executed) {
+      executed += run_blocks(cpu, 1);
+      continue;
+    }
+
+    if (block->native == NULL) {
+      if (++block->hits != JIT_THRESHOLD || !jit_compile(mcu, block)) {
+        executed += run_blocks(cpu, block->count);
+        continue;
+      }
+    }
+
+    sync_sr(cpu); /* Translated code reads and writes SR directly */
+    ran = block->native(cpu);
+    executed += ran;
+    charge_block(cpu, block, ran);
+    flush_register_notify(cpu);
+  }
+
+  return executed;
+}
+
+#if defined(MSP430_JIT) && defined(__x86_64__)
+
+#include "execute_impl.h"
+#include "fusion.h"
+#include "handlers.h"
+#include <stddef.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#define JIT_CODE_SIZE (1 << 20)
+
+/* Code shared by all blocks, at the start of code memory */
+#define STUB_SIZE 256
+enum {
+  STUB_EXIT,    /* Write back R4-R15 and return eax */
+  STUB_READ,    /* eax = mem_read(eax), one per width */
+  STUB_READ_B,
+  STUB_WRITE,   /* mem_write(eax, ecx), one per width */
+  STUB_WRITE_B,
+  STUB_HANDLER, /* Call handler rax with op rcx */
+  STUBS
+};
+
+/* Stack frame of translated code, 16-byte aligned after the six pushes */
+#define FRAME_SIZE 40
+#define SLOT_GENERATION 0
+#define SLOT_VALUE 4   /* Value being written */
+#define SLOT_ADDRESS 8 /* Address of a memory destination */
+#define SLOT_SOURCE 12 /* Source operand read from memory */
+#define SLOT_RESULT 16 /* Result while SR is updated */
+#define SLOT_FLAG 20   /* Carry out of a shift, or dst & src of XOR */
+
+enum { RAX, RCX, RDX, RBX, RSP, RBP, RSI, RDI, R8, R9, R10, R11, R12, R13, R14,
+       R15 };
+
+/* Host register of each MSP430 register, -1 for those kept in the Cpu */
+static const int8_t host_regs[16] = {-1,  -1,  -1,  -1,  RBX, R12, R13, R14,
+                                     R15, RSI, RDI, R8,  R9,  R10, R11, RDX};
+
+/* How an instruction sets C, Z, N and V from the x86 flags */
+enum { SR_ARITH, SR_LOGIC, SR_XOR, SR_SHIFT };
+
+_Static_assert(CODE_LINE_SHIFT == MEM_PAGE_SHIFT,
+               "Inline writes look up code_lines by page");
+_Static_assert(offsetof(Cpu, regs) == 0 && offsetof(Cpu, sr) == 4,
+               "Translated code addresses registers as [rbp + 2 * n]");
+
+typedef void (*jit_handler_t)(Cpu *cpu, const decoded_op_t *op);
+
+/* Out of line handlers. Cycles and register reads are charged per block */
+#define FI(OPC, S, D, BW)                                                      \
+  static void jit_formatI_##OPC##_##S##_##D##_##BW(Cpu *cpu,                   \
+                                                   const decoded_op_t *op) {   \
+    cpu->pc += 2 * op->length;                                                 \
+    exec_formatI(cpu, op, OP_##OPC, SRC_##S, DST_##D, BW_##BW);                \
+    sync_sr(cpu);                                                              \
+  }
+#define FII(OPC, S, BW)                                                        \
+  static void jit_formatII_##OPC##_##S##_##BW(Cpu *cpu,                        \
+                                              const decoded_op_t *op) {        \
+    cpu->pc += 2 * op->length;                                                 \
+    exec_formatII(cpu, op, OP_##OPC, SRC_##S, BW_##BW);                        \
+    sync_sr(cpu);                                                              \
+  }
+#define FIII(C)                                                                \
+  static void jit_formatIII_##C(Cpu *cpu, const decoded_op_t *op) {            \
+    cpu->pc += 2 * op->length;                                                 \
+    exec_formatIII(cpu, op, C);                                                \
+  }
+ALL_HANDLERS
+#undef FI
+#undef FII
+#undef FIII
+
+#define FI(OPC, S, D, BW) jit_formatI_##OPC##_##S##_##D##_##BW,
+#define FII(OPC, S, BW) jit_formatII_##OPC##_##S##_##BW,
+#define FIII(C) jit_formatIII_##C,
+static const jit_handler_t jit_handlers[] = {NULL, ALL_HANDLERS};
+#undef FI
+#undef FII
+#undef FIII
+
+_Static_assert(sizeof jit_handlers / sizeof jit_handlers[0] == HANDLER_COUNT,
+               "Handler table out of sync with handler index layout");
+
+/* Called from the stubs, with the registers written back */
+static uint16_t jit_read(Cpu *cpu, uint16_t address, int bw_flag) {
+  return mem_read(&cpu->mcu->bus, address, bw_flag);
+}
+
+static void jit_write(Cpu *cpu, uint16_t address, uint16_t value,
+                      int bw_flag) {
+  mem_write(&cpu->mcu->bus, address, value, bw_flag);
+}
+
+//##########+++ Code Emission +++##########
+
+/* A path out of the inline code: a call into a stub, after which the code
+ * either resumes or stops the block, or only the stop */
+typedef struct jit_path {
+  uint8_t *jumps[3];  /* rel32 fields of the branches to it */
+  uint8_t jump_count;
+  uint8_t stub;       /* STUB_READ ... STUB_WRITE_B, STUBS to only stop */
+  uint16_t pc;        /* PC the callbacks see */
+  uint8_t *resume;    /* Where the inline code continues */
+  uint16_t ran;       /* Instructions run when stopping, 0 to never stop */
+  uint32_t writes;    /* Register writes to count when stopping */
+} jit_path_t;
+
+typedef struct jit {
+  msp430_t *mcu;
+  uint8_t *p, *end;
+  bool full; /* Ran out of code memory */
+  jit_path_t paths[3 * MAX_BLOCK_OPS];
+  uint16_t path_count;
+
+  /* The instruction being translated */
+  uint16_t next_pc; /* Address of the instruction after it */
+  uint16_t ran;     /* Instructions run after it */
+  uint32_t writes;  /* Register writes counted after it */
+  bool pc_written;  /* It left the next PC in cpu->pc */
+} jit_t;
+
+static void emit(jit_t *j, const void *bytes, size_t len) {
+  if (j->p + len > j->end) {
+    j->full = true;
+    return;
+  }
+  memcpy(j->p, bytes, len);
+  j->p += len;
+}
+
+static void emit8(jit_t *j, uint8_t value) { emit(j, &value, 1); }
+
+static void emit16(jit_t *j, uint16_t value) { emit(j, &value, 2); }
+
+static void emit32(jit_t *j, uint32_t value) { emit(j, &value, 4); }
+
+static void emit64(jit_t *j, const void *value) {
+  uint64_t imm = (uintptr_t)value;
+  emit(j, &imm, 8);
+}
+
+/* Emit a rel32 field to be patched, return it */
+static uint8_t *emit_rel32(jit_t *j) {
+  uint8_t *field = j->p;
+  emit32(j, 0);
+  return field;
+}
+
+static void patch_rel32(uint8_t *field, const uint8_t *target) {
+  int32_t rel = (int32_t)(target - (field + 4));
+  memcpy(field, &rel, 4);
+}
+
+static void emit_call(jit_t *j, const uint8_t *target) {
+  emit8(j, 0xe8);
+  patch_rel32(emit_rel32(j), target);
+}
+
+static void emit_jmp(jit_t *j, const uint8_t *target) {
+  emit8(j, 0xe9);
+  patch_rel32(emit_rel32(j), target);
+}
+
+static int32_t cpu_offset(jit_t *j, const void *field) {
+  return (int32_t)((const uint8_t *)field - (const uint8_t *)&j->mcu->cpu);
+}
+
+static void emit_rex(jit_t *j, bool w, int reg, int rm) {
+  uint8_t rex = 0x40 | w << 3 | (reg >> 3) << 2 | rm >> 3;
+
+  if (rex != 0x40) {
+    emit8(j, rex);
+  }
+}
+
+/* ModRM and displacement of [rbp + disp] */
+static void emit_cpu_operand(jit_t *j, int reg, int32_t disp) {
+  if (disp >= -128 && disp <= 127) {
+    emit8(j, 0x45 | (reg & 7) << 3);
+    emit8(j, (uint8_t)disp);
+  } else {
+    emit8(j, 0x85 | (reg & 7) << 3);
+    emit32(j, (uint32_t)disp);
+  }
+}
+
+/* mov eax, [rbp + block_generation] */
+static void emit_load_generation(jit_t *j) {
+  emit8(j, 0x8b);
+  emit_cpu_operand(j, RAX, cpu_offset(j, &j->mcu->block_generation));
+}
+
+/* mov word [rbp + 2 * reg], imm16 */
+static void emit_set_cpu_reg(jit_t *j, uint8_t reg, uint16_t value) {
+  emit(j, "\x66\xc7", 2);
+  emit_cpu_operand(j, 0, 2 * reg);
+  emit16(j, value);
+}
+
+/* mov word [rbp + 2 * reg], host */
+static void emit_spill(jit_t *j) {
+  uint8_t reg;
+
+  for (reg = 4; reg < 16; reg++) {
+    emit8(j, 0x66);
+    emit_rex(j, false, host_regs[reg], RBP);
+    emit8(j, 0x89);
+    emit_cpu_operand(j, host_regs[reg], 2 * reg);
+  }
+}
+
+/* movzx host, word [rbp + 2 * reg] */
+static void emit_reload(jit_t *j) {
+  uint8_t reg;
+
+  for (reg = 4; reg < 16; reg++) {
+    emit_rex(j, false, host_regs[reg], RBP);
+    emit(j, "\x0f\xb7", 2);
+    emit_cpu_operand(j, host_regs[reg], 2 * reg);
+  }
+}
+
+static uint8_t *stub(const msp430_t *mcu, int kind) {
+  return mcu->jit_code + kind * STUB_SIZE;
+}
+
+static void emit_stubs(jit_t *j) {
+  uint8_t bw;
+
+  j->p = stub(j->mcu, STUB_EXIT);
+  emit_spill(j);
+  /* add rsp, FRAME_SIZE ; pop r15 ; pop r14 ; pop r13 ; pop r12 ; pop rbp ;
+   * pop rbx ; ret */
+  emit(j, "\x48\x83\xc4", 3);
+  emit8(j, FRAME_SIZE);
+  emit(j, "\x41\x5f\x41\x5e\x41\x5d\x41\x5c\x5d\x5b\xc3", 11);
+
+  /* The stubs are entered with rsp 8 off alignment */
+  for (bw = BW_W; bw <= BW_B; bw++) {
+    j->p = stub(j->mcu, STUB_READ + bw);
+    emit_spill(j);
+    /* sub rsp, 8 ; mov rdi, rbp ; mov esi, eax ; mov edx, bw */
+    emit(j, "\x48\x83\xec\x08\x48\x89\xef\x89\xc6\xba", 10);
+    emit32(j, bw);
+    /* mov rax, jit_read ; call rax ; add rsp, 8 */
+    emit(j, "\x48\xb8", 2);
+    emit64(j, jit_read);
+    emit(j, "\xff\xd0\x48\x83\xc4\x08", 6);
+    emit_reload(j);
+    emit8(j, 0xc3);
+
+    j->p = stub(j->mcu, STUB_WRITE + bw);
+    emit_spill(j);
+    /* sub rsp, 8 ; mov rdi, rbp ; mov esi, eax ; mov edx, ecx ; mov ecx, bw */
+    emit(j, "\x48\x83\xec\x08\x48\x89\xef\x89\xc6\x89\xca\xb9", 12);
+    emit32(j, bw);
+    emit(j, "\x48\xb8", 2);
+    emit64(j, jit_write);
+    emit(j, "\xff\xd0\x48\x83\xc4\x08", 6);
+    emit_reload(j);
+    emit8(j, 0xc3);
+  }
+
+  j->p = stub(j->mcu, STUB_HANDLER);
+  emit_spill(j);
+  /* sub rsp, 8 ; mov rdi, rbp ; mov rsi, rcx ; call rax ; add rsp, 8 */
+  emit(j, "\x48\x83\xec\x08\x48\x89\xef\x48\x89\xce\xff\xd0\x48\x83\xc4\x08",
+       16);
+  emit_reload(j);
+  emit8(j, 0xc3);
+}
+
+/* A path out of the inline code, ran and writes as of the current
+ * instruction */
+static jit_path_t *new_path(jit_t *j, uint8_t stub_kind, bool can_stop) {
+  jit_path_t *path = &j->paths[j->path_count++];
+
+  path->jump_count = 0;
+  path->stub = stub_kind;
+  path->pc = j->next_pc;
+  path->resume = NULL;
+  path->ran = can_stop ? j->ran : 0;
+  path->writes = j->writes;
+  return path;
+}
+
+/* Conditional jump to a path: jcc rel32 */
+static void emit_jcc_path(jit_t *j, jit_path_t *path, uint8_t condition) {
+  emit8(j, 0x0f);
+  emit8(j, condition);
+  path->jumps[path->jump_count++] = emit_rel32(j);
+}
+
+#define JCC_JZ 0x84
+#define JCC_JNZ 0x85
+
+/* Count the register writes of the block so far, see register_write_notify */
+static void emit_count_writes(jit_t *j, uint32_t writes) {
+#ifdef MSP430_REGISTER_NOTIFY
+  if (writes) { /* add qword [rbp + register_writes], writes */
+    emit(j, "\x48\x81", 2);
+    emit_cpu_operand(j, 0, cpu_offset(j, &j->mcu->register_writes));
+    emit32(j, writes);
+  }
+#endif
+}
+
+/* Count a fused pair, as run_blocks() does, when its second instruction is
+ * reached: inc qword [rbp + fusions[kind]] */
+static void emit_count_fusion(jit_t *j, fusion_t kind) {
+  emit(j, "\x48\xff", 2);
+  emit_cpu_operand(j, 0, cpu_offset(j, &j->mcu->stats.fusions[kind]));
+}
+
+/* Leave the block with ran instructions run. cpu->pc is already set */
+static void emit_exit(jit_t *j, uint16_t ran, uint32_t writes) {
+  emit_count_writes(j, writes);
+  emit8(j, 0xb8); /* mov eax, ran */
+  emit32(j, ran);
+  emit_jmp(j, stub(j->mcu, STUB_EXIT));
+}
+
+static void emit_paths(jit_t *j) {
+  uint16_t i;
+  uint8_t k;
+
+  for (i = 0; i < j->path_count; i++) {
+    jit_path_t *path = &j->paths[i];
+
+    for (k = 0; k < path->jump_count; k++) {
+      patch_rel32(path->jumps[k], j->p);
+    }
+    if (path->stub != STUBS) {
+      emit_set_cpu_reg(j, REG_PC, path->pc);
+      if (path->stub >= STUB_WRITE) { /* mov ecx, [rsp + SLOT_VALUE] */
+        emit(j, "\x8b\x4c\x24", 3);
+        emit8(j, SLOT_VALUE);
+      }
+      emit_call(j, stub(j->mcu, path->stub));
+      if (path->ran == 0) {
+        emit_jmp(j, path->resume);
+        continue;
+      }
+      emit_load_generation(j); /* cmp eax, [rsp] ; je resume */
+      emit(j, "\x3b\x04\x24\x0f\x84", 5);
+      patch_rel32(emit_rel32(j), path->resume);
+    }
+    emit_exit(j, path->ran, path->writes);
+  }
+}
+
+//##########+++ Operands +++##########
+
+/* mov dst, reg, for dst RAX or RCX. Values are zero-extended */
+static void emit_get_reg(jit_t *j, uint8_t reg, int dst) {
+  if (reg == REG_PC) { /* PC has been advanced past the instruction */
+    emit8(j, 0xb8 + dst);
+    emit32(j, j->next_pc);
+  } else if (host_regs[reg] >= 0) {
+    emit_rex(j, false, host_regs[reg], dst);
+    emit8(j, 0x89);
+    emit8(j, 0xc0 | (host_regs[reg] & 7) << 3 | dst);
+  } else {
+    emit(j, "\x0f\xb7", 2);
+    emit_cpu_operand(j, dst, 2 * reg);
+  }
+}
+
+/* mov reg, eax. eax must be zero-extended */
+static void emit_set_reg(jit_t *j, uint8_t reg) {
+  if (host_regs[reg] >= 0) {
+    emit_rex(j, false, RAX, host_regs[reg]);
+    emit8(j, 0x89);
+    emit8(j, 0xc0 | (host_regs[reg] & 7));
+  } else {
+    emit(j, "\x66\x89", 2);
+    emit_cpu_operand(j, RAX, 2 * reg);
+    j->pc_written |= reg == REG_PC;
+  }
+}
+
+/* add reg, imm as a 16-bit register */
+static void emit_add_reg(jit_t *j, uint8_t reg, int8_t imm) {
+  emit8(j, 0x66);
+  if (host_regs[reg] >= 0) {
+    emit_rex(j, false, 0, host_regs[reg]);
+    emit8(j, 0x83);
+    emit8(j, 0xc0 | (host_regs[reg] & 7));
+  } else {
+    emit8(j, 0x83);
+    emit_cpu_operand(j, 0, 2 * reg);
+  }
+  emit8(j, (uint8_t)imm);
+}
+
+/* eax = address of a memory operand */
+static void emit_address(jit_t *j, uint8_t mode, uint8_t reg, int16_t offset) {
+  switch (mode) {
+  case MODE_INDEXED:
+    emit_get_reg(j, reg, RAX);
+    emit8(j, 0x66); /* add ax, offset */
+    emit8(j, 0x05);
+    emit16(j, offset);
+    break;
+  case MODE_SYMBOLIC:
+  case MODE_ABSOLUTE:
+    emit8(j, 0xb8);
+    emit32(j, (uint16_t)offset);
+    break;
+  default: /* Indirect, autoincrement */
+    emit_get_reg(j, reg, RAX);
+    break;
+  }
+}
+
+/* eax = mem_read(eax), see mem_read() */
+static void emit_read(jit_t *j, uint8_t bw_flag) {
+  jit_path_t *path = new_path(j, STUB_READ + bw_flag, false);
+
+  /* mov ecx, eax ; shr ecx, MEM_PAGE_SHIFT ; mov rcx, [rbp + rcx * 8 +
+   * read_pages] ; test rcx, rcx ; jz path */
+  emit(j, "\x89\xc1\xc1\xe9", 4);
+  emit8(j, MEM_PAGE_SHIFT);
+  emit(j, "\x48\x8b\x8c\xcd", 4);
+  emit32(j, cpu_offset(j, j->mcu->bus.read_pages));
+  emit(j, "\x48\x85\xc9", 3);
+  emit_jcc_path(j, path, JCC_JZ);
+  if (bw_flag == BW_W) { /* not eax ; test al, 63 ; not eax ; jz path */
+    emit(j, "\xf7\xd0\xa8", 3);
+    emit8(j, MEM_PAGE_SIZE - 1);
+    emit(j, "\xf7\xd0", 2);
+    emit_jcc_path(j, path, JCC_JZ);
+  }
+  /* and eax, 63 ; movzx eax, word/byte [rcx + rax] */
+  emit(j, "\x83\xe0", 2);
+  emit8(j, MEM_PAGE_SIZE - 1);
+  emit(j, bw_flag == BW_W ? "\x0f\xb7\x04\x01" : "\x0f\xb6\x04\x01", 4);
+  path->resume = j->p;
+}
+
+/* mem_write(eax, ecx), see mem_write(). Writes to lines holding cached code
+ * go through the notification, and stop the block when they dropped code
+ * if can_stop */
+static void emit_write(jit_t *j, uint8_t bw_flag, bool can_stop) {
+  jit_path_t *path = new_path(j, STUB_WRITE + bw_flag, can_stop);
+
+  emit(j, "\x89\x4c\x24", 3); /* mov [rsp + SLOT_VALUE], ecx */
+  emit8(j, SLOT_VALUE);
+  if (bw_flag == BW_W) {
+    emit(j, "\xf7\xd0\xa8", 3);
+    emit8(j, MEM_PAGE_SIZE - 1);
+    emit(j, "\xf7\xd0", 2);
+    emit_jcc_path(j, path, JCC_JZ);
+  }
+  /* mov ecx, eax ; shr ecx, MEM_PAGE_SHIFT ; cmp byte [rbp + rcx +
+   * code_lines], 0 ; jne path */
+  emit(j, "\x89\xc1\xc1\xe9", 4);
+  emit8(j, MEM_PAGE_SHIFT);
+  emit(j, "\x80\xbc\x0d", 3);
+  emit32(j, cpu_offset(j, j->mcu->code_lines));
+  emit8(j, 0);
+  emit_jcc_path(j, path, JCC_JNZ);
+  /* mov rcx, [rbp + rcx * 8 + write_pages] ; test rcx, rcx ; jz path */
+  emit(j, "\x48\x8b\x8c\xcd", 4);
+  emit32(j, cpu_offset(j, j->mcu->bus.write_pages));
+  emit(j, "\x48\x85\xc9", 3);
+  emit_jcc_path(j, path, JCC_JZ);
+  /* and eax, 63 ; add rcx, rax ; mov eax, [rsp + SLOT_VALUE] ;
+   * mov [rcx], ax/al */
+  emit(j, "\x83\xe0", 2);
+  emit8(j, MEM_PAGE_SIZE - 1);
+  emit(j, "\x48\x01\xc1\x8b\x44\x24", 6);
+  emit8(j, SLOT_VALUE);
+  if (bw_flag == BW_W) {
+    emit(j, "\x66\x89\x01", 3);
+  } else {
+    emit(j, "\x88\x01", 2);
+  }
+  path->resume = j->p;
+}
+
+/* mov [rsp + slot], eax */
+static void emit_save(jit_t *j, uint8_t slot) {
+  emit(j, "\x89\x44\x24", 3);
+  emit8(j, slot);
+}
+
+/* mov reg, [rsp + slot], for reg RAX or RCX */
+static void emit_restore(jit_t *j, int reg, uint8_t slot) {
+  emit8(j, 0x8b);
+  emit8(j, 0x44 | reg << 3);
+  emit8(j, 0x24);
+  emit8(j, slot);
+}
+
+/* Set C, Z, N and V in SR from the x86 flags, keeping eax */
+static void emit_flags(jit_t *j, int kind, uint8_t bw_flag) {
+  emit_save(j, SLOT_RESULT);
+  /* pushfq ; pop rcx ; mov eax, ecx ; shr eax, 5 ; and eax, 6. ZF and SF
+   * are bits 6 and 7 */
+  emit(j, "\x9c\x59\x89\xc8\xc1\xe8\x05\x83\xe0\x06", 10);
+  switch (kind) {
+  case SR_ARITH: /* bt ecx, 0 ; adc eax, 0 ; and ecx, 0x800 ; shr ecx, 3 ;
+                  * or eax, ecx. OF is bit 11 */
+    emit(j, "\x0f\xba\xe1\x00\x83\xd0\x00\x81\xe1\x00\x08\x00\x00\xc1\xe9\x03"
+            "\x09\xc8",
+         18);
+    break;
+  case SR_SHIFT: /* or al, [rsp + SLOT_FLAG] */
+    emit(j, "\x0a\x44\x24", 3);
+    emit8(j, SLOT_FLAG);
+    break;
+  default: /* bt ecx, 6 ; cmc ; adc eax, 0 */
+    emit(j, "\x0f\xba\xe1\x06\xf5\x83\xd0\x00", 8);
+    if (kind == SR_XOR) { /* bt dword [rsp + SLOT_FLAG], msb ; sbb ecx, ecx ;
+                           * and ecx, 0x100 ; or eax, ecx */
+      emit(j, "\x0f\xba\x64\x24", 4);
+      emit8(j, SLOT_FLAG);
+      emit8(j, bw_flag == BW_W ? 15 : 7);
+      emit(j, "\x19\xc9\x81\xe1\x00\x01\x00\x00\x09\xc8", 10);
+    }
+    break;
+  }
+  /* and word [rbp + 4], ~(C | Z | N | V) ; or [rbp + 4], ax */
+  emit(j, "\x66\x81\x65\x04\xf8\xfe\x66\x09\x45\x04", 10);
+  emit_restore(j, RAX, SLOT_RESULT);
+}
+
+/* x86 ALU instruction on eax and ecx, given by its byte opcode */
+static void emit_alu(jit_t *j, uint8_t opcode, uint8_t bw_flag) {
+  if (bw_flag == BW_W) {
+    emit8(j, 0x66);
+    opcode++;
+  }
+  emit8(j, opcode);
+  emit8(j, 0xc8);
+}
+
+#define X86_ADD 0x00
+#define X86_OR 0x08
+#define X86_ADC 0x10
+#define X86_SBB 0x18
+#define X86_AND 0x20
+#define X86_SUB 0x28
+#define X86_CMP 0x38
+#define X86_TEST 0x84
+
+/* bt word [rbp + 4], 0: CF = C */
+static void emit_get_carry(jit_t *j) {
+  emit(j, "\x66\x0f\xba\x65\x04\x00", 6);
+}
+
+/* setc [rsp + SLOT_FLAG]: C of a shift */
+static void emit_set_carry_flag(jit_t *j) {
+  emit(j, "\x0f\x92\x44\x24", 4);
+  emit8(j, SLOT_FLAG);
+}
+
+/* ADD, ADDC, SUBC, SUB or CMP on eax and ecx, leaving the x86 flags with
+ * CF as borrow for the subtractions */
+static void emit_arith(jit_t *j, uint8_t opcode, uint8_t bw_flag) {
+  if (opcode == OP_ADDC || opcode == OP_SUBC) {
+    emit_get_carry(j);
+  }
+  if (opcode == OP_SUBC) {
+    emit8(j, 0xf5); /* cmc: borrow is !C */
+  }
+  emit_alu(j,
+           opcode == OP_ADD    ? X86_ADD
+           : opcode == OP_ADDC ? X86_ADC
+           : opcode == OP_SUBC ? X86_SBB
+           : opcode == OP_SUB  ? X86_SUB
+                               : X86_CMP,
+           bw_flag);
+}
+
+//##########+++ Instructions +++##########
+
+static bool writes_destination(uint8_t opcode) {
+  return opcode != OP_CMP && opcode != OP_BIT;
+}
+
+static bool reads_sr(const decoded_op_t *op) {
+  return (op->src_mode == MODE_REGISTER && op->source == REG_SR) ||
+         (op->format == 1 && op->dst_mode == MODE_REGISTER &&
+          op->destination == REG_SR);
+}
+
+/* Translated here rather than by calling the handler */
+static bool is_inline(const decoded_op_t *op) {
+  return op->format != 2 || op->opcode >= OP_PUSH ||
+         op->src_mode != MODE_REGISTER || op->source != REG_PC;
+}
+
+/* Register writes counted by the instruction, see register_write_notify */
+static uint32_t static_writes(const decoded_op_t *op) {
+  uint32_t writes = op->src_mode == MODE_AUTOINC;
+
+  if (!is_inline(op)) {
+    return 0; /* Counted by the handler */
+  } else if (op->format == 1) {
+    return writes +
+           (op->dst_mode == MODE_REGISTER && writes_destination(op->opcode));
+  } else if (op->format == 2) {
+    switch (op->opcode) {
+    case OP_PUSH:
+      return writes + 1;
+    case OP_CALL:
+      return writes + 2;
+    default:
+      return writes + (op->src_mode == MODE_REGISTER ||
+                       op->src_mode == MODE_CONSTANT ||
+                       op->src_mode == MODE_IMMEDIATE);
+    }
+  }
+  return 0; /* Jumps, counted when taken */
+}
+
+static bool sets_flags(const decoded_op_t *op) {
+  if (!is_inline(op)) {
+    return false;
+  } else if (op->format == 1) {
+    return op->opcode != OP_MOV && op->opcode != OP_BIC &&
+           op->opcode != OP_BIS;
+  }
+  return op->format == 2 && op->opcode != OP_SWPB && op->opcode < OP_PUSH;
+}
+
+static bool reads_flags(const decoded_op_t *op) {
+  return !is_inline(op) || op->format == 3 || reads_sr(op) ||
+         (op->format == 1 &&
+          (op->opcode == OP_ADDC || op->opcode == OP_SUBC)) ||
+         (op->format == 2 && op->opcode == OP_RRC);
+}
+
+/* Stops the block when it drops cached code. Blocks are also left after
+ * their last instruction */
+static bool may_stop(const decoded_op_t *op) {
+  if (!is_inline(op)) {
+    return true;
+  } else if (op->format == 1) {
+    return op->dst_mode != MODE_REGISTER && writes_destination(op->opcode);
+  }
+  return op->format == 2 &&
+         (op->opcode >= OP_PUSH || (op->src_mode != MODE_REGISTER &&
+                                    op->src_mode != MODE_CONSTANT &&
+                                    op->src_mode != MODE_IMMEDIATE));
+}
+
+/* Source operand of a Format I instruction. Operands in memory are read
+ * here, in order, and kept in SLOT_SOURCE */
+static void emit_source(jit_t *j, const decoded_op_t *op) {
+  switch (op->src_mode) {
+  case MODE_REGISTER:
+  case MODE_CONSTANT:
+  case MODE_IMMEDIATE:
+    break;
+  default:
+    emit_address(j, op->src_mode, op->source, op->src_word);
+    emit_read(j, op->bw_flag);
+    emit_save(j, SLOT_SOURCE);
+    if (op->src_mode == MODE_AUTOINC) {
+      emit_add_reg(j, op->source, op->bw_flag ? 1 : 2);
+    }
+    break;
+  }
+}
+
+/* ecx = source operand */
+static void emit_get_source(jit_t *j, const decoded_op_t *op) {
+  switch (op->src_mode) {
+  case MODE_REGISTER:
+    emit_get_reg(j, op->source, RCX);
+    break;
+  case MODE_CONSTANT:
+  case MODE_IMMEDIATE:
+    emit8(j, 0xb9);
+    emit32(j, (uint16_t)op->src_word);
+    break;
+  default:
+    emit_restore(j, RCX, SLOT_SOURCE);
+    break;
+  }
+}
+
+static void emit_formatI(jit_t *j, const decoded_op_t *op, bool flags,
+                         bool can_stop) {
+  uint8_t bw = op->bw_flag;
+  bool to_memory = op->dst_mode != MODE_REGISTER;
+
+  emit_source(j, op);
+  if (to_memory) {
+    emit_address(j, op->dst_mode, op->destination, op->dst_word);
+    emit_save(j, SLOT_ADDRESS);
+    if (op->opcode != OP_MOV) {
+      emit_read(j, bw);
+    }
+  } else if (op->opcode != OP_MOV) {
+    emit_get_reg(j, op->destination, RAX);
+  }
+  emit_get_source(j, op);
+
+  switch (op->opcode) {
+  case OP_MOV:
+    emit(j, bw ? "\x0f\xb6\xc1" : "\x89\xc8", bw ? 3 : 2);
+    break;
+  case OP_ADD:
+  case OP_ADDC:
+  case OP_SUBC:
+  case OP_SUB:
+  case OP_CMP:
+    if (bw && op->opcode != OP_CMP) {
+      /* Byte operands are sign-extended, see truncate_byte(), and the
+       * result keeps the bits above the byte. The flags are the byte's */
+      /* movsx eax, al ; movsx ecx, cl */
+      emit(j, "\x0f\xbe\xc0\x0f\xbe\xc9", 6);
+      if (flags) {
+        emit_save(j, SLOT_FLAG);
+      }
+      emit_arith(j, op->opcode, BW_W);
+      if (flags) {
+        emit_save(j, SLOT_VALUE);
+        emit_restore(j, RAX, SLOT_FLAG);
+        emit_arith(j, op->opcode, BW_B);
+      }
+    } else {
+      emit_arith(j, op->opcode, bw);
+    }
+    if (flags && op->opcode >= OP_SUBC) {
+      emit8(j, 0xf5); /* cmc: C is set for no borrow */
+    }
+    break;
+  case OP_BIT:
+  case OP_AND:
+    emit_alu(j, op->opcode == OP_BIT ? X86_TEST : X86_AND, bw);
+    break;
+  case OP_BIC:
+    emit(j, "\xf7\xd1\x21\xc8", 4); /* not ecx ; and eax, ecx */
+    break;
+  case OP_BIS:
+    emit(j, "\x09\xc8", 2); /* or eax, ecx */
+    break;
+  case OP_XOR:
+    if (flags) { /* V is from dst & src */
+      emit_save(j, SLOT_FLAG);
+      emit(j, "\x21\x4c\x24", 3); /* and [rsp + SLOT_FLAG], ecx */
+      emit8(j, SLOT_FLAG);
+    }
+    emit(j, "\x31\xc8", 2); /* xor eax, ecx */
+    if (flags) {
+      emit(j, bw ? "\x84\xc0" : "\x66\x85\xc0", bw ? 2 : 3); /* test */
+    }
+    break;
+  }
+
+  if (flags) {
+    emit_flags(j,
+               op->opcode == OP_XOR                         ? SR_XOR
+               : op->opcode == OP_BIT || op->opcode == OP_AND ? SR_LOGIC
+                                                              : SR_ARITH,
+               bw);
+  }
+  if (flags && bw && op->opcode >= OP_ADD && op->opcode < OP_CMP) {
+    emit_restore(j, RAX, SLOT_VALUE); /* The whole result */
+  }
+
+  if (!writes_destination(op->opcode)) {
+    return;
+  } else if (to_memory) {
+    emit(j, "\x89\xc1", 2); /* mov ecx, eax */
+    emit_restore(j, RAX, SLOT_ADDRESS);
+    emit_write(j, bw, can_stop);
+    return;
+  }
+
+  if (bw && op->opcode != OP_ADD) { /* ADD.B isn't truncated */
+    emit(j, "\x0f\xb6\xc0", 3);    /* movzx eax, al */
+  } else {
+    emit(j, "\x0f\xb7\xc0", 3); /* movzx eax, ax */
+  }
+  emit_set_reg(j, op->destination);
+}
+
+static void emit_formatII(jit_t *j, const decoded_op_t *op, bool flags,
+                          bool can_stop) {
+  uint8_t bw = op->bw_flag;
+  bool in_memory = false;
+
+  switch (op->src_mode) {
+  case MODE_REGISTER:
+    emit_get_reg(j, op->source, RAX);
+    break;
+  case MODE_CONSTANT:
+  case MODE_IMMEDIATE:
+    emit8(j, 0xb8);
+    emit32(j, (uint16_t)op->src_word);
+    break;
+  default:
+    emit_address(j, op->src_mode, op->source, op->src_word);
+    if (op->opcode == OP_CALL && (op->src_mode == MODE_SYMBOLIC ||
+                                  op->src_mode == MODE_ABSOLUTE)) {
+      break; /* CALL takes the address itself, see exec_formatII() */
+    }
+    emit_save(j, SLOT_ADDRESS);
+    emit_read(j, bw);
+    if (op->src_mode == MODE_AUTOINC) {
+      emit_add_reg(j, op->source, bw ? 1 : 2);
+    }
+    in_memory = true;
+    break;
+  }
+
+  switch (op->opcode) {
+  case OP_RRC:
+    emit_get_carry(j);
+    emit(j, bw ? "\xd0\xd8" : "\x66\xd1\xd8", bw ? 2 : 3); /* rcr */
+    if (flags) {
+      emit_set_carry_flag(j);
+    }
+    break;
+  case OP_RRA:
+    if (flags) { /* bt eax, 0 */
+      emit(j, "\x0f\xba\xe0\x00", 4);
+      emit_set_carry_flag(j);
+    }
+    if (bw) { /* mov ecx, eax ; and ecx, 0x80 ; sar ax, 1 ; or eax, ecx */
+      emit(j, "\x89\xc1\x81\xe1\x80\x00\x00\x00\x66\xd1\xf8\x09\xc8", 13);
+    } else {
+      emit(j, "\x66\xd1\xf8", 3); /* sar ax, 1 */
+    }
+    break;
+  case OP_SWPB:
+    emit(j, "\x66\xc1\xc0\x08", 4); /* rol ax, 8 */
+    break;
+  case OP_SXT:
+    emit(j, "\x0f\xbe\xc0\x0f\xb7\xc0", 6); /* movsx eax, al ; movzx eax, ax */
+    break;
+  case OP_PUSH:
+    /* mov ecx, eax ; sub word [rbp + 2], 2 ; movzx eax, word [rbp + 2] */
+    emit(j, "\x89\xc1\x66\x83\x6d\x02\x02\x0f\xb7\x45\x02", 11);
+    emit_write(j, bw, can_stop);
+    return;
+  case OP_CALL:
+    emit_save(j, SLOT_SOURCE);
+    emit(j, "\x66\x83\x6d\x02\x02\x0f\xb7\x45\x02\xb9", 10);
+    emit32(j, j->next_pc); /* mov ecx, return address */
+    emit_write(j, BW_W, false);
+    emit_restore(j, RAX, SLOT_SOURCE);
+    emit_set_reg(j, REG_PC);
+    return;
+  }
+
+  if (flags && op->opcode != OP_SWPB) {
+    emit(j, bw ? "\x84\xc0" : "\x66\x85\xc0", bw ? 2 : 3); /* test */
+    emit_flags(j, op->opcode == OP_SXT ? SR_LOGIC : SR_SHIFT, bw);
+  }
+
+  if (in_memory) {
+    emit(j, "\x89\xc1", 2); /* mov ecx, eax */
+    emit_restore(j, RAX, SLOT_ADDRESS);
+    emit_write(j,
+               op->opcode == OP_SWPB || op->opcode == OP_SXT ? BW_W : bw,
+               can_stop);
+  } else if (op->src_mode == MODE_REGISTER) {
+    if (bw && (op->opcode == OP_RRC || op->opcode == OP_RRA)) {
+      emit(j, "\x0f\xb6\xc0", 3); /* movzx eax, al */
+    } else {
+      emit(j, "\x0f\xb7\xc0", 3); /* movzx eax, ax */
+    }
+    emit_set_reg(j, op->source);
+  }
+}
+
+/* Leave the block at a jump, taken or not */
+static void emit_jump(jit_t *j, const decoded_op_t *op) {
+  static const uint8_t tests[] = {2, 2, 1, 1, 4};
+  uint8_t *taken = NULL;
+
+  if (op->opcode < 5) { /* test byte [rbp + 4], Z/C/N */
+    emit(j, "\xf6\x45\x04", 3);
+    emit8(j, tests[op->opcode]);
+  } else if (op->opcode < 7) {
+    /* movzx eax, word [rbp + 4] ; mov ecx, eax ; shr ecx, 6 ;
+     * xor eax, ecx ; test al, 4: N ^ V */
+    emit(j, "\x0f\xb7\x45\x04\x89\xc1\xc1\xe9\x06\x31\xc8\xa8\x04", 13);
+  }
+  if (op->opcode < 7) {
+    /* JNE, JNC and JGE jump on a clear bit */
+    emit8(j, 0x0f);
+    emit8(j, (op->opcode == 0 || op->opcode == 2 || op->opcode == 5)
+                 ? JCC_JZ
+                 : JCC_JNZ);
+    taken = emit_rel32(j);
+    emit_set_cpu_reg(j, REG_PC, j->next_pc);
+    emit_exit(j, j->ran, j->writes);
+    patch_rel32(taken, j->p);
+  }
+  emit_set_cpu_reg(j, REG_PC, j->next_pc + op->src_word);
+  emit_exit(j, j->ran, j->writes + 1);
+}
+
+/* Run an instruction through its handler */
+static void emit_handler(jit_t *j, const decoded_op_t *op, uint16_t pc,
+                         bool last) {
+  emit_set_cpu_reg(j, REG_PC, pc);
+  emit(j, "\x48\xb8", 2); /* mov rax, handler ; mov rcx, op */
+  emit64(j, jit_handlers[unfused_handler(op)]);
+  emit(j, "\x48\xb9", 2);
+  emit64(j, op);
+  emit_call(j, stub(j->mcu, STUB_HANDLER));
+  if (last) {
+    j->pc_written = true; /* The handler advanced it */
+  } else { /* cmp eax, [rsp] ; jne path */
+    jit_path_t *path = new_path(j, STUBS, true);
+
+    emit_load_generation(j);
+    emit(j, "\x3b\x04\x24", 3);
+    emit_jcc_path(j, path, JCC_JNZ);
+  }
+}
+
+static void emit_block(jit_t *j, const basic_block_t *block) {
+  bool flags_live[MAX_BLOCK_OPS];
+  bool live = true; /* The exit sees the flags */
+  uint16_t pc = block->address;
+  int i;
+
+  /* Flags are only computed for instructions whose flags are read, or seen
+   * by an exit, before they are replaced */
+  for (i = block->count - 1; i >= 0; i--) {
+    const decoded_op_t *op = &block->ops[i];
+
+    flags_live[i] = live || may_stop(op);
+    live = reads_flags(op) || (flags_live[i] && !sets_flags(op));
+  }
+
+  /* push rbx ; push rbp ; push r12 ; push r13 ; push r14 ; push r15 ;
+   * sub rsp, FRAME_SIZE ; mov rbp, rdi */
+  emit(j, "\x53\x55\x41\x54\x41\x55\x41\x56\x41\x57\x48\x83\xec", 13);
+  emit8(j, FRAME_SIZE);
+  emit(j, "\x48\x89\xfd", 3);
+  emit_load_generation(j);
+  emit(j, "\x89\x04\x24", 3); /* mov [rsp + SLOT_GENERATION], eax */
+  emit_reload(j);
+
+  j->writes = 0;
+  j->pc_written = false;
+  for (i = 0; i < block->count; i++) {
+    const decoded_op_t *op = &block->ops[i];
+    bool last = i == block->count - 1;
+
+    j->next_pc = pc + 2 * op->length;
+    j->ran = i + 1;
+    j->writes += static_writes(op);
+    if (i > 0 && block->ops[i - 1].handler >= HANDLER_COUNT) {
+      emit_count_fusion(j, fusion_kind(&block->ops[i - 1]));
+    }
+    if (!is_inline(op)) {
+      emit_handler(j, op, pc, last);
+    } else if (op->format == 1) {
+      emit_formatI(j, op, flags_live[i] && sets_flags(op), !last);
+    } else if (op->format == 2) {
+      emit_formatII(j, op, flags_live[i] && sets_flags(op), !last);
+    } else {
+      emit_jump(j, op);
+      break;
+    }
+    pc = j->next_pc;
+
+    if (last) {
+      if (!j->pc_written) {
+        emit_set_cpu_reg(j, REG_PC, pc);
+      }
+      emit_exit(j, j->ran, j->writes);
+    }
+  }
+
+  emit_paths(j);
+}
+
+/* Make code memory from offset on writable, or executable */
+static bool protect_code(msp430_t *mcu, size_t offset, bool writable) {
+  size_t page = (size_t)sysconf(_SC_PAGESIZE);
+
+  offset &= ~(page - 1);
+  return mprotect(mcu->jit_code + offset, JIT_CODE_SIZE - offset,
+                  writable ? PROT_READ | PROT_WRITE
+                           : PROT_READ | PROT_EXEC) == 0;
+}
+
+/* Give up on translation, for example when the host refuses to make code
+ * memory executable */
+static void disable_jit(msp430_t *mcu) {
+  uint16_t i;
+
+  for (i = 0; i < mcu->blocks_used; i++) {
+    mcu->blocks[i].native = NULL;
+  }
+  mcu->jit_unavailable = true;
+}
+
+static bool create_code(msp430_t *mcu) {
+  jit_t j = {.mcu = mcu};
+
+  mcu->jit_code = mmap(NULL, JIT_CODE_SIZE, PROT_READ | PROT_WRITE,
+                       MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (mcu->jit_code == MAP_FAILED) { /* Stay with the interpreter */
+    mcu->jit_code = NULL;
+    return false;
+  }
+
+  j.end = mcu->jit_code + STUBS * STUB_SIZE;
+  emit_stubs(&j);
+  mcu->jit_used = STUBS * STUB_SIZE;
+  if (j.full || !protect_code(mcu, 0, false)) {
+    jit_release(mcu);
+    return false;
+  }
+  return true;
+}
+
+bool jit_compile(msp430_t *mcu, basic_block_t *block) {
+  jit_t j = {.mcu = mcu};
+  uint16_t i;
+
+  for (i = 0; i < block->count; i++) {
+    if (block->ops[i].handler == 0) { /* Left to the reference decoder */
+      return false;
+    }
+  }
+
+  if (mcu->jit_unavailable ||
+      (mcu->jit_code == NULL && !create_code(mcu))) {
+    mcu->jit_unavailable = true;
+    return false;
+  }
+
+  if (!protect_code(mcu, mcu->jit_used, true)) {
+    disable_jit(mcu);
+    return false;
+  }
+  j.p = mcu->jit_code + mcu->jit_used;
+  j.end = mcu->jit_code + JIT_CODE_SIZE;
+  emit_block(&j, block);
+  if (!protect_code(mcu, mcu->jit_used, false)) {
+    disable_jit(mcu);
+    return false;
+  } else if (j.full) { /* Start over, as when the block pool is exhausted */
+    flush_blocks(mcu);
+    return false;
+  }
+
+  block->native = (uint16_t(*)(Cpu *))(mcu->jit_code + mcu->jit_used);
+  mcu->jit_used = j.p - mcu->jit_code;
+  return true;
+}
+
+void jit_flush(msp430_t *mcu) {
+  if (mcu->jit_code != NULL) { /* Keep the stubs */
+    mcu->jit_used = STUBS * STUB_SIZE;
+  }
+}
+
+void jit_release(msp430_t *mcu) {
+  if (mcu->jit_code != NULL) {
+    munmap(mcu->jit_code, JIT_CODE_SIZE);
+    mcu->jit_code = NULL;
+    mcu->jit_used = 0;
+  }
+}
+
+#else
+
+bool jit_compile(msp430_t *mcu, basic_block_t *block) { return false; }
+
+void jit_flush(msp430_t *mcu) {}
+
+void jit_release(msp430_t *mcu) {}
+
+#endif
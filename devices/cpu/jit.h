@@ -0,0 +1,64 @@
+/*
+  This file is part of MSP430 Emulator
+
+  MSP430 Emulator is free software: you can redistribute it and/or
+  modify it under the terms of the GNU General Public License as
+  published by the Free Software Foundation, either version 3 of the
+  License, or (at your option) any later version.
+
+  MSP430 Emulator is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with MSP430 Emulator.
+  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef _JIT_H_
+#define _JIT_H_
+
+#include "block.h"
+#include "msp430.h"
+#include "registers.h"
+
+/* Times a block runs in the interpreter before it is translated */
+#define JIT_THRESHOLD 16
+
+/**
+ * @brief Translate a basic block to native code and set block->native. The
+ * translated code keeps R4-R15 in host registers and accesses host memory
+ * pages directly. It returns the number of instructions it ran, which is
+ * less than block->count when the block was invalidated by one of its own
+ * writes. SR must be up to date when it is called, see sync_sr()
+ * @param mcu The MCU the block belongs to
+ * @param block The block to translate
+ * @return false if the block holds instructions left to the reference
+ * decoder, if code memory is exhausted, which drops all blocks and their
+ * code with flush_blocks(), or if the JIT is not available on this host
+ */
+bool jit_compile(msp430_t *mcu, basic_block_t *block);
+
+/**
+ * @brief Drop all translated code. Called from flush_blocks()
+ * @param mcu The MCU
+ */
+void jit_flush(msp430_t *mcu);
+
+/**
+ * @brief Release the code memory of an MCU. Called from msp430_destroy()
+ * @param mcu The MCU
+ */
+void jit_release(msp430_t *mcu);
+
+/**
+ * @brief Execute instructions, translating hot basic blocks to native code
+ * and running cold or unsupported code with run_blocks()
+ * @param cpu A pointer to the CPU structure
+ * @param count Number of instructions to execute
+ * @return Number of instructions executed
+ */
+uint32_t run_jit(Cpu *cpu, uint32_t count);
+
+#endif
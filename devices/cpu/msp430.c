@@ -0,0 +1,104 @@
+/*
+  This file is part of MSP430 Emulator
+
+  MSP430 Emulator is free software: you can redistribute it and/or
+  modify it under the terms of the GNU General Public License as
+  published by the Free Software Foundation, either version 3 of the
+  License, or (at your option) any later version.
+
+  MSP430 Emulator is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with MSP430 Emulator.
+  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+//##########+++ MCU Instances +++##########
+//# All state of an emulated MCU is in one msp430_t, so
+//# that a process can run many of them side by side.
+//#########################################
+
+#include "msp430.h"
+#include "interrupt.h"
+#include "jit.h"
+#include "profiler.h"
+
+#ifndef MSP430_DEFAULT_ENGINE
+#define MSP430_DEFAULT_ENGINE ENGINE_PREDECODE
+#endif
+
+static void ignore_count(void *user, uint16_t count) {}
+
+msp430_t *msp430_create(void *user) {
+  size_t size = (sizeof(msp430_t) + 63) & ~(size_t)63;
+  msp430_t *mcu = aligned_alloc(_Alignof(msp430_t), size);
+
+  if (mcu == NULL) {
+    return NULL;
+  }
+  memset(mcu, 0, sizeof *mcu);
+
+  mcu->cpu.mcu = mcu;
+  initialize_msp_registers(&mcu->cpu);
+
+  mcu->user = mcu->bus.user = user;
+  mcu->consume_cycles_cb = ignore_count;
+  mcu->register_read_notify_cb = ignore_count;
+  mcu->register_write_notify_cb = ignore_count;
+  mcu->bus.write_notify_cb = code_write_notify;
+  mcu->bus.notify_context = mcu;
+  mcu->engine = MSP430_DEFAULT_ENGINE;
+  mcu->nonmaskable_interrupts = 1u << INTERRUPT_NMI;
+  return mcu;
+}
+
+void msp430_destroy(msp430_t *mcu) {
+  if (mcu != NULL) {
+    jit_release(mcu);
+    free(mcu->profile_table);
+    free(mcu);
+  }
+}
+
+void set_consume_cycles_cb(msp430_t *mcu,
+                           void (*fptr)(void *user, uint16_t cycles)) {
+  mcu->consume_cycles_cb = fptr ? fptr : ignore_count;
+}
+
+/* Hooks take 16-bit counts, which only skipped loops exceed */
+static void report_count(msp430_t *mcu, void (*hook)(void *, uint16_t),
+                         uint64_t count) {
+  while (count) {
+    uint16_t part = count > 0xFFFF ? 0xFFFF : count;
+    hook(mcu->user, part);
+    count -= part;
+  }
+}
+
+void report_register_accesses(msp430_t *mcu) {
+  uint64_t reads = mcu->register_reads, writes = mcu->register_writes;
+
+  mcu->register_reads = mcu->register_writes = 0;
+  report_count(mcu, mcu->register_read_notify_cb, reads);
+  report_count(mcu, mcu->register_write_notify_cb, writes);
+}
+
+void set_register_read_notify_cb(msp430_t *mcu,
+                                 void (*fptr)(void *user, uint16_t count)) {
+  mcu->register_read_notify_cb = fptr ? fptr : ignore_count;
+}
+
+void set_register_write_notify_cb(msp430_t *mcu,
+                                  void (*fptr)(void *user, uint16_t count)) {
+  mcu->register_write_notify_cb = fptr ? fptr : ignore_count;
+}
+
+void set_write_notify_cb(msp430_t *mcu,
+                         void (*fptr)(void *user, uint16_t address,
+                                      size_t len)) {
+  mcu->write_notify_cb = fptr;
+}
@@ -0,0 +1,222 @@
+/*
+  This file is part of MSP430 Emulator
+
+  MSP430 Emulator is free software: you can redistribute it and/or
+  modify it under the terms of the GNU General Public License as
+  published by the Free Software Foundation, either version 3 of the
+  License, or (at your option) any later version.
+
+  MSP430 Emulator is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with MSP430 Emulator.
+  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#ifndef _MSP430_H_
+#define _MSP430_H_
+
+#include "../utilities.h"
+#include "block.h"
+#include "fusion.h"
+#include "predecode.h"
+#include "registers.h"
+#include "snapshot.h"
+
+/* Execution engines, selectable at run time with set_engine(). The default
+ * can be chosen at build time through MSP430_DEFAULT_ENGINE */
+typedef enum {
+  ENGINE_REFERENCE, /* fetch() and decode() */
+  ENGINE_PREDECODE, /* Predecoded instruction cache, see predecode.h */
+  ENGINE_THREADED,  /* Threaded-code interpreter, see threaded.h */
+  ENGINE_BLOCK,     /* Threaded-code interpreter over basic blocks */
+  ENGINE_JIT,       /* Hot basic blocks translated to native code, see jit.h */
+} engine_t;
+
+/* Counters kept by the core for an MCU, from msp430_create() on. The
+ * embedder may read and reset them between calls into the core */
+typedef struct msp430_stats {
+  uint64_t instructions; /* Executed by run_instructions() and run() */
+  uint64_t cycles;       /* Charged through consume_cycles_cb */
+  uint64_t interrupts;   /* Accepted, see interrupt.h */
+  uint64_t fusions[FUSION_KINDS]; /* Times each superinstruction ran */
+} msp430_stats_t;
+
+/* An emulated MCU: its CPU, address space, callbacks, caches and
+ * statistics. MCUs share no state, so any number of them can run
+ * concurrently, each on one thread at a time. The core reaches all of it
+ * from the Cpu through cpu->mcu */
+struct msp430 {
+  Cpu cpu; /* cpu.mcu points back here */
+
+  /* Hooks the core calls as it executes, with user as first argument.
+   * msp430_create() installs ones that do nothing */
+  void *user;
+  void (*consume_cycles_cb)(void *user, uint16_t cycles);
+  void (*register_read_notify_cb)(void *user, uint16_t count);
+  void (*register_write_notify_cb)(void *user, uint16_t count);
+  void (*write_notify_cb)(void *user, uint16_t address, size_t len);
+
+  /* Register accesses of the current instruction, see
+   * flush_register_notify() */
+  uint64_t register_reads;
+  uint64_t register_writes;
+
+  msp430_stats_t stats;
+  engine_t engine;
+  cpu_model_t cpu_model; /* Whose cycle counts are charged */
+
+  /* Interrupt controller, see interrupt.h. Asserted lines, one bit per
+   * line, are only ever tested as a whole, so that checking for a pending
+   * interrupt is a single load-and-test */
+  uint16_t interrupt_requests;
+  uint16_t nonmaskable_interrupts;
+  void (*interrupt_accept_cb)(void *user, uint8_t line);
+
+  /* Batch execution, see run.h */
+  uint64_t (*wakeup_cb)(void *user, power_mode_t mode);
+  uint32_t breakpoint_count;
+
+  /* Incremented whenever a cached block is dropped. Engines compare it
+   * against a snapshot to notice that the running block was modified */
+  uint32_t block_generation;
+
+  /* Counts per instruction address, see profiler.h. profile is the table
+   * while the profiler runs, and NULL otherwise */
+  struct profile_entry *profile;
+  struct profile_entry *profile_table;
+
+  /* Translated code, see jit.h */
+  uint8_t *jit_code;
+  size_t jit_used;
+  bool jit_unavailable;
+
+  /* Snapshots, see snapshot.h */
+  state_block_t snapshot_states[SNAPSHOT_STATES];
+  uint32_t snapshot_state_count;
+  snapshot_t *snapshots; /* Live snapshots, newest first */
+
+  /* Predecoded instructions, one record per word address. code_lines marks
+   * lines of memory that hold cached instructions, so that writes to plain
+   * data only cost a single load */
+  decoded_op_t decoded_ops[0x10000 >> 1];
+  uint8_t code_lines[0x10000 >> CODE_LINE_SHIFT];
+
+  /* Basic blocks, copied into a pool. When the pool is exhausted all
+   * blocks are dropped and rebuilt on demand */
+  basic_block_t *block_map[0x10000 >> 1];
+  basic_block_t blocks[MAX_BLOCKS];
+  decoded_op_t block_pool[BLOCK_POOL_OPS];
+  uint16_t blocks_used;
+  uint32_t pool_used;
+
+  uint8_t breakpoints[0x10000 >> 3];
+
+  bus_t bus; /* The address space */
+};
+
+/**
+ * @brief Create an MCU, with its registers initialized, nothing mapped,
+ * CPU_MSP430 timing and the engine chosen at build time
+ * @param user Passed to the callbacks of the MCU and its bus
+ * @return The MCU, or NULL if memory could not be allocated
+ */
+msp430_t *msp430_create(void *user);
+
+/**
+ * @brief Release an MCU. Memory mapped into its bus is the embedder's
+ * @param mcu The MCU
+ */
+void msp430_destroy(msp430_t *mcu);
+
+/* The hooks, NULL for none. Register accesses are only reported when the
+ * core is built with MSP430_REGISTER_NOTIFY, as one call to each hook per
+ * instruction with the accesses it made */
+void set_consume_cycles_cb(msp430_t *mcu,
+                           void (*fptr)(void *user, uint16_t cycles));
+void set_register_read_notify_cb(msp430_t *mcu,
+                                 void (*fptr)(void *user, uint16_t count));
+void set_register_write_notify_cb(msp430_t *mcu,
+                                  void (*fptr)(void *user, uint16_t count));
+
+/**
+ * @brief Observe every write that changes memory, through mem_write(),
+ * bursts or the mapping functions of utilities.h, after cached code under
+ * it has been dropped. NULL, the default, for none
+ * @param mcu The MCU
+ * @param fptr The callback, gets the user pointer of the MCU, the first
+ * address and the length
+ */
+void set_write_notify_cb(msp430_t *mcu,
+                         void (*fptr)(void *user, uint16_t address,
+                                      size_t len));
+
+static inline void consume_cycles(Cpu *cpu, uint16_t cycles) {
+  msp430_t *mcu = cpu->mcu;
+
+  mcu->stats.cycles += cycles;
+  mcu->consume_cycles_cb(mcu->user, cycles);
+}
+
+/* Count register accesses, reported by flush_register_notify(). Without
+ * MSP430_REGISTER_NOTIFY these compile to nothing */
+static inline void register_read_notify(Cpu *cpu, uint16_t count) {
+#ifdef MSP430_REGISTER_NOTIFY
+  cpu->mcu->register_reads += count;
+#endif
+}
+
+static inline void register_write_notify(Cpu *cpu, uint16_t count) {
+#ifdef MSP430_REGISTER_NOTIFY
+  cpu->mcu->register_writes += count;
+#endif
+}
+
+/* Report counts that do not fit the 16-bit argument of the hooks */
+void report_register_accesses(msp430_t *mcu);
+
+/**
+ * @brief Report the register accesses counted since the last call to the
+ * notify hooks. The engines call this after every instruction, or every
+ * block with ENGINE_BLOCK and ENGINE_JIT, and before they return. An
+ * embedder that runs decode() itself calls it after each instruction
+ * @param cpu A pointer to the CPU structure
+ */
+static inline void flush_register_notify(Cpu *cpu) {
+#ifdef MSP430_REGISTER_NOTIFY
+  msp430_t *mcu = cpu->mcu;
+  uint64_t reads = mcu->register_reads, writes = mcu->register_writes;
+
+  if ((reads | writes) > 0xFFFF) { /* Only after skipped loops */
+    report_register_accesses(mcu);
+    return;
+  }
+  if (reads) {
+    mcu->register_reads = 0;
+    mcu->register_read_notify_cb(mcu->user, reads);
+  }
+  if (writes) {
+    mcu->register_writes = 0;
+    mcu->register_write_notify_cb(mcu->user, writes);
+  }
+#endif
+}
+
+/**
+ * @brief Look up the predecoded instruction at an (even) address, filling
+ * the cache on a miss
+ * @param mcu The MCU
+ * @param address Address of the instruction word
+ * @return Pointer to the cached record
+ */
+static inline const decoded_op_t *get_decoded_op(msp430_t *mcu,
+                                                 uint16_t address) {
+  const decoded_op_t *op = &mcu->decoded_ops[address >> 1];
+  return op->length ? op : fill_decoded_op(mcu, address);
+}
+
+#endif
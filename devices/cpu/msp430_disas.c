@@ -0,0 +1,115 @@
+/*
+  This file is part of MSP430 Emulator
+
+  MSP430 Emulator is free software: you can redistribute it and/or
+  modify it under the terms of the GNU General Public License as
+  published by the Free Software Foundation, either version 3 of the
+  License, or (at your option) any later version.
+
+  MSP430 Emulator is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with MSP430 Emulator.
+  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+//##########+++ Image Disassembler +++##########
+//# Command-line front end to disassemble_image().
+//#
+//# usage: msp430-disas [-f text|json] [-j threads]
+//#                     [-b base] [-o output] <image.bin>
+//##############################################
+
+#include "disas_image.h"
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+static void usage(const char *name) {
+  fprintf(stderr,
+          "usage: %s [-f text|json] [-j threads] [-b base] [-o output] "
+          "<image.bin>\n",
+          name);
+  exit(1);
+}
+
+int main(int argc, char **argv) {
+  disas_format_t format = DISAS_TEXT;
+  unsigned threads = 0;
+  unsigned long base = 0;
+  const char *output = NULL;
+  uint8_t *image;
+  size_t len;
+  FILE *in, *out = stdout;
+  int opt;
+
+  while ((opt = getopt(argc, argv, "f:j:b:o:")) != -1) {
+    switch (opt) {
+    case 'f':
+      if (strcmp(optarg, "text") == 0) {
+        format = DISAS_TEXT;
+      } else if (strcmp(optarg, "json") == 0) {
+        format = DISAS_JSON;
+      } else {
+        usage(argv[0]);
+      }
+      break;
+    case 'j':
+      threads = strtoul(optarg, NULL, 0);
+      break;
+    case 'b':
+      base = strtoul(optarg, NULL, 0);
+      break;
+    case 'o':
+      output = optarg;
+      break;
+    default:
+      usage(argv[0]);
+    }
+  }
+
+  if (optind != argc - 1 || base > 0xFFFF) {
+    usage(argv[0]);
+  }
+
+  in = fopen(argv[optind], "rb");
+  if (in == NULL) {
+    fprintf(stderr, "ERROR: Can't open %s\n", argv[optind]);
+    exit(1);
+  }
+
+  /* An image never exceeds the 64K address space */
+  image = malloc(0x10000 + 1);
+  if (image == NULL) {
+    fprintf(stderr, "ERROR: Out of memory\n");
+    exit(1);
+  }
+  len = fread(image, 1, 0x10000 + 1, in);
+  fclose(in);
+
+  if (len > 0x10000 - base) {
+    fprintf(stderr, "ERROR: %s does not fit in memory at 0x%04lX\n",
+            argv[optind], base);
+    exit(1);
+  }
+
+  if (output != NULL) {
+    out = fopen(output, "w");
+    if (out == NULL) {
+      fprintf(stderr, "ERROR: Can't open %s\n", output);
+      exit(1);
+    }
+  }
+
+  if (disassemble_image(image, len, base, format, threads, out) < 0 ||
+      fclose(out) != 0) {
+    fprintf(stderr, "ERROR: Can't disassemble %s\n", argv[optind]);
+    exit(1);
+  }
+
+  free(image);
+  return 0;
+}
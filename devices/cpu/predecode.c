@@ -0,0 +1,150 @@
+/*
+  This file is part of MSP430 Emulator
+
+  MSP430 Emulator is free software: you can redistribute it and/or
+  modify it under the terms of the GNU General Public License as
+  published by the Free Software Foundation, either version 3 of the
+  License, or (at your option) any later version.
+
+  MSP430 Emulator is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with MSP430 Emulator.
+  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+//##########+++ Instruction Predecoder +++##########
+//# Turns an instruction and its extension words into a
+//# decoded_op_t once, and caches it by address so the
+//# execute stage never has to parse instruction words.
+//# Everything that follows from the instruction word comes
+//# from decode_table, generated at build time.
+//##################################################
+
+#include "predecode.h"
+#include "block.h"
+#include "decode_table.h"
+#include "decoder.h"
+
+uint8_t instruction_length(uint16_t instruction) {
+  return decode_table[instruction].length;
+}
+
+void predecode_words(uint16_t address, const uint16_t *words,
+                     cpu_model_t model, decoded_op_t *op) {
+  const decode_entry_t *entry = &decode_table[words[0]];
+  uint8_t next = 1; /* Index of the next extension word */
+
+  op->instruction = words[0];
+  op->format = entry->format;
+  op->opcode = entry->opcode;
+  op->bw_flag = entry->bw_flag;
+  op->src_mode = entry->src_mode;
+  op->dst_mode = entry->dst_mode;
+  op->source = entry->source;
+  op->destination = entry->destination;
+  op->length = entry->length;
+  op->reg_reads = entry->reg_reads;
+  op->cycles = entry->cycles[model];
+  op->handler = entry->handler;
+  op->src_word = entry->constant;
+  op->dst_word = 0;
+
+  /* Source operand, shared by Format I and II */
+  if (has_extension_word(op->src_mode)) {
+    op->src_word = words[next];
+    if (op->src_mode == MODE_SYMBOLIC) {
+      op->src_word += address + 2 * next;
+    }
+    next++;
+  }
+
+  /* Format I destination operand */
+  if (op->format == 1 && op->dst_mode != MODE_REGISTER) {
+    op->dst_word = words[next];
+    if (op->dst_mode == MODE_SYMBOLIC) {
+      op->dst_word += address + 2 * next;
+    }
+  }
+}
+
+static void mark_code_lines(msp430_t *mcu, uint16_t address, uint8_t length) {
+  uint16_t last = address + 2 * length - 1;
+
+  mcu->code_lines[address >> CODE_LINE_SHIFT] = 1;
+  mcu->code_lines[last >> CODE_LINE_SHIFT] = 1;
+}
+
+/* Drop cached instructions under a write */
+static void drop_written_code(msp430_t *mcu, uint16_t address, size_t len) {
+  uint32_t line = address >> CODE_LINE_SHIFT;
+  uint32_t last = ((uint32_t)address + len - 1) >> CODE_LINE_SHIFT;
+
+  /* Writes through mem_write() cover one or two lines, bursts and mapping
+   * changes many */
+  if (len >= 0x10000) {
+    flush_decoded_ops(mcu);
+    return;
+  }
+  for (; line <= last; line++) {
+    if (mcu->code_lines[line & ((0x10000 >> CODE_LINE_SHIFT) - 1)]) {
+      invalidate_decoded_ops(mcu, address, len);
+      return;
+    }
+  }
+}
+
+void code_write_notify(void *context, uint16_t address, size_t len) {
+  msp430_t *mcu = context;
+
+  if (len == 0) {
+    return;
+  }
+  drop_written_code(mcu, address, len);
+  if (mcu->write_notify_cb != NULL) {
+    mcu->write_notify_cb(mcu->user, address, len);
+  }
+}
+
+const decoded_op_t *fill_decoded_op(msp430_t *mcu, uint16_t address) {
+  decoded_op_t *op = &mcu->decoded_ops[address >> 1];
+  uint16_t words[3];
+
+  // The extension words in one burst
+  words[0] = mem_read(&mcu->bus, address, WORD);
+  mem_read_words(&mcu->bus, address + 2, &words[1],
+                 instruction_length(words[0]) - 1);
+
+  predecode_words(address, words, mcu->cpu_model, op);
+  mark_code_lines(mcu, address, op->length);
+
+  return op;
+}
+
+void invalidate_decoded_ops(msp430_t *mcu, uint16_t address, size_t len) {
+  /* An instruction is at most 3 words long, so it can start up to 4 bytes
+   * before the first byte written */
+  uint32_t first = (address & ~1u) + 0x10000 - 4;
+  uint32_t last = (uint32_t)address + 0x10000 + len - 1;
+  uint32_t a;
+
+  if (len >= 0x10000) {
+    flush_decoded_ops(mcu);
+    return;
+  }
+
+  for (a = first; a <= last; a += 2) {
+    mcu->decoded_ops[(a & 0xFFFF) >> 1].length = 0;
+  }
+
+  invalidate_blocks(mcu, address, len);
+}
+
+void flush_decoded_ops(msp430_t *mcu) {
+  memset(mcu->decoded_ops, 0, sizeof mcu->decoded_ops);
+  memset(mcu->code_lines, 0, sizeof mcu->code_lines);
+  flush_blocks(mcu);
+}
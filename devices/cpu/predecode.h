@@ -0,0 +1,123 @@
+/*
+  This file is part of MSP430 Emulator
+
+  MSP430 Emulator is free software: you can redistribute it and/or
+  modify it under the terms of the GNU General Public License as
+  published by the Free Software Foundation, either version 3 of the
+  License, or (at your option) any later version.
+
+  MSP430 Emulator is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with MSP430 Emulator.
+  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef _PREDECODE_H_
+#define _PREDECODE_H_
+
+#include "registers.h"
+#include <stddef.h>
+#include <stdint.h>
+
+/* Lines of memory tracked for holding cached instructions */
+#define CODE_LINE_SHIFT 6
+
+/* Operand addressing modes, after constant generator resolution */
+typedef enum {
+  MODE_REGISTER,  /* Rn     */
+  MODE_CONSTANT,  /* #C     (CG1/CG2) */
+  MODE_INDEXED,   /* X(Rn)  */
+  MODE_SYMBOLIC,  /* ADDR   (PC relative, resolved at predecode) */
+  MODE_ABSOLUTE,  /* &ADDR  */
+  MODE_INDIRECT,  /* @Rn    */
+  MODE_AUTOINC,   /* @Rn+   */
+  MODE_IMMEDIATE, /* #N     */
+} operand_mode_t;
+
+/* CPU generations, which take different numbers of cycles for the same
+ * instruction. CPU_MSP430X is the CPUX of the 5xx and 6xx families, running
+ * MSP430 instructions */
+typedef enum {
+  CPU_MSP430,  /* 1xx, 2xx and 4xx families */
+  CPU_MSP430X, /* 5xx and 6xx families */
+} cpu_model_t;
+
+#define CPU_MODELS 2
+
+/* A predecoded instruction, including its extension words */
+typedef struct decoded_op {
+  uint16_t instruction; /* Raw instruction word */
+  uint8_t format;       /* Format I, II or III, 0 if invalid */
+  uint8_t opcode;       /* Opcode, or condition for Format III */
+  uint8_t bw_flag;      /* Byte or Word */
+  uint8_t src_mode;     /* operand_mode_t of the (only) source operand */
+  uint8_t dst_mode;     /* operand_mode_t of the Format I destination */
+  uint8_t source;       /* Source register number */
+  uint8_t destination;  /* Destination register number */
+  uint8_t length;       /* Length in words, 0 marks an empty cache slot */
+  uint8_t reg_reads;    /* Static register read notifications */
+  uint8_t cycles;       /* Cycles it takes, on the CPU model it was
+                           predecoded for */
+  uint16_t handler;     /* Handler index for the threaded interpreter */
+  int16_t src_word;     /* Constant, immediate, offset or jump offset */
+  int16_t dst_word;     /* Destination offset or address */
+} decoded_op_t;
+
+/**
+ * @brief Get the length of an instruction in words from its first word
+ * @param instruction The instruction word
+ * @return 1, 2 or 3
+ */
+uint8_t instruction_length(uint16_t instruction);
+
+/**
+ * @brief Predecode an instruction without touching CPU state or memory
+ * @param address Address of the instruction word
+ * @param words The instruction word followed by its extension words
+ * @param model CPU model whose cycle counts to record
+ * @param op Record to fill in
+ */
+void predecode_words(uint16_t address, const uint16_t *words,
+                     cpu_model_t model, decoded_op_t *op);
+
+/**
+ * @brief Read and predecode the instruction at an (even) address through
+ * mem_read and mem_read_words, and store it in the cache of the MCU. See
+ * get_decoded_op() in msp430.h for the lookup
+ * @param mcu The MCU
+ * @param address Address of the instruction word
+ * @return Pointer to the cached record
+ */
+const decoded_op_t *fill_decoded_op(msp430_t *mcu, uint16_t address);
+
+/**
+ * @brief Observe writes to memory on the bus of an MCU, installed by
+ * msp430_create(): drops cached instructions the write overlaps, then passes
+ * it on to the hook set with set_write_notify_cb()
+ * @param context The MCU
+ * @param address First byte written
+ * @param len Number of bytes written
+ */
+void code_write_notify(void *context, uint16_t address, size_t len);
+
+/**
+ * @brief Drop cached instructions overlapping a range of memory. Writes done
+ * through mem_write invalidate automatically; call this when memory is
+ * changed behind the emulator's back (e.g. firmware loading by the embedder)
+ * @param mcu The MCU
+ * @param address First byte written
+ * @param len Number of bytes written
+ */
+void invalidate_decoded_ops(msp430_t *mcu, uint16_t address, size_t len);
+
+/**
+ * @brief Drop all cached instructions
+ * @param mcu The MCU
+ */
+void flush_decoded_ops(msp430_t *mcu);
+
+#endif
@@ -0,0 +1,129 @@
+/*
+  This file is part of MSP430 Emulator
+
+  MSP430 Emulator is free software: you can redistribute it and/or
+  modify it under the terms of the GNU General Public License as
+  published by the Free Software Foundation, either version 3 of the
+  License, or (at your option) any later version.
+
+  MSP430 Emulator is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with MSP430 Emulator.
+  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+//##########+++ Execution Profiler +++##########
+//# Counts are kept in a flat table indexed by address, so
+//# that counting an instruction is two additions. Blocks
+//# are counted when they are charged, walking their ops.
+//##############################################
+
+#include "profiler.h"
+
+bool start_profiler(msp430_t *mcu) {
+#ifdef MSP430_PROFILER
+  if (mcu->profile_table == NULL) {
+    mcu->profile_table = calloc(0x10000, sizeof(profile_entry_t));
+  }
+  mcu->profile = mcu->profile_table;
+  return mcu->profile != NULL;
+#else
+  return false;
+#endif
+}
+
+void stop_profiler(msp430_t *mcu) { mcu->profile = NULL; }
+
+void reset_profiler(msp430_t *mcu) {
+  if (mcu->profile_table != NULL) {
+    memset(mcu->profile_table, 0, 0x10000 * sizeof(profile_entry_t));
+  }
+}
+
+profile_entry_t get_profile_entry(const msp430_t *mcu, uint16_t address) {
+  profile_entry_t none = {0, 0};
+
+  return mcu->profile_table ? mcu->profile_table[address] : none;
+}
+
+void profile_block(Cpu *cpu, const basic_block_t *block, uint16_t executed) {
+  uint16_t address = block->address;
+  uint16_t i;
+
+  for (i = 0; i < executed; i++) {
+    profile_instructions(cpu, address, 1, block->ops[i].cycles);
+    address += 2 * block->ops[i].length;
+  }
+}
+
+static void put16(uint8_t *p, uint16_t v) {
+  p[0] = v;
+  p[1] = v >> 8;
+}
+
+static void put32(uint8_t *p, uint32_t v) {
+  put16(p, v);
+  put16(p + 2, v >> 16);
+}
+
+static void put64(uint8_t *p, uint64_t v) {
+  put32(p, v);
+  put32(p + 4, v >> 32);
+}
+
+bool write_profile(const msp430_t *mcu, FILE *out) {
+  uint8_t header[sizeof PROFILE_MAGIC - 1 + 6], record[18];
+  const profile_entry_t *table = mcu->profile_table;
+  uint32_t address, count = 0;
+
+  for (address = 0; table != NULL && address < 0x10000; address++) {
+    count += table[address].executions != 0;
+  }
+
+  memcpy(header, PROFILE_MAGIC, sizeof PROFILE_MAGIC - 1);
+  put16(header + sizeof PROFILE_MAGIC - 1, PROFILE_VERSION);
+  put32(header + sizeof PROFILE_MAGIC + 1, count);
+  if (fwrite(header, sizeof header, 1, out) != 1) {
+    return false;
+  }
+
+  for (address = 0; count && address < 0x10000; address++) {
+    if (table[address].executions == 0) {
+      continue;
+    }
+    put16(record, address);
+    put64(record + 2, table[address].executions);
+    put64(record + 10, table[address].cycles);
+    if (fwrite(record, sizeof record, 1, out) != 1) {
+      return false;
+    }
+  }
+  return fflush(out) == 0;
+}
+
+bool write_folded_profile(const msp430_t *mcu, FILE *out,
+                          profile_symbolizer_t symbolize, void *context) {
+  const profile_entry_t *table = mcu->profile_table;
+  uint32_t address;
+
+  for (address = 0; table != NULL && address < 0x10000; address++) {
+    const char *function;
+
+    if (table[address].executions == 0) {
+      continue;
+    }
+
+    function = symbolize ? symbolize(context, address) : NULL;
+    if (function != NULL) {
+      fprintf(out, "%s;", function);
+    }
+    fprintf(out, "0x%04X %llu\n", address,
+            (unsigned long long)table[address].cycles);
+  }
+  return fflush(out) == 0 && !ferror(out);
+}
@@ -0,0 +1,120 @@
+/*
+  This file is part of MSP430 Emulator
+
+  MSP430 Emulator is free software: you can redistribute it and/or
+  modify it under the terms of the GNU General Public License as
+  published by the Free Software Foundation, either version 3 of the
+  License, or (at your option) any later version.
+
+  MSP430 Emulator is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with MSP430 Emulator.
+  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#ifndef _PROFILER_H_
+#define _PROFILER_H_
+
+#include "msp430.h"
+
+/* Profiles written by write_profile() start with PROFILE_MAGIC, then the
+ * version as a 16-bit word and the number of records as a 32-bit word. Each
+ * record is an address (2 bytes), its executions (8) and its cycles (8), in
+ * ascending address order, for the addresses that ran. All numbers are
+ * little-endian */
+#define PROFILE_MAGIC "MSP430PF"
+#define PROFILE_VERSION 1
+
+/* What ran at one instruction address */
+typedef struct profile_entry {
+  uint64_t executions;
+  uint64_t cycles; /* As charged through consume_cycles_cb */
+} profile_entry_t;
+
+/* Returns the name of the function holding an address, or NULL */
+typedef const char *(*profile_symbolizer_t)(void *context, uint16_t address);
+
+/**
+ * @brief Start counting the executions and cycles of every instruction by
+ * its address, in a table of 64K entries owned by the MCU. Counts carry on
+ * from where stop_profiler() left them. Without MSP430_PROFILER the core
+ * has no profiling hooks, and this fails
+ * @param mcu The MCU
+ * @return false if the table could not be allocated, or profiling is not
+ * built in
+ */
+bool start_profiler(msp430_t *mcu);
+
+/**
+ * @brief Stop counting. The counts stay readable until reset_profiler() or
+ * msp430_destroy()
+ * @param mcu The MCU
+ */
+void stop_profiler(msp430_t *mcu);
+
+/**
+ * @brief Clear the counts. The table is kept until msp430_destroy()
+ * @param mcu The MCU
+ */
+void reset_profiler(msp430_t *mcu);
+
+/**
+ * @brief Read the counts of an address
+ * @param mcu The MCU
+ * @param address Address of the instruction word
+ * @return The counts, zero if nothing was profiled
+ */
+profile_entry_t get_profile_entry(const msp430_t *mcu, uint16_t address);
+
+/**
+ * @brief Write the counts in the binary format described at PROFILE_MAGIC
+ * @param mcu The MCU
+ * @param out Stream open for binary writing
+ * @return false if writing failed
+ */
+bool write_profile(const msp430_t *mcu, FILE *out);
+
+/**
+ * @brief Write the counts as folded stacks, one "function;0xADDR cycles"
+ * line per address that ran, for flame graph tools. The profile keeps no
+ * call stacks, so each stack is the function and the address within it
+ * @param mcu The MCU
+ * @param out Stream open for writing
+ * @param symbolize Names the function of an address, NULL to leave the
+ * function out
+ * @param context Passed to symbolize
+ * @return false if writing failed
+ */
+bool write_folded_profile(const msp430_t *mcu, FILE *out,
+                          profile_symbolizer_t symbolize, void *context);
+
+/**
+ * @brief Count instructions run at an address. The engines call this for
+ * every instruction they charge; without MSP430_PROFILER it compiles to
+ * nothing, and while stopped it costs a load and a test
+ * @param cpu A pointer to the CPU structure
+ * @param address Address of the instruction word
+ * @param executions Times it ran
+ * @param cycles Cycles charged for all of them
+ */
+static inline void profile_instructions(Cpu *cpu, uint16_t address,
+                                        uint64_t executions, uint64_t cycles) {
+#ifdef MSP430_PROFILER
+  profile_entry_t *profile = cpu->mcu->profile;
+
+  if (profile != NULL) {
+    profile[address].executions += executions;
+    profile[address].cycles += cycles;
+  }
+#endif
+}
+
+/* Count the first executed instructions of a basic block */
+void profile_block(Cpu *cpu, const basic_block_t *block, uint16_t executed);
+
+#endif
@@ -21,15 +21,14 @@
 //##########+++ MSP430 Register initialization +++##########
 void initialize_msp_registers(Cpu *cpu) {
   cpu->running = false;
-  cpu->cg2 = 0;
+  cpu->flags.kind = FLAGS_NONE;
 
   // Initialise all regs to 0
-  cpu->pc = cpu->sp = cpu->sr = cpu->r4 = cpu->r5 = cpu->r6 = cpu->r7 =
-      cpu->r8 = cpu->r9 = cpu->r10 = cpu->r11 = cpu->r12 = cpu->r13 = cpu->r14 =
-          cpu->r15 = 0;
+  memset(cpu->regs, 0, sizeof cpu->regs);
 }
 
 void set_sr_flags(Cpu *cpu, bool C, bool Z, bool N, bool V) {
+  cpu->flags.kind = FLAGS_NONE;
   cpu->sr &= ~SR_FLAGS_MASK; // Clear existing flags
   // Set new flags
   cpu->sr |= C ? SR_C : 0;
@@ -38,13 +37,25 @@ void set_sr_flags(Cpu *cpu, bool C, bool Z, bool N, bool V) {
   cpu->sr |= V ? SR_V : 0;
 }
 
-bool get_carry(Cpu *cpu) { return ((cpu->sr & SR_C) > 0); }
+bool get_carry(Cpu *cpu) {
+  sync_sr(cpu);
+  return ((cpu->sr & SR_C) > 0);
+}
 
-bool get_zero_flag(Cpu *cpu) { return ((cpu->sr & SR_Z) > 0); }
+bool get_zero_flag(Cpu *cpu) {
+  sync_sr(cpu);
+  return ((cpu->sr & SR_Z) > 0);
+}
 
-bool get_negative_flag(Cpu *cpu) { return ((cpu->sr & SR_N) > 0); }
+bool get_negative_flag(Cpu *cpu) {
+  sync_sr(cpu);
+  return ((cpu->sr & SR_N) > 0);
+}
 
-bool get_overflow_flag(Cpu *cpu) { return ((cpu->sr & SR_V) > 0); }
+bool get_overflow_flag(Cpu *cpu) {
+  sync_sr(cpu);
+  return ((cpu->sr & SR_V) > 0);
+}
 
 /**
  * @brief truncate_byte truncate 16-bit value to 8-bit as if only the
@@ -29,21 +29,95 @@
 #define REG_SR 2u
 #endif
 
+/* Kinds of flag-producing operations, see lazy_flags_t */
+enum { FLAGS_NONE, FLAGS_ADD, FLAGS_SUB, FLAGS_LOGIC, FLAGS_XOR };
+
+/* The last flag-producing operation, from which C, Z, N and V can be
+ * evaluated. With MSP430_LAZY_FLAGS this is only done when the flags are
+ * read, kind is FLAGS_NONE while SR is up to date */
+typedef struct lazy_flags {
+  uint8_t kind;
+  uint8_t bw_flag;
+  bool carry_in;
+  int16_t dst, src, result;
+} lazy_flags_t;
+
+/* An emulated MCU, see msp430.h */
+typedef struct msp430 msp430_t;
+
 // Main CPU structure //
 typedef struct Cpu {
-  bool running; /* CPU running or not */
+  /* The registers, indexed by register number. The named aliases are the
+   * same storage */
+  _Alignas(64) union {
+    uint16_t regs[16];
+    struct {
+      uint16_t pc, sp, sr; /* R0, R1 and R2 respectively */
+      uint16_t cg2;        /* R3 or Constant Generator #2 */
+      uint16_t r4, r5, r6, r7, r8, r9; /* R4-R15 General Purpose Registers */
+      uint16_t r10, r11, r12, r13, r14, r15;
+    };
+  };
 
-  uint16_t pc, sp, sr; /* R0, R1 and R3 respectively */
-  int16_t cg2;         /* R3 or Constant Generator #2 */
-
-  int16_t r2, r4, r5, r6, r7; /* R4-R15 General Purpose Registers */
-  int16_t r8, r9, r10, r11;
-  int16_t r12, r13, r14, r15;
+  lazy_flags_t flags; /* Flags not yet written to SR, see sync_sr() */
+  bool running;       /* CPU running or not */
+  msp430_t *mcu;      /* The MCU this is the CPU of */
 } Cpu;
 
+_Static_assert(sizeof(Cpu) == 64, "Cpu should fill exactly one cache line");
+
+static inline uint16_t *get_reg_ptr(Cpu *cpu, uint8_t reg) {
+  return &cpu->regs[reg & 0xF];
+}
+
 void initialize_msp_registers(Cpu *cpu);
 
 void set_sr_flags(Cpu *cpu, bool C, bool Z, bool N, bool V);
+void evaluate_flags(Cpu *cpu);
+
+/**
+ * @brief Write pending flags to SR. Only needed with MSP430_LAZY_FLAGS, by
+ * code that accesses cpu->sr directly after decode() or step(). Reads through
+ * get_carry() and friends sync, and so does run_instructions() on return
+ * @param cpu A pointer to the CPU structure
+ */
+static inline void sync_sr(Cpu *cpu) {
+  if (cpu->flags.kind != FLAGS_NONE) {
+    evaluate_flags(cpu);
+  }
+}
+
+/**
+ * @brief Check whether the CPU executes no further instructions: either it
+ * was halted by an invalid or unimplemented instruction, which clears
+ * cpu->running, or SR_CPU_OFF is set
+ * @param cpu A pointer to the CPU structure
+ */
+static inline bool cpu_halted(const Cpu *cpu) {
+  return !cpu->running || (cpu->sr & SR_CPU_OFF);
+}
+
+/* Operating modes, selected by the SR_CPU_OFF, SR_OSC_OFF, SR_SCG0 and
+ * SR_SCG1 bits */
+typedef enum {
+  POWER_ACTIVE, /* CPU running */
+  POWER_LPM0,   /* CPU off */
+  POWER_LPM1,   /* CPU off, SCG0 */
+  POWER_LPM2,   /* CPU off, SCG1 */
+  POWER_LPM3,   /* CPU off, SCG0 and SCG1 */
+  POWER_LPM4,   /* CPU and all clocks off */
+} power_mode_t;
+
+static inline power_mode_t power_mode(const Cpu *cpu) {
+  if (!(cpu->sr & SR_CPU_OFF)) {
+    return POWER_ACTIVE;
+  } else if (cpu->sr & SR_OSC_OFF) {
+    return POWER_LPM4;
+  }
+  return POWER_LPM0 + ((cpu->sr & SR_SCG0) ? 1 : 0) +
+         ((cpu->sr & SR_SCG1) ? 2 : 0);
+}
+
 bool get_carry(Cpu *cpu);
 bool get_zero_flag(Cpu *cpu);
 bool get_negative_flag(Cpu *cpu);
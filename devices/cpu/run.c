@@ -0,0 +1,341 @@
+/*
+  This file is part of MSP430 Emulator
+
+  MSP430 Emulator is free software: you can redistribute it and/or
+  modify it under the terms of the GNU General Public License as
+  published by the Free Software Foundation, either version 3 of the
+  License, or (at your option) any later version.
+
+  MSP430 Emulator is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with MSP430 Emulator.
+  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+//##########+++ Batch Execution +++##########
+//# Runs the selected engine through run_instructions() in
+//# slices small enough that no budget can be overshot, and
+//# checks the stop conditions between slices. The engines
+//# themselves stop after any instruction that halts the
+//# CPU, see cpu_halted().
+//#
+//# Between slices, run() also spots idling: the CPU off in
+//# a low-power mode, or a taken jump to itself. Time up to
+//# the next wake-up event is then charged in one go.
+//# Countdown delay loops are run in closed form. Neither
+//# is skipped while an interrupt is ready to be taken.
+//###########################################
+
+#include "run.h"
+#include "../utilities.h"
+#include "alu.h"
+#include "decoder.h"
+#include "interrupt.h"
+#include "opcodes.h"
+#include "predecode.h"
+#include "profiler.h"
+
+/* Longest slice, bounds the latency of run() */
+#define RUN_SLICE 4096
+
+void set_wakeup_cb(msp430_t *mcu,
+                   uint64_t (*fptr)(void *user, power_mode_t mode)) {
+  mcu->wakeup_cb = fptr;
+}
+
+/* Cycles until the next wake-up event, see set_wakeup_cb() */
+static uint64_t wakeup(const Cpu *cpu, power_mode_t mode) {
+  return cpu->mcu->wakeup_cb(cpu->mcu->user, mode);
+}
+
+/* Notification callbacks take 16-bit counts */
+static void notify_many(Cpu *cpu, void (*notify)(Cpu *, uint16_t),
+                        uint64_t count) {
+  while (count) {
+    uint16_t part = count > 0xFFFF ? 0xFFFF : count;
+    notify(cpu, part);
+    count -= part;
+  }
+}
+
+static uint64_t div_round_up(uint64_t a, uint64_t b) {
+  return a / b + (a % b != 0);
+}
+
+/* A countdown delay loop: ADD or SUB of a constant to a general purpose
+ * register, then JNZ back to it. Touches no memory and no other register */
+typedef struct delay_loop {
+  const decoded_op_t *count, *jump;
+  uint16_t step; /* Subtracted from the register per turn */
+} delay_loop_t;
+
+static bool find_delay_loop(msp430_t *mcu, uint16_t head,
+                            delay_loop_t *loop) {
+  uint16_t tail;
+
+  if (head & 1) {
+    return false;
+  }
+
+  loop->count = get_decoded_op(mcu, head);
+  if (loop->count->format != 1 ||
+      (loop->count->opcode != OP_ADD && loop->count->opcode != OP_SUB) ||
+      (loop->count->src_mode != MODE_CONSTANT &&
+       loop->count->src_mode != MODE_IMMEDIATE) ||
+      loop->count->dst_mode != MODE_REGISTER ||
+      loop->count->bw_flag != WORD || loop->count->destination < 4) {
+    return false;
+  }
+
+  tail = head + 2 * loop->count->length;
+  loop->jump = get_decoded_op(mcu, tail);
+  if (loop->jump->format != 3 || loop->jump->opcode != 0 /* JNZ */ ||
+      (uint16_t)(tail + 2 + loop->jump->src_word) != head ||
+      has_breakpoint(mcu, head) || has_breakpoint(mcu, tail)) {
+    return false;
+  }
+
+  loop->step = loop->count->opcode == OP_SUB ? loop->count->src_word
+                                             : -loop->count->src_word;
+  return loop->step != 0;
+}
+
+/* Turns until the register is zero: the smallest n >= 1 with
+ * n * step = value (mod 2^16), or 0 if the loop never ends */
+static uint32_t turns_to_zero(uint16_t value, uint16_t step) {
+  uint32_t modulus = 0x10000;
+  uint16_t inverse, n;
+  int i;
+
+  while (!(step & 1)) {
+    if (value & 1) {
+      return 0;
+    }
+    step >>= 1;
+    value >>= 1;
+    modulus >>= 1;
+  }
+
+  /* Newton's iteration doubles the correct low bits of an odd inverse */
+  inverse = step;
+  for (i = 0; i < 4; i++) {
+    inverse *= 2 - step * inverse;
+  }
+
+  n = (uint16_t)(value * inverse) & (modulus - 1);
+  return n ? n : modulus;
+}
+
+/* A taken jump to itself repeats until an interrupt: jumps leave the flags
+ * it tests alone */
+static const decoded_op_t *self_loop(Cpu *cpu) {
+  const decoded_op_t *op;
+
+  if (cpu->pc & 1) {
+    return NULL;
+  }
+
+  op = get_decoded_op(cpu->mcu, cpu->pc);
+  if (op->format == 3 && op->src_word == -2 && op->cycles &&
+      alu_jump_taken(cpu, op->opcode)) {
+    return op;
+  }
+  return NULL;
+}
+
+bool has_breakpoint(const msp430_t *mcu, uint16_t address) {
+  return mcu->breakpoints[address >> 3] & (1u << (address & 7));
+}
+
+void set_breakpoint(msp430_t *mcu, uint16_t address) {
+  if (!has_breakpoint(mcu, address)) {
+    mcu->breakpoints[address >> 3] |= 1u << (address & 7);
+    mcu->breakpoint_count++;
+  }
+}
+
+void clear_breakpoint(msp430_t *mcu, uint16_t address) {
+  if (has_breakpoint(mcu, address)) {
+    mcu->breakpoints[address >> 3] &= ~(1u << (address & 7));
+    mcu->breakpoint_count--;
+  }
+}
+
+void clear_breakpoints(msp430_t *mcu) {
+  memset(mcu->breakpoints, 0, sizeof mcu->breakpoints);
+  mcu->breakpoint_count = 0;
+}
+
+stop_reason_t run(Cpu *cpu, uint64_t max_cycles, uint64_t max_instructions,
+                  run_stats_t *stats) {
+  msp430_t *mcu = cpu->mcu;
+  uint64_t instructions = 0, idle_cycles = 0;
+  uint64_t start_cycles = mcu->stats.cycles;
+  const decoded_op_t *loop;
+  delay_loop_t delay;
+  stop_reason_t reason;
+  bool ready;
+
+  for (;;) {
+    /* Everything the core charges is counted in the statistics */
+    uint64_t run_cycles = mcu->stats.cycles - start_cycles;
+    uint64_t slice = RUN_SLICE;
+    uint64_t cycle_slice;
+
+    if (run_cycles >= max_cycles) {
+      reason = STOP_CYCLES;
+      break;
+    } else if (instructions >= max_instructions) {
+      reason = STOP_INSTRUCTIONS;
+      break;
+    } else if (mcu->breakpoint_count && instructions &&
+               has_breakpoint(mcu, cpu->pc)) {
+      reason = STOP_BREAKPOINT;
+      break;
+    }
+
+    /* Nothing is skipped past an interrupt that the engine would take */
+    ready = interrupt_ready(cpu);
+
+    /* Idle: skip to the wake-up event, or as far as the budgets allow */
+    if (mcu->wakeup_cb != NULL && (cpu->sr & SR_CPU_OFF) && !ready) {
+      uint64_t wait = wakeup(cpu, power_mode(cpu));
+      bool due = wait <= max_cycles - run_cycles;
+
+      if (wait == RUN_UNLIMITED && max_cycles == RUN_UNLIMITED) {
+        reason = STOP_CPU_OFF; /* Nothing will ever wake it */
+        break;
+      }
+
+      wait = due ? wait : max_cycles - run_cycles;
+      notify_many(cpu, consume_cycles, wait);
+      idle_cycles += wait;
+      if (due) {
+        reason = STOP_WAKEUP;
+        break;
+      }
+      continue;
+    }
+
+    if (mcu->wakeup_cb != NULL && !ready && !has_breakpoint(mcu, cpu->pc) &&
+        (loop = self_loop(cpu)) != NULL) {
+      uint64_t wait = wakeup(cpu, POWER_ACTIVE);
+      uint64_t turns = RUN_UNLIMITED, budget = max_instructions - instructions;
+      bool due;
+
+      /* Stepping would stop after the jump that reaches the event or the
+       * cycle budget */
+      if (wait != RUN_UNLIMITED) {
+        turns = div_round_up(wait, loop->cycles);
+      }
+      if (max_cycles != RUN_UNLIMITED &&
+          div_round_up(max_cycles - run_cycles, loop->cycles) < budget) {
+        budget = div_round_up(max_cycles - run_cycles, loop->cycles);
+      }
+
+      if (turns != RUN_UNLIMITED || budget != RUN_UNLIMITED) {
+        due = turns <= budget;
+        turns = due ? turns : budget;
+
+        notify_many(cpu, register_read_notify, turns * loop->reg_reads);
+        notify_many(cpu, consume_cycles, turns * loop->cycles);
+        notify_many(cpu, register_write_notify, turns);
+        flush_register_notify(cpu);
+        profile_instructions(cpu, cpu->pc, turns, turns * loop->cycles);
+        instructions += turns;
+        mcu->stats.instructions += turns;
+        idle_cycles += turns * loop->cycles;
+        if (due) {
+          reason = STOP_WAKEUP;
+          break;
+        }
+        continue;
+      }
+    }
+
+    if (!ready && find_delay_loop(mcu, cpu->pc, &delay)) {
+      uint16_t *reg = get_reg_ptr(cpu, delay.count->destination);
+      uint64_t cost = delay.count->cycles + delay.jump->cycles;
+      uint64_t turns = turns_to_zero(*reg, delay.step);
+      uint64_t event = RUN_UNLIMITED;
+
+      /* Leave the last turn, which falls through, to the engine */
+      turns = turns ? turns - 1 : 0;
+      if ((max_instructions - instructions) / 2 < turns) {
+        turns = (max_instructions - instructions) / 2;
+      }
+      if (cost && max_cycles != RUN_UNLIMITED &&
+          (max_cycles - run_cycles) / cost < turns) {
+        turns = (max_cycles - run_cycles) / cost;
+      }
+      if (mcu->wakeup_cb != NULL && cost) { /* An interrupt may be due first */
+        event = div_round_up(wakeup(cpu, POWER_ACTIVE), cost);
+        if (event < turns) {
+          turns = event;
+        }
+      }
+
+      if (turns) {
+        /* All but the last turn in closed form, which is run by the ALU
+         * for the flags it leaves */
+        notify_many(cpu, register_read_notify,
+                    turns * (delay.count->reg_reads + delay.jump->reg_reads));
+        notify_many(cpu, consume_cycles, turns * cost);
+        notify_many(cpu, register_write_notify, 2 * turns - 1);
+        *reg -= (turns - 1) * delay.step;
+        alu_formatI(cpu, delay.count->opcode, WORD, delay.count->src_word,
+                    *reg, false, 0, reg);
+        flush_register_notify(cpu);
+        profile_instructions(cpu, cpu->pc, turns, turns * delay.count->cycles);
+        profile_instructions(cpu, cpu->pc + 2 * delay.count->length, turns,
+                             turns * delay.jump->cycles);
+        instructions += 2 * turns;
+        mcu->stats.instructions += 2 * turns;
+      }
+
+      if (turns == event) {
+        reason = STOP_WAKEUP;
+        break;
+      } else if (turns) {
+        continue;
+      }
+    }
+
+    /* No slice can charge more than the remaining cycles, even if an
+     * interrupt is taken before each instruction, except a single
+     * instruction that crosses the budget */
+    cycle_slice = (max_cycles - run_cycles) / MAX_STEP_CYCLES;
+    if (cycle_slice < slice) {
+      slice = cycle_slice ? cycle_slice : 1;
+    }
+    if (max_instructions - instructions < slice) {
+      slice = max_instructions - instructions;
+    }
+    if (mcu->breakpoint_count) {
+      slice = 1;
+    }
+
+    instructions += run_instructions(cpu, slice);
+
+    if (!cpu->running) {
+      reason = STOP_ERROR;
+      break;
+    } else if ((cpu->sr & SR_CPU_OFF) && mcu->wakeup_cb == NULL &&
+               !interrupt_ready(cpu)) {
+      reason = STOP_CPU_OFF;
+      break;
+    }
+  }
+
+  sync_sr(cpu); /* The flags of an elided delay loop's last ALU operation */
+  if (stats != NULL) {
+    stats->cycles = mcu->stats.cycles - start_cycles;
+    stats->instructions = instructions;
+    stats->idle_cycles = idle_cycles;
+  }
+  return reason;
+}
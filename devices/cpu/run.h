@@ -0,0 +1,122 @@
+/*
+  This file is part of MSP430 Emulator
+
+  MSP430 Emulator is free software: you can redistribute it and/or
+  modify it under the terms of the GNU General Public License as
+  published by the Free Software Foundation, either version 3 of the
+  License, or (at your option) any later version.
+
+  MSP430 Emulator is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with MSP430 Emulator.
+  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef _RUN_H_
+#define _RUN_H_
+
+#include "interrupt.h"
+#include "msp430.h"
+#include "registers.h"
+
+/* No limit, for the budgets passed to run() */
+#define RUN_UNLIMITED UINT64_MAX
+
+/* Most cycles one instruction can charge through consume_cycles_cb */
+#define MAX_INSTRUCTION_CYCLES 6
+
+/* Most cycles one instruction can charge, with the interrupt the engines
+ * may take before it. run() stops less than this past its cycle budget */
+#define MAX_STEP_CYCLES (MAX_INSTRUCTION_CYCLES + INTERRUPT_ENTRY_CYCLES)
+
+/* Why run() returned */
+typedef enum {
+  STOP_CYCLES,       /* The cycle budget is used up */
+  STOP_INSTRUCTIONS, /* The instruction budget is used up */
+  STOP_BREAKPOINT,   /* PC is at a breakpoint */
+  STOP_CPU_OFF,      /* SR_CPU_OFF is set, and no interrupt is ready */
+  STOP_ERROR,        /* An invalid or unimplemented instruction halted the CPU */
+  STOP_WAKEUP,       /* Idle until the wake-up event, which is now due */
+} stop_reason_t;
+
+/* What run() did */
+typedef struct run_stats {
+  uint64_t cycles;       /* Charged through consume_cycles_cb */
+  uint64_t instructions; /* Executed */
+  uint64_t idle_cycles;  /* Skipped while idle, included in cycles */
+} run_stats_t;
+
+/**
+ * @brief Let run() skip idle time. While the CPU is off, or spins on a
+ * taken jump to itself (JMP $), run() asks the callback how many cycles
+ * remain until the next event that can end the idling, charges them through
+ * consume_cycles_cb in one go, and returns STOP_WAKEUP. A jump to itself
+ * counts as executed once per JMP it replaces, with the same cycles and
+ * register notifications. Countdown delay loops, which run() elides
+ * whether or not a callback is set, also stop at the event so that a
+ * pending interrupt can be taken.
+ *
+ * The callback gets the operating mode, so that it can leave out events
+ * driven by clocks the mode stops. It returns RUN_UNLIMITED when no event is
+ * scheduled, and 0 only when an event is due, which the embedder has to
+ * handle before calling run() again. Without a callback, or NULL, run()
+ * executes idle loops and stops at SR_CPU_OFF as before
+ * @param mcu The MCU
+ * @param fptr The callback, gets the user pointer of the MCU and the mode
+ */
+void set_wakeup_cb(msp430_t *mcu,
+                   uint64_t (*fptr)(void *user, power_mode_t mode));
+
+/**
+ * @brief Make run() stop before executing the instruction at an address
+ * @param mcu The MCU
+ * @param address Address of the instruction
+ */
+void set_breakpoint(msp430_t *mcu, uint16_t address);
+
+/**
+ * @brief Remove a breakpoint set with set_breakpoint()
+ * @param mcu The MCU
+ * @param address Address of the instruction
+ */
+void clear_breakpoint(msp430_t *mcu, uint16_t address);
+
+/**
+ * @brief Remove all breakpoints
+ * @param mcu The MCU
+ */
+void clear_breakpoints(msp430_t *mcu);
+
+bool has_breakpoint(const msp430_t *mcu, uint16_t address);
+
+/**
+ * @brief Execute instructions with the selected engine until a budget is used
+ * up, a breakpoint is reached or the CPU halts. Without breakpoints set, the
+ * engine runs in slices as long as the budgets allow; with breakpoints set,
+ * one instruction at a time.
+ *
+ * The cycle budget counts cycles the core charges through consume_cycles_cb,
+ * which is still called for every charge. run() stops at the first
+ * instruction boundary at which max_cycles have been charged.
+ *
+ * Delay loops that count a register down to zero with ADD or SUB of a
+ * constant and JNZ (DEC Rn ; JNZ \$-2) are run in closed form: the register,
+ * flags, cycles and register notifications end up as if each turn had been
+ * executed.
+ * @param cpu A pointer to the CPU structure
+ * @param max_cycles Cycle budget, or RUN_UNLIMITED
+ * @param max_instructions Instruction budget, or RUN_UNLIMITED
+ * @param stats Receives cycles charged and instructions executed, may be NULL
+ * @return The reason execution stopped. A breakpoint at the current PC does
+ * not stop execution before the first instruction, so that run() can resume
+ * from it. STOP_CPU_OFF means SR_CPU_OFF is set, no interrupt is ready to
+ * wake the CPU and no wake-up event is scheduled, see set_wakeup_cb()
+ */
+stop_reason_t run(Cpu *cpu, uint64_t max_cycles, uint64_t max_instructions,
+                  run_stats_t *stats);
+
+#endif
@@ -0,0 +1,253 @@
+/*
+  This file is part of MSP430 Emulator
+
+  MSP430 Emulator is free software: you can redistribute it and/or
+  modify it under the terms of the GNU General Public License as
+  published by the Free Software Foundation, either version 3 of the
+  License, or (at your option) any later version.
+
+  MSP430 Emulator is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with MSP430 Emulator.
+  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+//##########+++ Snapshots +++##########
+//# Host memory is saved lazily: taking a snapshot write-
+//# protects the writable pages, and the first write to a
+//# page copies it once for every live snapshot that has
+//# no copy yet, so the copy is shared and counted. Any
+//# page that is not write-protected is saved in every live
+//# snapshot. Restoring copies back only the pages written
+//# since, and protects them again.
+//#####################################
+
+#include "snapshot.h"
+#include "interrupt.h"
+
+bool register_snapshot_state(msp430_t *mcu, void *state, size_t len) {
+  if (mcu->snapshot_state_count == SNAPSHOT_STATES) {
+    return false;
+  }
+  mcu->snapshot_states[mcu->snapshot_state_count++] =
+      (state_block_t){state, len};
+  return true;
+}
+
+void clear_snapshot_states(msp430_t *mcu) { mcu->snapshot_state_count = 0; }
+
+void *snapshot_state(const msp430_t *mcu, uint32_t index, size_t *len) {
+  if (index >= mcu->snapshot_state_count) {
+    return NULL;
+  }
+  *len = mcu->snapshot_states[index].len;
+  return mcu->snapshot_states[index].state;
+}
+
+static bool is_live(const msp430_t *mcu, const snapshot_t *snap) {
+  const snapshot_t *live;
+
+  for (live = mcu ? mcu->snapshots : NULL; live != NULL; live = live->next) {
+    if (live == snap) {
+      return true;
+    }
+  }
+  return false;
+}
+
+/* Before a page of host memory changes, save it for the live snapshots that
+ * still share it with memory. Out of memory, those snapshots are dropped,
+ * as they could not be restored */
+static void save_page(msp430_t *mcu, uint16_t page) {
+  snapshot_page_t *saved = NULL;
+  snapshot_t **link = &mcu->snapshots, *snap;
+  bool dropped = false;
+
+  while ((snap = *link) != NULL) {
+    if (snap->pages[page] == NULL && saved == NULL &&
+        (saved = malloc(sizeof *saved)) != NULL) {
+      saved->refs = 0;
+      memcpy(saved->data, writable_host_page(&mcu->bus, page), MEM_PAGE_SIZE);
+    }
+    if (snap->pages[page] == NULL) {
+      if (saved == NULL) {
+        *link = snap->next;
+        dropped = true;
+        continue;
+      }
+      snap->pages[page] = saved;
+      saved->refs++;
+    }
+    snap->dirty[page] = true;
+    link = &snap->next;
+  }
+
+  if (dropped) {
+    fprintf(stderr, "Snapshots dropped, out of memory for page %04X\n",
+            page << MEM_PAGE_SHIFT);
+    if (mcu->snapshots == NULL) {
+      protect_host_pages(&mcu->bus, NULL, NULL);
+    }
+  }
+}
+
+static void page_written(void *context, uint16_t page) {
+  save_page(context, page);
+}
+
+bool take_snapshot(snapshot_t *snap, const Cpu *cpu) {
+  msp430_t *mcu = cpu->mcu;
+  const state_block_t *states = mcu->snapshot_states;
+  size_t len = 0;
+  uint32_t i;
+
+  if (is_live(mcu, snap)) {
+    free_snapshot(snap);
+  }
+  memset(snap, 0, sizeof *snap);
+  for (i = 0; i < mcu->snapshot_state_count; i++) {
+    len += states[i].len;
+  }
+
+  snap->state = malloc(len ? len : 1);
+  if (snap->state == NULL) {
+    return false;
+  }
+
+  for (i = 0; i < mcu->snapshot_state_count; i++) {
+    memcpy(snap->state + snap->state_len, states[i].state, states[i].len);
+    snap->state_len += states[i].len;
+  }
+  snap->mcu = mcu;
+  snap->cpu = *cpu;
+  snap->interrupt_requests = mcu->interrupt_requests;
+
+  snap->next = mcu->snapshots;
+  mcu->snapshots = snap;
+  protect_host_pages(&mcu->bus, page_written, mcu);
+  return true;
+}
+
+/* Copy the registered blocks out of a snapshot */
+static void restore_states(const snapshot_t *snap, msp430_t *mcu) {
+  const state_block_t *states = mcu->snapshot_states;
+  size_t offset = 0;
+  uint32_t i;
+
+  for (i = 0; i < mcu->snapshot_state_count &&
+              offset + states[i].len <= snap->state_len;
+       i++) {
+    memcpy(states[i].state, snap->state + offset, states[i].len);
+    offset += states[i].len;
+  }
+}
+
+bool restore_snapshot(snapshot_t *snap, Cpu *cpu) {
+  msp430_t *mcu = cpu->mcu;
+  bus_t *bus = &mcu->bus;
+  uint16_t page;
+
+  if (!is_live(mcu, snap)) {
+    return false;
+  }
+
+  for (page = 0; page < MEM_PAGES; page++) {
+    if (!snap->dirty[page] || writable_host_page(bus, page) == NULL) {
+      continue;
+    }
+    // The other snapshots may still share the page with memory
+    save_page(mcu, page);
+    memcpy(writable_host_page(bus, page), snap->pages[page]->data,
+           MEM_PAGE_SIZE);
+    /* Cached code may be stale */
+    mem_write_notify(bus, page << MEM_PAGE_SHIFT, MEM_PAGE_SIZE);
+    protect_host_page(bus, page);
+    snap->dirty[page] = false;
+  }
+
+  restore_states(snap, mcu);
+  *cpu = snap->cpu;
+  mcu->interrupt_requests = snap->interrupt_requests;
+  return true;
+}
+
+bool snapshot_fork(snapshot_t *snap, msp430_t *mcu) {
+  const bus_t *from = snap->mcu ? &snap->mcu->bus : NULL;
+  size_t len = 0;
+  uint16_t page;
+  uint32_t i;
+
+  if (mcu == snap->mcu) {
+    return restore_snapshot(snap, &mcu->cpu);
+  }
+  if (!is_live(snap->mcu, snap)) {
+    return false;
+  }
+
+  for (i = 0; i < mcu->snapshot_state_count; i++) {
+    len += mcu->snapshot_states[i].len;
+  }
+  if (len != snap->state_len) {
+    fprintf(stderr, "Snapshot state blocks do not fit the MCU\n");
+    return false;
+  }
+  for (page = 0; page < MEM_PAGES; page++) {
+    if (writable_host_page(from, page) != NULL &&
+        (writable_host_page(&mcu->bus, page) == NULL ||
+         writable_host_page(&mcu->bus, page) ==
+             writable_host_page(from, page))) {
+      fprintf(stderr, "Snapshot page %04X is not own writable host memory\n",
+              page << MEM_PAGE_SHIFT);
+      return false;
+    }
+  }
+
+  for (page = 0; page < MEM_PAGES; page++) {
+    const uint8_t *data = snap->pages[page] ? snap->pages[page]->data
+                                            : writable_host_page(from, page);
+    uint8_t *host = writable_host_page(&mcu->bus, page);
+
+    if (data == NULL || !memcmp(host, data, MEM_PAGE_SIZE)) {
+      continue;
+    }
+    save_page(mcu, page);
+    memcpy(host, data, MEM_PAGE_SIZE);
+    mem_write_notify(&mcu->bus, page << MEM_PAGE_SHIFT, MEM_PAGE_SIZE);
+  }
+
+  restore_states(snap, mcu);
+  mcu->cpu = snap->cpu;
+  mcu->cpu.mcu = mcu;
+  mcu->interrupt_requests = snap->interrupt_requests;
+  return true;
+}
+
+void free_snapshot(snapshot_t *snap) {
+  snapshot_t **link;
+  uint16_t page;
+
+  if (is_live(snap->mcu, snap)) {
+    for (link = &snap->mcu->snapshots; *link != snap; link = &(*link)->next) {
+    }
+    *link = snap->next;
+    if (snap->mcu->snapshots == NULL) {
+      protect_host_pages(&snap->mcu->bus, NULL, NULL);
+    }
+  }
+
+  for (page = 0; page < MEM_PAGES; page++) {
+    if (snap->pages[page] != NULL && --snap->pages[page]->refs == 0) {
+      free(snap->pages[page]);
+    }
+    snap->pages[page] = NULL;
+  }
+  free(snap->state);
+  snap->state = NULL;
+  snap->mcu = NULL;
+  snap->next = NULL;
+}
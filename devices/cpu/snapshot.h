@@ -0,0 +1,130 @@
+/*
+  This file is part of MSP430 Emulator
+
+  MSP430 Emulator is free software: you can redistribute it and/or
+  modify it under the terms of the GNU General Public License as
+  published by the Free Software Foundation, either version 3 of the
+  License, or (at your option) any later version.
+
+  MSP430 Emulator is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with MSP430 Emulator.
+  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#ifndef _SNAPSHOT_H_
+#define _SNAPSHOT_H_
+
+#include "../utilities.h"
+#include "registers.h"
+
+/* Most blocks register_snapshot_state() takes */
+#define SNAPSHOT_STATES 32
+
+/* A block of the embedder's memory, see register_snapshot_state() */
+typedef struct state_block {
+  void *state;
+  size_t len;
+} state_block_t;
+
+/* A page as it was before a write, shared by the snapshots it belongs to */
+typedef struct snapshot_page {
+  uint32_t refs; /* Snapshots holding it */
+  uint8_t data[MEM_PAGE_SIZE];
+} snapshot_page_t;
+
+/* Emulator state at one point, to return to with restore_snapshot() */
+typedef struct snapshot {
+  msp430_t *mcu;         /* The MCU it was taken of */
+  struct snapshot *next; /* The next older live snapshot of the MCU */
+  Cpu cpu;
+  uint16_t interrupt_requests;
+  /* Saved page contents, NULL while the page is unchanged since the
+   * snapshot */
+  snapshot_page_t *pages[MEM_PAGES];
+  bool dirty[MEM_PAGES]; /* Written since the snapshot or the last restore */
+  uint8_t *state;        /* Registered blocks, one after the other */
+  size_t state_len;
+} snapshot_t;
+
+/**
+ * @brief Have snapshots include a block of the embedder's memory, such as
+ * peripheral registers or the queue of pending events. Blocks are copied
+ * whole when a snapshot is taken and restored
+ * @param mcu The MCU
+ * @param state The block
+ * @param len Its length in bytes
+ * @return false if SNAPSHOT_STATES blocks are registered already
+ */
+bool register_snapshot_state(msp430_t *mcu, void *state, size_t len);
+
+/**
+ * @brief Forget the blocks given to register_snapshot_state()
+ * @param mcu The MCU
+ */
+void clear_snapshot_states(msp430_t *mcu);
+
+/**
+ * @brief Get a block given to register_snapshot_state(), for saving it
+ * elsewhere, see checkpoint.h
+ * @param mcu The MCU
+ * @param index Blocks are numbered in the order they were registered
+ * @param len Receives the length of the block
+ * @return The block, or NULL if there are not that many
+ */
+void *snapshot_state(const msp430_t *mcu, uint32_t index, size_t *len);
+
+/**
+ * @brief Record the CPU, pending interrupts, registered state and host
+ * memory, see map_host_memory(). Memory is not copied: the writable pages
+ * are write-protected, and the first write to a page saves one copy of it
+ * for all the live snapshots that need it. Memory behind the callbacks and
+ * devices is the embedder's to save, through register_snapshot_state(). Any
+ * number of snapshots of an MCU can be live at once
+ * @param snap Receives the snapshot. Free a snapshot it holds first, unless
+ * it is live
+ * @param cpu A pointer to the CPU structure
+ * @return false if memory could not be allocated
+ */
+bool take_snapshot(snapshot_t *snap, const Cpu *cpu);
+
+/**
+ * @brief Return to a snapshot. Only pages written since the snapshot, or
+ * since the last restore of it, are copied back, so a snapshot can be
+ * restored again and again to run variants from the same point cheaply.
+ * Other live snapshots keep their state. The host memory mapping must not
+ * have changed since the snapshot was taken
+ * @param snap The snapshot
+ * @param cpu A pointer to the CPU structure of the MCU it was taken of
+ * @return false if snap was freed, is of another MCU, or was dropped because
+ * memory ran out when a page had to be saved
+ */
+bool restore_snapshot(snapshot_t *snap, Cpu *cpu);
+
+/**
+ * @brief Put another MCU in the state of a snapshot, to run it from there
+ * alongside the MCU the snapshot was taken of. The MCU must map writable host
+ * memory, of its own, at every page the snapshot's MCU does, and register
+ * state blocks of the same lengths. All of that memory is copied, except the
+ * pages that already match
+ * @param snap The snapshot
+ * @param mcu The MCU to set
+ * @return false if snap was freed or dropped, see restore_snapshot(), or the
+ * MCU's memory or state blocks do not fit. The MCU is unchanged then
+ */
+bool snapshot_fork(snapshot_t *snap, msp430_t *mcu);
+
+/**
+ * @brief Release a snapshot, and the saved pages no other snapshot shares.
+ * Freeing the last live snapshot of an MCU lifts the write protection of its
+ * host memory
+ * @param snap The snapshot
+ */
+void free_snapshot(snapshot_t *snap);
+
+#endif
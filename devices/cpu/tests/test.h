@@ -0,0 +1,107 @@
+/*
+  This file is part of MSP430 Emulator
+
+  MSP430 Emulator is free software: you can redistribute it and/or
+  modify it under the terms of the GNU General Public License as
+  published by the Free Software Foundation, either version 3 of the
+  License, or (at your option) any later version.
+
+  MSP430 Emulator is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with MSP430 Emulator.
+  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#ifndef _TEST_H_
+#define _TEST_H_
+
+#include "../decoder.h"
+#include "../msp430.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+/* Checks count their failures, which test_result() turns into the exit
+ * status of the test */
+static int failures;
+
+#define CHECK(cond)                                                            \
+  do {                                                                         \
+    if (!(cond)) {                                                             \
+      fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); \
+      failures++;                                                              \
+    }                                                                          \
+  } while (0)
+
+static inline int test_result(const char *name) {
+  if (failures) {
+    fprintf(stderr, "%s: %d checks failed\n", name, failures);
+  }
+  return failures != 0;
+}
+
+/* An MCU whose address space is a byte array behind the memory callbacks,
+ * with words stored little-endian */
+typedef struct test_mcu {
+  msp430_t *mcu;
+  uint64_t cycles; /* Charged through consume_cycles_cb */
+  uint8_t mem[0x10000];
+} test_mcu_t;
+
+static inline void test_read(void *user, uint32_t address, uint8_t *data,
+                             size_t len) {
+  test_mcu_t *t = user;
+  size_t i;
+
+  for (i = 0; i < len; i++) {
+    data[i] = t->mem[(address + i) & 0xFFFF];
+  }
+}
+
+static inline void test_write(void *user, uint32_t address, uint8_t *data,
+                              size_t len) {
+  test_mcu_t *t = user;
+  size_t i;
+
+  for (i = 0; i < len; i++) {
+    t->mem[(address + i) & 0xFFFF] = data[i];
+  }
+}
+
+static inline void test_cycles(void *user, uint16_t cycles) {
+  ((test_mcu_t *)user)->cycles += cycles;
+}
+
+static inline test_mcu_t *test_mcu_create(void) {
+  test_mcu_t *t = calloc(1, sizeof *t);
+
+  if (t == NULL || (t->mcu = msp430_create(t)) == NULL) {
+    fprintf(stderr, "out of memory\n");
+    exit(1);
+  }
+  set_read_memory_cb(&t->mcu->bus, test_read);
+  set_write_memory_cb(&t->mcu->bus, test_write);
+  set_consume_cycles_cb(t->mcu, test_cycles);
+  return t;
+}
+
+static inline void test_mcu_destroy(test_mcu_t *t) {
+  msp430_destroy(t->mcu);
+  free(t);
+}
+
+/* Store a word behind the emulator's back, the caller drops cached code */
+static inline void put_word(test_mcu_t *t, uint16_t address, uint16_t word) {
+  t->mem[address] = word;
+  t->mem[(uint16_t)(address + 1)] = word >> 8;
+}
+
+static inline uint16_t get_word(const test_mcu_t *t, uint16_t address) {
+  return t->mem[address] | t->mem[(uint16_t)(address + 1)] << 8;
+}
+
+#endif
@@ -0,0 +1,151 @@
+/*
+  This file is part of MSP430 Emulator
+
+  MSP430 Emulator is free software: you can redistribute it and/or
+  modify it under the terms of the GNU General Public License as
+  published by the Free Software Foundation, either version 3 of the
+  License, or (at your option) any later version.
+
+  MSP430 Emulator is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with MSP430 Emulator.
+  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+//##########+++ Checkpoint Test +++##########
+//# Writes checkpoints of pages that compress badly and
+//# well, resumes them into scrambled memory, and fails a
+//# checkpoint halfway through to check that the file is
+//# cut back and the next checkpoint is complete.
+//###########################################
+
+#include "../checkpoint.h"
+#include "test.h"
+#include <signal.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define RAM 0x2000
+#define RAM_PAGES 8
+
+/* Header, and per page the record header, page number and contents with a
+ * control byte per 128 bytes */
+#define FILE_HEADER 12
+#define PAGE_RECORD_MAX (5 + 2 + MEM_PAGE_SIZE + (MEM_PAGE_SIZE + 127) / 128)
+
+static uint8_t ram[RAM_PAGES * MEM_PAGE_SIZE];
+static uint8_t saved[sizeof ram];
+
+/* Patterns that PackBits handles worst, and best */
+static void fill_page(uint8_t *page, int pattern) {
+  static const char *const repeats[] = {"abb", "ab", "aabb", "abbb", "aaab"};
+  size_t i;
+
+  for (i = 0; i < MEM_PAGE_SIZE; i++) {
+    if (pattern < 5) {
+      page[i] = repeats[pattern][i % strlen(repeats[pattern])];
+    } else if (pattern == 5) {
+      page[i] = 0x55;
+    } else {
+      page[i] = rand();
+    }
+  }
+}
+
+static long file_size(const char *path) {
+  struct stat st;
+
+  return stat(path, &st) == 0 ? st.st_size : -1;
+}
+
+/* Scramble memory and registers, resume, and compare with what was saved */
+static void check_resume(test_mcu_t *t, const char *path) {
+  Cpu *cpu = &t->mcu->cpu;
+
+  memset(ram, 0xA5, sizeof ram);
+  cpu->r4 = 0;
+  CHECK(resume_checkpoint(path, cpu));
+  CHECK(!memcmp(ram, saved, sizeof ram));
+  CHECK(cpu->r4 == 0x1234);
+}
+
+static void test_round_trip(test_mcu_t *t, const char *path) {
+  checkpoint_t ck;
+  int page;
+
+  for (page = 0; page < RAM_PAGES; page++) {
+    fill_page(&ram[page * MEM_PAGE_SIZE], page);
+  }
+  memcpy(saved, ram, sizeof ram);
+  t->mcu->cpu.r4 = 0x1234;
+
+  CHECK(open_checkpoint(&ck, t->mcu, path, false));
+  CHECK(write_checkpoint(&ck, &t->mcu->cpu));
+  close_checkpoint(&ck);
+  CHECK(file_size(path) <= FILE_HEADER + RAM_PAGES * PAGE_RECORD_MAX + 100);
+  check_resume(t, path);
+
+  /* A checkpoint of the changed pages only */
+  CHECK(open_checkpoint(&ck, t->mcu, path, true));
+  fill_page(ram, 6);
+  fill_page(&ram[3 * MEM_PAGE_SIZE], 0);
+  memcpy(saved, ram, sizeof ram);
+  CHECK(write_checkpoint(&ck, &t->mcu->cpu));
+  close_checkpoint(&ck);
+  check_resume(t, path);
+}
+
+/* A file size limit stops the writes of a checkpoint halfway */
+static void test_failure(test_mcu_t *t, const char *path) {
+  struct rlimit limit;
+  checkpoint_t ck;
+  long size;
+
+  CHECK(open_checkpoint(&ck, t->mcu, path, false));
+  CHECK(write_checkpoint(&ck, &t->mcu->cpu));
+  size = file_size(path);
+
+  fill_page(ram, 6);
+  fill_page(&ram[5 * MEM_PAGE_SIZE], 6);
+  CHECK(getrlimit(RLIMIT_FSIZE, &limit) == 0);
+  signal(SIGXFSZ, SIG_IGN);
+  limit.rlim_cur = size + MEM_PAGE_SIZE;
+  CHECK(setrlimit(RLIMIT_FSIZE, &limit) == 0);
+  CHECK(!write_checkpoint(&ck, &t->mcu->cpu));
+  CHECK(file_size(path) == size);
+
+  /* Both pages are written again, though the first was written before */
+  limit.rlim_cur = limit.rlim_max;
+  CHECK(setrlimit(RLIMIT_FSIZE, &limit) == 0);
+  memcpy(saved, ram, sizeof ram);
+  CHECK(write_checkpoint(&ck, &t->mcu->cpu));
+  close_checkpoint(&ck);
+  check_resume(t, path);
+}
+
+int main(void) {
+  test_mcu_t *t = test_mcu_create();
+  char path[] = "/tmp/test_checkpoint_XXXXXX";
+  int fd = mkstemp(path);
+
+  if (fd < 0) {
+    fprintf(stderr, "Cannot create %s\n", path);
+    return 1;
+  }
+  close(fd);
+  CHECK(map_host_memory(&t->mcu->bus, RAM, ram, sizeof ram, true));
+
+  test_round_trip(t, path);
+  test_failure(t, path);
+
+  unlink(path);
+  test_mcu_destroy(t);
+  return test_result("test_checkpoint");
+}
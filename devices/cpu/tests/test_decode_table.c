@@ -0,0 +1,214 @@
+/*
+  This file is part of MSP430 Emulator
+
+  MSP430 Emulator is free software: you can redistribute it and/or
+  modify it under the terms of the GNU General Public License as
+  published by the Free Software Foundation, either version 3 of the
+  License, or (at your option) any later version.
+
+  MSP430 Emulator is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with MSP430 Emulator.
+  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+//##########+++ Decode Table Test +++##########
+//# Checks the generated decode_table, for all 64K words,
+//# against the fields that decode_formatI(), _formatII()
+//# and _formatIII() extract and run_constant_generator(),
+//# and runs every valid instruction through decode() to
+//# check its length, timing and format. Some cycle counts
+//# are checked against the family user's guides.
+//#############################################
+
+#include "../decode_table.h"
+#include "../opcodes.h"
+#include "test.h"
+
+#define CODE 0x4400
+
+/* Fields as the reference decoder extracts them */
+static void check_fields(uint16_t word, const decode_entry_t *op) {
+  uint8_t format_id = word >> 12;
+  uint8_t as_flag = (word & 0x0030) >> 4;
+  uint8_t source;
+
+  if (format_id == 0x1) {
+    source = word & 0x000F;
+    CHECK(op->format == 2);
+    CHECK(op->opcode == (word & 0x0380) >> 7);
+    CHECK(op->bw_flag == (word & 0x0040) >> 6);
+    CHECK(op->source == source);
+  } else if (format_id == 0x2 || format_id == 0x3) {
+    int16_t offset = (word & 0x03FF) * 2;
+
+    if (word & (1u << 9)) {
+      offset |= 0xF800;
+    }
+    CHECK(op->format == 3);
+    CHECK(op->opcode == (word & 0x1C00) >> 10);
+    CHECK(op->constant == offset);
+    CHECK(op->length == 1);
+    return;
+  } else if (format_id >= 0x4) {
+    uint8_t destination = word & 0x000F;
+
+    source = (word & 0x0F00) >> 8;
+    CHECK(op->format == 1);
+    CHECK(op->opcode == format_id);
+    CHECK(op->bw_flag == (word & 0x0040) >> 6);
+    CHECK(op->source == source);
+    CHECK(op->destination == destination);
+    if ((word & 0x0080) == 0) {
+      CHECK(op->dst_mode == MODE_REGISTER);
+    } else if (destination == 0) {
+      CHECK(op->dst_mode == MODE_SYMBOLIC);
+    } else if (destination == 2) {
+      CHECK(op->dst_mode == MODE_ABSOLUTE);
+    } else {
+      CHECK(op->dst_mode == MODE_INDEXED);
+    }
+  } else {
+    CHECK(op->format == 0);
+    return;
+  }
+
+  /* Spot CG1 and CG2 Constant generator instructions */
+  if ((source == 2 && as_flag > 1) || source == 3) {
+    CHECK(op->src_mode == MODE_CONSTANT);
+    CHECK(op->constant == run_constant_generator(source, as_flag));
+    return;
+  }
+
+  switch (as_flag) {
+  case 0:
+    CHECK(op->src_mode == MODE_REGISTER);
+    break;
+  case 1:
+    CHECK(op->src_mode == (source == 0   ? MODE_SYMBOLIC
+                           : source == 2 ? MODE_ABSOLUTE
+                                         : MODE_INDEXED));
+    break;
+  case 2:
+    CHECK(op->src_mode == MODE_INDIRECT);
+    break;
+  default:
+    CHECK(op->src_mode == (source == 0 ? MODE_IMMEDIATE : MODE_AUTOINC));
+    break;
+  }
+}
+
+/* Cycle counts from the tables of SLAU144 and SLAU208 */
+static const struct {
+  uint16_t word;
+  uint8_t cycles[CPU_MODELS];
+} datasheet[] = {
+    {0x4405, {1, 1}}, /* MOV R4, R5 */
+    {0x4400, {2, 3}}, /* MOV R4, PC */
+    {0x4485, {4, 3}}, /* MOV R4, X(R5) */
+    {0x5485, {4, 4}}, /* ADD R4, X(R5) */
+    {0x4435, {2, 2}}, /* MOV @R4+, R5 */
+    {0x12B4, {5, 4}}, /* CALL @R4+ */
+    {0x1292, {5, 6}}, /* CALL &EDE */
+    {0x1300, {5, 3}}, /* RETI */
+    {0x3C00, {2, 2}}, /* JMP */
+};
+
+static void check_timing(void) {
+  size_t i;
+  int model;
+
+  for (i = 0; i < sizeof datasheet / sizeof datasheet[0]; i++) {
+    for (model = 0; model < CPU_MODELS; model++) {
+      if (decode_table[datasheet[i].word].cycles[model] !=
+          datasheet[i].cycles[model]) {
+        fprintf(stderr, "%04X: %u cycles on model %d, expected %u\n",
+                datasheet[i].word,
+                decode_table[datasheet[i].word].cycles[model], model,
+                datasheet[i].cycles[model]);
+        failures++;
+      }
+    }
+  }
+}
+
+/* Execute the instruction with the reference decoder. Operands point to
+ * RAM, and extension words are small, so that nothing but the instruction
+ * lands at CODE */
+static void check_execution(test_mcu_t *t, uint16_t word,
+                            const decode_entry_t *op, cpu_model_t model) {
+  Cpu *cpu = &t->mcu->cpu;
+  instruction_t instr;
+  uint16_t sp, i;
+
+  initialize_msp_registers(cpu);
+  cpu->pc = CODE;
+  cpu->sp = sp = 0x3000;
+  cpu->running = true;
+  for (i = 4; i < 16; i++) {
+    cpu->regs[i] = 0x2000;
+  }
+  put_word(t, CODE, word);
+  put_word(t, CODE + 2, 0x0100);
+  put_word(t, CODE + 4, 0x0200);
+  t->cycles = 0;
+
+  decode(cpu, fetch(cpu), NULL, &instr);
+  sync_sr(cpu);
+
+  CHECK(instr.format == op->format);
+  CHECK(t->cycles == op->cycles[model]);
+  CHECK(cpu->running);
+  if (op->format == 3) {
+    CHECK(cpu->pc == CODE + 2 ||
+          cpu->pc == (uint16_t)(CODE + 2 + op->constant));
+  } else if (op->format == 2 && op->opcode == OP_CALL) {
+    /* CALL @SP+ pops the target before pushing */
+    if (op->src_mode == MODE_AUTOINC && op->source == REG_SP) {
+      sp += op->bw_flag ? 1 : 2;
+    }
+    CHECK(cpu->sp == sp - 2);
+    CHECK(get_word(t, cpu->sp) == CODE + 2 * op->length);
+  } else if (op->format == 2 && op->opcode <= OP_SXT &&
+             op->src_mode == MODE_REGISTER && op->source == REG_PC) {
+    return; /* Result written to PC */
+  } else if (!instr.isDestPC) {
+    CHECK(cpu->pc == CODE + 2 * op->length);
+  }
+}
+
+int main(void) {
+  test_mcu_t *t = test_mcu_create();
+  uint32_t word;
+  int model;
+
+  check_timing();
+  for (word = 0; word < 0x10000; word++) {
+    const decode_entry_t *op = &decode_table[word];
+    int before = failures;
+
+    check_fields(word, op);
+    CHECK(op->length == instruction_length(word));
+
+    /* Instructions that may halt the CPU have no handler, see
+     * decode_word.c */
+    for (model = 0; op->handler && model < CPU_MODELS; model++) {
+      set_cpu_model(t->mcu, model);
+      check_execution(t, word, op, model);
+    }
+
+    if (failures > before) {
+      fprintf(stderr, "  in word %04X\n", word);
+      if (failures > 100) {
+        break;
+      }
+    }
+  }
+
+  test_mcu_destroy(t);
+  return test_result("test_decode_table");
+}
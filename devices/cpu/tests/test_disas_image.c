@@ -0,0 +1,133 @@
+/*
+  This file is part of MSP430 Emulator
+
+  MSP430 Emulator is free software: you can redistribute it and/or
+  modify it under the terms of the GNU General Public License as
+  published by the Free Software Foundation, either version 3 of the
+  License, or (at your option) any later version.
+
+  MSP430 Emulator is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with MSP430 Emulator.
+  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+//##########+++ Bulk Image Disassembler Test +++##########
+//# Disassembles random images, which end in the middle
+//# of an instruction, on one thread and on several, and
+//# checks that the output is the same.
+//#######################################################
+
+#include "../disas_image.h"
+#include "test.h"
+#include <string.h>
+
+#define BASE 0x1000
+#define MAX_OUTPUT (4 << 20)
+
+static const unsigned thread_counts[] = {2, 3, 7, 0};
+
+/* The output of disassemble_image(), in a static buffer */
+static char *disassemble_to(char *buffer, const uint8_t *image, size_t len,
+                            disas_format_t format, unsigned threads,
+                            long *count) {
+  FILE *file = tmpfile();
+  size_t read;
+
+  CHECK(file != NULL);
+  *count = disassemble_image(image, len, BASE, format, threads, file);
+  rewind(file);
+  read = fread(buffer, 1, MAX_OUTPUT - 1, file);
+  buffer[read] = '\0';
+  fclose(file);
+  return buffer;
+}
+
+/* Random words, then single-word instructions and one of three words that
+ * the image cuts off after two */
+static void make_image(uint8_t *image, size_t len, uint32_t seed) {
+  uint32_t rng = seed * 7919 + 1;
+  size_t words = len / 2, i;
+
+  for (i = 0; i < len; i++) {
+    rng = rng * 1103515245 + 12345;
+    image[i] = rng >> 16;
+  }
+  for (i = words - 10; i < words - 2; i++) {
+    image[2 * i] = 0x03; /* NOP */
+    image[2 * i + 1] = 0x43;
+  }
+  image[2 * (words - 2)] = 0xB2; /* MOV #N, &ADDR */
+  image[2 * (words - 2) + 1] = 0x40;
+}
+
+/* The last lines of the text output, and the count of the others */
+static void check_tail(const char *text, size_t len, long count) {
+  const size_t words = len / 2;
+  char expected[3][32];
+  const char *line = text;
+  long lines = 0;
+  int tail = len & 1 ? 3 : 2;
+  int i;
+
+  for (i = 0; i < 2; i++) {
+    sprintf(expected[i], "%04zX: ", BASE + 2 * (words - 2 + i));
+  }
+  sprintf(expected[2], "%04zX: ", BASE + len - 1);
+
+  for (; *line; line = strchr(line, '\n') + 1, lines++) {
+    if (lines >= count) {
+      i = lines - count;
+      CHECK(i < tail && strncmp(line, expected[i], 6) == 0);
+      CHECK(strstr(line, i < 2 ? ".word 0x" : ".byte 0x") != NULL);
+    }
+  }
+  CHECK(lines == count + tail);
+}
+
+static void test_threads(void) {
+  static const size_t lengths[] = {0xF000 - 1, 0xF000, 0x6000 + 5, 0x20};
+  static uint8_t image[0x10000];
+  static char one[MAX_OUTPUT], many[MAX_OUTPUT];
+  disas_format_t format;
+  long count, other;
+  size_t l, i;
+
+  for (l = 0; l < sizeof lengths / sizeof lengths[0]; l++) {
+    make_image(image, lengths[l], l);
+    for (format = DISAS_TEXT; format <= DISAS_JSON; format++) {
+      disassemble_to(one, image, lengths[l], format, 1, &count);
+      CHECK(count > 0);
+      if (format == DISAS_TEXT) {
+        check_tail(one, lengths[l], count);
+      } else {
+        CHECK(strncmp(one, "{\"address\":\"0x1000\",", 20) == 0);
+        CHECK(strstr(one, "\"text\":\".word 0x40B2\"}\n") != NULL);
+      }
+
+      for (i = 0; i < sizeof thread_counts / sizeof thread_counts[0]; i++) {
+        disassemble_to(many, image, lengths[l], format, thread_counts[i],
+                       &other);
+        if (other != count || strcmp(one, many) != 0) {
+          fprintf(stderr, "length 0x%zX, format %d, %u threads\n", lengths[l],
+                  format, thread_counts[i]);
+          CHECK(false);
+        }
+      }
+    }
+  }
+
+  /* Too long for the address space */
+  CHECK(disassemble_image(image, 0x10000 - BASE + 1, BASE, DISAS_TEXT, 1,
+                          stdout) == -1);
+}
+
+int main(void) {
+  test_threads();
+  return test_result("test_disas_image");
+}
@@ -0,0 +1,307 @@
+/*
+  This file is part of MSP430 Emulator
+
+  MSP430 Emulator is free software: you can redistribute it and/or
+  modify it under the terms of the GNU General Public License as
+  published by the Free Software Foundation, either version 3 of the
+  License, or (at your option) any later version.
+
+  MSP430 Emulator is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with MSP430 Emulator.
+  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+//##########+++ Engine Equivalence Test +++##########
+//# Runs random programs on every engine and checks that
+//# each ends in the same state as ENGINE_REFERENCE:
+//# registers, memory, cycles, register notifications and
+//# the number of instructions run. Most of the address
+//# space is host memory, some of it read-only, so that
+//# both the JIT's inline accesses and its calls into
+//# mem_read() and mem_write() run. A fixed program of
+//# flag chains checks the status register closely; the
+//# test is also built with the other MSP430_LAZY_FLAGS
+//# setting.
+//##################################################
+
+#include "test.h"
+#include <string.h>
+
+#define SEEDS 200
+#define STEPS 4000
+#define SLICES 8
+
+static const engine_t engines[] = {ENGINE_PREDECODE, ENGINE_THREADED,
+                                   ENGINE_BLOCK, ENGINE_JIT};
+
+#define ENGINES (sizeof engines / sizeof engines[0])
+
+/* State of an MCU after a run */
+typedef struct outcome {
+  uint16_t regs[16];
+  uint32_t executed;
+  uint64_t cycles, reads, writes;
+  uint8_t mem[0x10000];
+} outcome_t;
+
+static uint64_t register_reads, register_writes;
+static uint32_t rng;
+
+static void count_reads(void *user, uint16_t count) {
+  register_reads += count;
+}
+
+static void count_writes(void *user, uint16_t count) {
+  register_writes += count;
+}
+
+static uint16_t random16(void) {
+  rng = rng * 1103515245u + 12345u;
+  return rng >> 8;
+}
+
+static void store_word(uint8_t *mem, uint16_t address, uint16_t word) {
+  mem[address] = word;
+  mem[(uint16_t)(address + 1)] = word >> 8;
+}
+
+/* Random memory in which every word decodes as an MSP430 instruction other
+ * than DADD and RETI, with loops planted so that blocks get hot */
+static void make_program(uint8_t *mem) {
+  uint32_t i;
+
+  for (i = 0; i < 0x10000; i++) {
+    mem[i] = random16();
+  }
+  for (i = 1; i < 0x10000; i += 2) {
+    while ((mem[i] >> 4) == 0 || (mem[i] >> 4) == 0xA ||
+           (mem[i] & 0xF3) == 0x13) {
+      mem[i] = random16();
+    }
+  }
+
+  for (i = 0; i < 3000; i++) {
+    uint16_t address = random16() & 0xFFFE;
+    uint16_t reg = 4 + random16() % 12, reg2 = 4 + random16() % 12;
+
+    switch (random16() % 3) {
+    case 0: /* ADD, SUB, CMP or BIT, then a jump back or ahead */
+      store_word(mem, address,
+                      (0x5000 + 0x3000 * (random16() % 3)) | reg2 << 8 |
+                          (random16() & 0x40) | reg);
+      store_word(mem, address + 2,
+                      0x2000 | (random16() % 7) << 10 |
+                          ((random16() % 4) ? random16() & 0x3FF : 0x3FE));
+      break;
+    case 1: /* MOV @Rn+, X(Rm) ; ADD #2, Rm ; CMP Rn, Rm ; JNE back */
+      store_word(mem, address, 0x40B0 | reg2 << 8 | reg);
+      store_word(mem, address + 2, random16() & 0x1FF);
+      store_word(mem, address + 4, 0x5320 | reg);
+      store_word(mem, address + 6, 0x9000 | reg2 << 8 | reg);
+      store_word(mem, address + 8, 0x23F8);
+      break;
+    default: /* SUB #1, Rn ; JNZ $-2 */
+      store_word(mem, address, 0x8310 | reg);
+      store_word(mem, address + 2, 0x23FE);
+      break;
+    }
+  }
+}
+
+static void run_engine(test_mcu_t *t, engine_t engine, const uint8_t *program,
+                       const Cpu *start, outcome_t *out) {
+  Cpu *cpu = &t->mcu->cpu;
+  int i;
+
+  memcpy(t->mem, program, sizeof t->mem);
+  flush_decoded_ops(t->mcu);
+  *cpu = *start;
+  set_engine(t->mcu, engine);
+  t->cycles = register_reads = register_writes = 0;
+
+  out->executed = 0;
+  for (i = 0; i < SLICES; i++) {
+    out->executed += run_instructions(cpu, STEPS / SLICES);
+  }
+  memcpy(out->regs, cpu->regs, sizeof out->regs);
+  out->cycles = t->cycles;
+  out->reads = register_reads;
+  out->writes = register_writes;
+  memcpy(out->mem, t->mem, sizeof out->mem);
+}
+
+static bool same_outcome(const outcome_t *a, const outcome_t *b) {
+  return memcmp(a->regs, b->regs, sizeof a->regs) == 0 &&
+         a->executed == b->executed && a->cycles == b->cycles &&
+         a->reads == b->reads && a->writes == b->writes &&
+         memcmp(a->mem, b->mem, sizeof a->mem) == 0;
+}
+
+/* Run a program from start on every engine, compared with the reference.
+ * Returns the outcome of the reference */
+static const outcome_t *compare_engines(test_mcu_t *t, const uint8_t *program,
+                            const Cpu *start, const char *name,
+                            uint32_t seed) {
+  static outcome_t ref, got;
+  size_t e;
+
+  run_engine(t, ENGINE_REFERENCE, program, start, &ref);
+  for (e = 0; e < ENGINES; e++) {
+    run_engine(t, engines[e], program, start, &got);
+    if (!same_outcome(&ref, &got)) {
+      fprintf(stderr, "%s %u: engine %d differs from the reference\n", name,
+              seed, engines[e]);
+    }
+    CHECK(same_outcome(&ref, &got));
+  }
+  return &ref;
+}
+
+static void test_random_programs(test_mcu_t *t, uint8_t *program) {
+  uint32_t seed;
+
+  for (seed = 0; seed < SEEDS; seed++) {
+    Cpu start = t->mcu->cpu;
+    int i;
+
+    rng = seed * 7919 + 1;
+    make_program(program);
+    initialize_msp_registers(&start);
+    start.pc = random16() & 0xFFFE;
+    start.sp = random16() & 0xFFFE;
+    start.sr = random16() & (SR_C | SR_Z | SR_N | SR_GIE | SR_V);
+    for (i = 4; i < 16; i++) {
+      start.regs[i] = random16() % 64;
+    }
+    compare_engines(t, program, &start, "seed", seed);
+  }
+}
+
+/* Carry chains, jumps right after the instruction that sets their flag and
+ * SR pushed to memory, which MSP430_LAZY_FLAGS has to evaluate exactly. The
+ * engines are compared with the reference, and the reference with the end
+ * states of an eager build, since a flag bug would be shared by all */
+static void test_flag_chains(test_mcu_t *t, uint8_t *program) {
+  static const uint16_t code[] = {
+      0x6504,         /* ADDC R5, R4 */
+      0x6706,         /* ADDC R7, R6 */
+      0x7908,         /* SUBC R9, R8 */
+      0x7B4A,         /* SUBC.B R11, R10 */
+      0x2C01,         /* JC $+4 */
+      0x540C,         /* ADD R4, R12 */
+      0x1202,         /* PUSH SR */
+      0x413D,         /* POP R13 */
+      0xED0E,         /* XOR R13, R14 */
+      0x3001,         /* JN $+4 */
+      0x100F,         /* RRC R15 */
+      0x7307,         /* SBC R7 */
+      0x6306,         /* ADC R6 */
+      0x3801,         /* JL $+4 */
+      0x6707,         /* RLC R7 */
+      0x644F,         /* ADDC.B R4, R15 */
+      0x8C49,         /* SUB.B R12, R9 */
+      0x3401,         /* JGE $+4 */
+      0x1108,         /* RRA R8 */
+      0x5035, 0x1234, /* ADD #0x1234, R5 */
+      0x9406,         /* CMP R4, R6 */
+      0x2401,         /* JEQ $+4 */
+      0x6C0B,         /* ADDC R12, R11 */
+      0x890C,         /* SUB R9, R12 */
+      0x2801,         /* JNC $+4 */
+      0x5A0E,         /* ADD R10, R14 */
+      0x507A, 0x0081, /* ADD.B #0x81, R10 */
+      0x2C01,         /* JC $+4 */
+      0x6405,         /* ADDC R4, R5 */
+      0x9504,         /* CMP R5, R4 */
+      0x3801,         /* JL $+4 */
+      0x7C0F,         /* SUBC R12, R15 */
+      0xB03E, 0x0010, /* BIT #0x10, R14 */
+      0x2001,         /* JNZ $+4 */
+      0x8F0E,         /* SUB R15, R14 */
+      0x1202,         /* PUSH SR */
+      0x413B,         /* POP R11 */
+      0x3FD7,         /* JMP back to the start */
+  };
+  /* R4-R15 and SR at the end of the first seeds, from a build without
+   * MSP430_LAZY_FLAGS */
+  static const uint16_t expected[][13] = {
+      {0x1947, 0x6C6D, 0xD26F, 0xBFD1, 0xFF3B, 0x00B6, 0x0061, 0xC141, 0xC089,
+       0x0001, 0x0930, 0x005E, 0x0005},
+      {0xF605, 0x8AAB, 0x6C0B, 0x4000, 0xFBE2, 0x0070, 0xFF21, 0x0001, 0xD269,
+       0x0005, 0x9BF8, 0x2DD0, 0x0000},
+      {0x43C4, 0xE783, 0x4AD3, 0x0000, 0xFE79, 0x00C2, 0x00E3, 0x7C81, 0x7BBD,
+       0x0005, 0xFA55, 0x00CC, 0x0004},
+      {0x264C, 0xBE6E, 0x5EB7, 0x80AA, 0xFDA3, 0x0060, 0xFFA0, 0xA3C3, 0xA361,
+       0x0001, 0x22BB, 0x0088, 0x0004},
+      {0xDF23, 0xF997, 0x1A2B, 0x0000, 0xFDFE, 0x00DD, 0x0085, 0x0005, 0xF989,
+       0x0001, 0xD912, 0x0071, 0x0005},
+      {0x5778, 0x6470, 0xB5BC, 0xFE5B, 0xFEFC, 0x0090, 0x00E0, 0x0001, 0x9074,
+       0x0005, 0x24FB, 0x00CF, 0x0000},
+      {0xCAC1, 0x3059, 0x6321, 0x0000, 0xFE73, 0x005D, 0xFF7F, 0x60BC, 0x605E,
+       0x0005, 0xD895, 0x006C, 0x0001},
+      {0x3AAB, 0xFF99, 0x6F51, 0x0000, 0xFE8B, 0x000B, 0xFF63, 0xCC0F, 0xCC02,
+       0x0005, 0x9914, 0x3428, 0x0001},
+  };
+  const outcome_t *ref;
+  uint32_t seed;
+  size_t i;
+
+  memset(program, 0, 0x10000);
+  for (i = 0; i < sizeof code / sizeof code[0]; i++) {
+    store_word(program, 0x4400 + 2 * i, code[i]);
+  }
+
+  for (seed = 0; seed < 64; seed++) {
+    Cpu start = t->mcu->cpu;
+
+    rng = seed * 7919 + 1;
+    initialize_msp_registers(&start);
+    start.pc = 0x4400;
+    start.sp = 0x3000;
+    start.sr = random16() & (SR_C | SR_Z | SR_N | SR_V);
+    for (i = 4; i < 16; i++) {
+      start.regs[i] = random16();
+    }
+    ref = compare_engines(t, program, &start, "flags", seed);
+    if (seed < sizeof expected / sizeof expected[0]) {
+      for (i = 4; i < 16; i++) {
+        CHECK(ref->regs[i] == expected[seed][i - 4]);
+      }
+      CHECK(ref->regs[REG_SR] == expected[seed][12]);
+    }
+  }
+}
+
+int main(void) {
+  test_mcu_t *t = test_mcu_create();
+  uint8_t *program = malloc(0x10000);
+  uint32_t page;
+
+  if (program == NULL) {
+    fprintf(stderr, "out of memory\n");
+    return 1;
+  }
+  set_register_read_notify_cb(t->mcu, count_reads);
+  set_register_write_notify_cb(t->mcu, count_writes);
+
+  /* Pages of t->mem: read-only, writable, writable, left to the callbacks */
+  for (page = 0; page < 0x10000; page += MEM_PAGE_SIZE) {
+    if ((page / MEM_PAGE_SIZE) % 4 != 3) {
+      map_host_memory(&t->mcu->bus, page, t->mem + page, MEM_PAGE_SIZE,
+                      (page / MEM_PAGE_SIZE) % 4 != 0);
+    }
+  }
+
+  test_random_programs(t, program);
+  test_flag_chains(t, program);
+
+  free(program);
+  test_mcu_destroy(t);
+  return test_result("test_engines");
+}
@@ -0,0 +1,250 @@
+/*
+  This file is part of MSP430 Emulator
+
+  MSP430 Emulator is free software: you can redistribute it and/or
+  modify it under the terms of the GNU General Public License as
+  published by the Free Software Foundation, either version 3 of the
+  License, or (at your option) any later version.
+
+  MSP430 Emulator is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with MSP430 Emulator.
+  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+//##########+++ Firmware Loader Test +++##########
+//# Loads images written to temporary files: reloading an
+//# MCU under every engine, images that reach beyond the
+//# address space, and ELF files whose whole pages are
+//# mapped from the file.
+//################################################
+
+#include "../firmware.h"
+#include "test.h"
+#include <elf.h>
+#include <stddef.h>
+#include <unistd.h>
+
+/* Write an image to a temporary file, whose path is returned in path */
+static void write_image(char *path, const void *data, size_t len) {
+  int fd;
+
+  strcpy(path, "/tmp/test_firmware_XXXXXX");
+  fd = mkstemp(path);
+  if (fd < 0 || write(fd, data, len) != (ssize_t)len) {
+    fprintf(stderr, "Cannot write %s\n", path);
+    exit(1);
+  }
+  close(fd);
+}
+
+static bool load_file(test_mcu_t *t, const void *data, size_t len,
+                      firmware_t *fw) {
+  char path[32];
+  bool ok;
+
+  write_image(path, data, len);
+  ok = load_firmware(path, FIRMWARE_AUTO, &t->mcu->cpu, fw);
+  unlink(path);
+  return ok;
+}
+
+static bool load_image(test_mcu_t *t, const char *text, firmware_t *fw) {
+  return load_file(t, text, strlen(text), fw);
+}
+
+/* MOV #value, R4 ; JMP $ at 0x4480, in the middle of four lines of
+ * erased flash, and the reset vector */
+static void image(char *text, uint16_t value) {
+  int i;
+
+  text += sprintf(text, "@4400\n");
+  for (i = 0; i < 0x100; i++) {
+    text += sprintf(text, "FF%c", i % 16 == 15 ? '\n' : ' ');
+  }
+  sprintf(text, "@4480\n34 40 %02X %02X FF 3F\n@FFFE\n80 44\nq\n",
+          value & 0xFF, value >> 8);
+}
+
+/* A second image loaded into the same MCU replaces the code it runs */
+static void test_reload(test_mcu_t *t) {
+  firmware_t first, second;
+  char first_text[1024], second_text[1024];
+  engine_t engine;
+  int i;
+
+  image(first_text, 0x1111);
+  image(second_text, 0x2222);
+
+  for (engine = ENGINE_REFERENCE; engine <= ENGINE_JIT; engine++) {
+    set_engine(t->mcu, engine);
+    CHECK(load_image(t, first_text, &first));
+    for (i = 0; i < 100; i++) {
+      t->mcu->cpu.pc = 0x4480;
+      run_instructions(&t->mcu->cpu, 2);
+    }
+    CHECK(t->mcu->cpu.r4 == 0x1111);
+
+    CHECK(load_image(t, second_text, &second));
+    CHECK(t->mcu->cpu.pc == 0x4480);
+    run_instructions(&t->mcu->cpu, 2);
+    CHECK(t->mcu->cpu.r4 == 0x2222);
+
+    unload_firmware(&second);
+    unload_firmware(&first);
+  }
+}
+
+/* Data whose end address overflows 32 bits is rejected, not dropped */
+static void test_overflow(test_mcu_t *t) {
+  firmware_t fw;
+
+  CHECK(!load_image(t,
+                    ":02FFFE000044BD\n"
+                    ":02000004FFFFFC\n"
+                    ":10FFF0003F3F3F3F3F3F3F3F3F3F3F3F3F3F3F3F11\n"
+                    ":00000001FF\n",
+                    &fw));
+  CHECK(load_image(t, ":02FFFE000044BD\n:00000001FF\n", &fw));
+  unload_firmware(&fw);
+}
+
+/* ELF fields are little-endian */
+static void put_field(uint8_t *p, size_t size, uint32_t value) {
+  size_t i;
+
+  for (i = 0; i < size; i++) {
+    p[i] = value >> (8 * i);
+  }
+}
+
+#define SET_EHDR(elf, field, value)                                            \
+  put_field((elf) + offsetof(Elf32_Ehdr, field),                               \
+            sizeof(((Elf32_Ehdr *)0)->field), value)
+#define SET_PHDR(elf, i, field, value)                                         \
+  put_field((elf) + sizeof(Elf32_Ehdr) + (i) * sizeof(Elf32_Phdr) +             \
+                offsetof(Elf32_Phdr, field),                                   \
+            sizeof(((Elf32_Phdr *)0)->field), value)
+
+/* Code at 0x4400, two pages and 16 bytes from offset CODE_OFFSET */
+#define CODE_OFFSET 0xC4
+#define CODE_LEN (2 * MEM_PAGE_SIZE + 16)
+#define VECTOR_OFFSET (CODE_OFFSET + CODE_LEN)
+#define ELF_LEN (VECTOR_OFFSET + 2)
+
+/* An ELF executable: the code segment, loaded at a physical address other
+ * than its virtual one, the reset vector unless vector is false, and a note
+ * that is not loaded */
+static void make_elf(uint8_t *elf, bool vector) {
+  size_t i;
+
+  memset(elf, 0, ELF_LEN);
+  memcpy(elf, ELFMAG, SELFMAG);
+  elf[EI_CLASS] = ELFCLASS32;
+  elf[EI_DATA] = ELFDATA2LSB;
+  elf[EI_VERSION] = EV_CURRENT;
+  SET_EHDR(elf, e_type, ET_EXEC);
+  SET_EHDR(elf, e_machine, EM_MSP430);
+  SET_EHDR(elf, e_entry, 0x4404);
+  SET_EHDR(elf, e_phoff, sizeof(Elf32_Ehdr));
+  SET_EHDR(elf, e_ehsize, sizeof(Elf32_Ehdr));
+  SET_EHDR(elf, e_phentsize, sizeof(Elf32_Phdr));
+  SET_EHDR(elf, e_phnum, 3);
+
+  SET_PHDR(elf, 0, p_type, PT_LOAD);
+  SET_PHDR(elf, 0, p_offset, CODE_OFFSET);
+  SET_PHDR(elf, 0, p_vaddr, 0xC400);
+  SET_PHDR(elf, 0, p_paddr, 0x4400);
+  SET_PHDR(elf, 0, p_filesz, CODE_LEN);
+  SET_PHDR(elf, 0, p_memsz, CODE_LEN);
+
+  SET_PHDR(elf, 1, p_type, vector ? PT_LOAD : PT_NULL);
+  SET_PHDR(elf, 1, p_offset, VECTOR_OFFSET);
+  SET_PHDR(elf, 1, p_paddr, 0xFFFE);
+  SET_PHDR(elf, 1, p_filesz, 2);
+
+  SET_PHDR(elf, 2, p_type, PT_NOTE);
+  SET_PHDR(elf, 2, p_offset, 0x100000);
+  SET_PHDR(elf, 2, p_filesz, 0x100);
+
+  for (i = 0; i < CODE_LEN; i++) {
+    elf[CODE_OFFSET + i] = i;
+  }
+  put_field(elf + CODE_OFFSET, 2, 0x4034); /* MOV #0x1234, R4 */
+  put_field(elf + CODE_OFFSET + 2, 2, 0x1234);
+  put_field(elf + CODE_OFFSET + 4, 2, 0x3FFF); /* JMP $ */
+  put_field(elf + VECTOR_OFFSET, 2, 0x4400);
+}
+
+/* Whole pages of a segment are the file itself, the rest is copied */
+static void test_elf(test_mcu_t *t) {
+  const uint16_t code_page = 0x4400 >> MEM_PAGE_SHIFT;
+  const uint16_t tail_page = code_page + 2;
+  const uint16_t vector_page = 0xFFFE >> MEM_PAGE_SHIFT;
+  uint8_t elf[ELF_LEN];
+  bus_t *bus = &t->mcu->bus;
+  firmware_t fw;
+  uint16_t i;
+
+  make_elf(elf, true);
+  CHECK(load_file(t, elf, sizeof elf, &fw));
+  CHECK(bus->read_pages[code_page] == (uint8_t *)fw.file + CODE_OFFSET);
+  CHECK(bus->read_pages[code_page + 1] ==
+        (uint8_t *)fw.file + CODE_OFFSET + MEM_PAGE_SIZE);
+  CHECK(bus->write_pages[code_page] == NULL);
+
+  /* The partial pages, with erased flash around the data */
+  CHECK(fw.image != NULL);
+  CHECK(bus->read_pages[tail_page] ==
+        fw.image + (tail_page << MEM_PAGE_SHIFT));
+  CHECK(bus->read_pages[vector_page] ==
+        fw.image + (vector_page << MEM_PAGE_SHIFT));
+  for (i = 0; i < MEM_PAGE_SIZE; i++) {
+    CHECK(mem_read(bus, (tail_page << MEM_PAGE_SHIFT) + i, BYTE) ==
+          (i < 16 ? 2 * MEM_PAGE_SIZE + i : 0xFF));
+  }
+  CHECK(mem_read(bus, 0xFFFC, WORD) == 0xFFFF);
+
+  /* PC from the reset vector, not the entry point */
+  CHECK(t->mcu->cpu.pc == 0x4400);
+  run_instructions(&t->mcu->cpu, 1);
+  CHECK(t->mcu->cpu.r4 == 0x1234);
+  unload_firmware(&fw);
+  CHECK(bus->read_pages[code_page] == NULL);
+
+  make_elf(elf, false);
+  CHECK(load_file(t, elf, sizeof elf, &fw));
+  CHECK(t->mcu->cpu.pc == 0x4404);
+  CHECK(bus->read_pages[vector_page] == NULL);
+  unload_firmware(&fw);
+
+  /* Malformed program headers */
+  make_elf(elf, true);
+  SET_EHDR(elf, e_phoff, sizeof elf - sizeof(Elf32_Phdr));
+  CHECK(!load_file(t, elf, sizeof elf, &fw));
+  make_elf(elf, true);
+  SET_EHDR(elf, e_phentsize, sizeof(Elf32_Phdr) - 1);
+  CHECK(!load_file(t, elf, sizeof elf, &fw));
+  make_elf(elf, true);
+  SET_PHDR(elf, 0, p_filesz, sizeof elf - CODE_OFFSET + 1);
+  CHECK(!load_file(t, elf, sizeof elf, &fw));
+  make_elf(elf, true);
+  SET_PHDR(elf, 0, p_offset, 0xFFFFFFF0);
+  CHECK(!load_file(t, elf, sizeof elf, &fw));
+  CHECK(bus->read_pages[code_page] == NULL);
+}
+
+int main(void) {
+  test_mcu_t *t = test_mcu_create();
+
+  test_reload(t);
+  test_overflow(t);
+  test_elf(t);
+
+  test_mcu_destroy(t);
+  return test_result("test_firmware");
+}
@@ -0,0 +1,100 @@
+/*
+  This file is part of MSP430 Emulator
+
+  MSP430 Emulator is free software: you can redistribute it and/or
+  modify it under the terms of the GNU General Public License as
+  published by the Free Software Foundation, either version 3 of the
+  License, or (at your option) any later version.
+
+  MSP430 Emulator is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with MSP430 Emulator.
+  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+//##########+++ Superinstruction Test +++##########
+//# Runs a loop holding every kind of fused pair on every
+//# engine and checks how often each kind is counted: once
+//# per turn with ENGINE_BLOCK and ENGINE_JIT, never with
+//# the others, or without MSP430_FUSION.
+//################################################
+
+#include "../fusion.h"
+#include "test.h"
+
+#define CODE 0x4400
+#define TURNS 100
+
+static const uint16_t program[] = {
+    0x4034, TURNS,  /* MOV #TURNS, R4 */
+    0x4035, 0x2000, /* MOV #0x2000, R5 */
+    0x4036, 0x2400, /* MOV #0x2400, R6 */
+    0x45B6, 0x0000, /* loop: MOV @R5+, 0(R6) */
+    0x5326,         /* ADD #2, R6 */
+    0x9034, 0x0032, /* CMP #50, R4 */
+    0x2801,         /* JLO low */
+    0x5317,         /* ADD #1, R7 */
+    0xB314,         /* low: BIT #1, R4 */
+    0x2401,         /* JZ even */
+    0x5318,         /* ADD #1, R8 */
+    0x5409,         /* even: ADD R4, R9 */
+    0x2800,         /* JNC $+2 */
+    0x8314,         /* SUB #1, R4 */
+    0x23F2,         /* JNZ loop */
+    0xD032, 0x0010, /* BIS #CPUOFF, SR */
+};
+
+#define PROGRAM_WORDS (sizeof program / sizeof program[0])
+
+static void test_fusion_stats(test_mcu_t *t) {
+  Cpu *cpu = &t->mcu->cpu;
+  engine_t engine;
+  size_t i;
+
+  for (engine = ENGINE_REFERENCE; engine <= ENGINE_JIT; engine++) {
+    for (i = 0; i < PROGRAM_WORDS; i++) {
+      put_word(t, CODE + 2 * i, program[i]);
+    }
+    set_engine(t->mcu, engine);
+    flush_decoded_ops(t->mcu);
+    flush_blocks(t->mcu);
+    initialize_msp_registers(cpu);
+    cpu->pc = CODE;
+    cpu->sp = 0x3000;
+    reset_fusion_stats(t->mcu);
+
+    /* In one go, as a fused pair is not run as one across a budget */
+    run_instructions(cpu, 100000);
+    CHECK(cpu->sr & SR_CPU_OFF);
+    CHECK(cpu->r7 == 51 && cpu->r8 == TURNS / 2);
+
+    for (i = 0; i < FUSION_KINDS; i++) {
+#ifdef MSP430_FUSION
+      uint64_t expected =
+          engine == ENGINE_BLOCK || engine == ENGINE_JIT ? TURNS : 0;
+#else
+      uint64_t expected = 0;
+#endif
+
+      if (t->mcu->stats.fusions[i] != expected) {
+        fprintf(stderr, "engine %d: kind %zu fired %llu times\n", engine, i,
+                (unsigned long long)t->mcu->stats.fusions[i]);
+        CHECK(false);
+      }
+    }
+  }
+}
+
+int main(void) {
+  test_mcu_t *t = test_mcu_create();
+
+  test_fusion_stats(t);
+
+  test_mcu_destroy(t);
+  return test_result("test_fusion");
+}
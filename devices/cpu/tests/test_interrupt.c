@@ -0,0 +1,268 @@
+/*
+  This file is part of MSP430 Emulator
+
+  MSP430 Emulator is free software: you can redistribute it and/or
+  modify it under the terms of the GNU General Public License as
+  published by the Free Software Foundation, either version 3 of the
+  License, or (at your option) any later version.
+
+  MSP430 Emulator is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with MSP430 Emulator.
+  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+//##########+++ Interrupt Controller Test +++##########
+//# Accepts interrupts directly and through the engines:
+//# priorities, non-maskable lines, the pushed frame, the
+//# SR left to the handler, and waking from a low-power
+//# mode that RETI restores.
+//####################################################
+
+#include "../interrupt.h"
+#include "test.h"
+
+#define CODE 0x4400
+#define HANDLER 0x5000
+#define STACK 0x3000
+
+/* Lines seen by the accept callback, in order */
+static uint8_t accepted[INTERRUPT_LINES];
+static size_t accepted_count;
+
+static void record_accepted(void *user, uint8_t line) {
+  if (accepted_count < INTERRUPT_LINES) {
+    accepted[accepted_count] = line;
+  }
+  accepted_count++;
+  deassert_interrupt(((test_mcu_t *)user)->mcu, line);
+}
+
+static void load(test_mcu_t *t, uint16_t address, const uint16_t *words,
+                 size_t count) {
+  size_t i;
+
+  for (i = 0; i < count; i++) {
+    put_word(t, address + 2 * i, words[i]);
+  }
+  flush_decoded_ops(t->mcu);
+  flush_blocks(t->mcu);
+}
+
+/* Line n is vectored to HANDLER + 0x10 * n */
+static void reset(test_mcu_t *t, engine_t engine) {
+  Cpu *cpu = &t->mcu->cpu;
+  uint8_t line;
+
+  for (line = 0; line < INTERRUPT_LINES; line++) {
+    put_word(t, INTERRUPT_VECTORS + 2 * line, HANDLER + 0x10 * line);
+  }
+  initialize_msp_registers(cpu);
+  cpu->pc = CODE;
+  cpu->sp = STACK;
+  set_engine(t->mcu, engine);
+  t->mcu->interrupt_requests = 0;
+  t->mcu->stats.interrupts = 0;
+  t->cycles = 0;
+  accepted_count = 0;
+}
+
+/* The highest asserted line is taken first, and none while SR_GIE is clear */
+static void test_priority(test_mcu_t *t) {
+  static const uint8_t lines[] = {2, 9, 0, 5};
+  static const uint8_t order[] = {9, 5, 2, 0};
+  Cpu *cpu = &t->mcu->cpu;
+  size_t i;
+
+  reset(t, ENGINE_REFERENCE);
+  for (i = 0; i < sizeof lines; i++) {
+    assert_interrupt(t->mcu, lines[i]);
+  }
+  CHECK(!interrupt_ready(cpu));
+  CHECK(!accept_interrupt(cpu));
+  CHECK(cpu->sp == STACK && cpu->pc == CODE && t->cycles == 0);
+  CHECK(accepted_count == 0 && t->mcu->stats.interrupts == 0);
+
+  for (i = 0; i < sizeof order; i++) {
+    cpu->sr = SR_GIE;
+    CHECK(interrupt_ready(cpu));
+    CHECK(accept_interrupt(cpu));
+    CHECK(cpu->pc == HANDLER + 0x10 * order[i]);
+    CHECK(accepted_count == i + 1 && accepted[i] == order[i]);
+    CHECK(t->mcu->stats.interrupts == i + 1);
+    CHECK(t->cycles == (i + 1) * INTERRUPT_ENTRY_CYCLES);
+  }
+  cpu->sr = SR_GIE;
+  CHECK(!interrupt_ready(cpu) && !accept_interrupt(cpu));
+  CHECK(cpu->sp == STACK - 4 * sizeof order);
+}
+
+/* INTERRUPT_NMI is taken while SR_GIE is clear, and outranks the others
+ * even when they could be taken; which lines ignore SR_GIE can be changed */
+static void test_nmi(test_mcu_t *t) {
+  Cpu *cpu = &t->mcu->cpu;
+
+  reset(t, ENGINE_REFERENCE);
+  assert_interrupt(t->mcu, 13);
+  assert_interrupt(t->mcu, INTERRUPT_NMI);
+  CHECK(accept_interrupt(cpu));
+  CHECK(cpu->pc == HANDLER + 0x10 * INTERRUPT_NMI);
+  CHECK(accepted_count == 1 && accepted[0] == INTERRUPT_NMI);
+  CHECK(!accept_interrupt(cpu));
+
+  cpu->sr = SR_GIE;
+  assert_interrupt(t->mcu, INTERRUPT_NMI);
+  CHECK(accept_interrupt(cpu) && accepted[1] == INTERRUPT_NMI);
+  cpu->sr = SR_GIE;
+  CHECK(accept_interrupt(cpu) && accepted[2] == 13);
+
+  set_nonmaskable_interrupts(t->mcu, 1u << 3);
+  assert_interrupt(t->mcu, INTERRUPT_NMI);
+  assert_interrupt(t->mcu, 3);
+  CHECK(accept_interrupt(cpu) && accepted[3] == 3);
+  CHECK(!accept_interrupt(cpu));
+  CHECK(t->mcu->stats.interrupts == 4);
+  set_nonmaskable_interrupts(t->mcu, 1u << INTERRUPT_NMI);
+}
+
+/* SR then PC on the stack, and SR cleared but for SR_SCG0 */
+static void test_frame(test_mcu_t *t) {
+  static const uint16_t others[] = {0, SR_SCG0, SR_SCG1 | SR_OSC_OFF,
+                                    SR_CPU_OFF | SR_SCG0 | SR_SCG1};
+  Cpu *cpu = &t->mcu->cpu;
+  uint16_t sr;
+  size_t i;
+
+  for (i = 0; i < sizeof others / sizeof others[0]; i++) {
+    reset(t, ENGINE_REFERENCE);
+    sr = SR_GIE | SR_C | SR_N | SR_V | others[i];
+    cpu->sr = sr;
+    cpu->pc = 0x1234;
+    put_word(t, STACK - 6, 0xAAAA);
+    assert_interrupt(t->mcu, 7);
+    CHECK(accept_interrupt(cpu));
+    CHECK(cpu->sp == STACK - 4);
+    CHECK(get_word(t, STACK - 4) == sr && get_word(t, STACK - 2) == 0x1234);
+    CHECK(get_word(t, STACK - 6) == 0xAAAA);
+    CHECK(cpu->sr == (sr & SR_SCG0));
+    CHECK(cpu->pc == HANDLER + 0x70);
+  }
+}
+
+/* Asserts line 4 when the code writes to this address */
+#define TRIGGER 0x0200
+
+static void trigger(void *user, uint16_t address, size_t len) {
+  if (address == TRIGGER) {
+    assert_interrupt(((test_mcu_t *)user)->mcu, 4);
+  }
+}
+
+/* Flags of the last ALU operation are in the pushed SR, also when an engine
+ * has not computed them yet when the interrupt is taken */
+static void test_pushed_flags(test_mcu_t *t) {
+  static const uint16_t code[] = {
+      0x4304,                 /* MOV #0, R4 */
+      0x8314,                 /* SUB #1, R4 */
+      0x4392, TRIGGER,        /* MOV #1, &TRIGGER */
+      0x4305,                 /* MOV #0, R5 */
+      0x3FFF,                 /* JMP $ */
+  };
+  static const uint16_t handler[] = {
+      0x1300, /* RETI */
+  };
+  Cpu *cpu = &t->mcu->cpu;
+  engine_t engine;
+  int i;
+
+  set_write_notify_cb(t->mcu, trigger);
+  for (engine = ENGINE_REFERENCE; engine <= ENGINE_JIT; engine++) {
+    reset(t, engine);
+    load(t, CODE, code, 6);
+    load(t, HANDLER + 0x40, handler, 1);
+    for (i = 0; i < 100; i++) {
+      cpu->pc = CODE;
+      cpu->sp = STACK;
+      cpu->sr = SR_GIE;
+      run_instructions(cpu, 6);
+    }
+    CHECK(t->mcu->stats.interrupts == 100);
+    CHECK(accepted_count == 100 && accepted[0] == 4);
+    CHECK(get_word(t, STACK - 4) == (SR_GIE | SR_N));
+    CHECK(cpu->sp == STACK && cpu->sr == (SR_GIE | SR_N));
+    CHECK(cpu->r4 == 0xFFFF);
+  }
+  set_write_notify_cb(t->mcu, NULL);
+}
+
+/* An interrupt wakes the CPU from LPM3; RETI returns to LPM3 unless the
+ * handler clears the bits in the pushed SR */
+static void test_wake_up(test_mcu_t *t) {
+  static const uint16_t code[] = {
+      0xD032, 0x00D8, /* BIS #GIE | CPUOFF | SCG0 | SCG1, SR */
+      0x5315,         /* ADD #1, R5 */
+      0x3FFF,         /* JMP $ */
+  };
+  static const uint16_t handlers[][4] = {
+      {
+          0x5316, /* ADD #1, R6 */
+          0x1300, /* RETI */
+      },
+      {
+          0xC0B1, 0x00D0, 0x0000, /* BIC #CPUOFF | SCG0 | SCG1, 0(SP) */
+          0x1300,                 /* RETI */
+      },
+  };
+  const uint16_t lpm3 = SR_GIE | SR_CPU_OFF | SR_SCG0 | SR_SCG1;
+  Cpu *cpu = &t->mcu->cpu;
+  engine_t engine;
+
+  for (engine = ENGINE_REFERENCE; engine <= ENGINE_JIT; engine++) {
+    reset(t, engine);
+    load(t, CODE, code, 4);
+    load(t, HANDLER + 0x10, handlers[0], 2);
+    load(t, HANDLER + 0x20, handlers[1], 4);
+
+    CHECK(run_instructions(cpu, 10) == 1);
+    CHECK(cpu->sr == lpm3 && cpu->pc == CODE + 4);
+    CHECK(run_instructions(cpu, 10) == 0);
+
+    /* Taken at once, in the handler with SR_SCG0 still set */
+    assert_interrupt(t->mcu, 1);
+    CHECK(accept_interrupt(cpu));
+    CHECK(cpu->sr == SR_SCG0 && cpu->pc == HANDLER + 0x10);
+    CHECK(get_word(t, STACK - 4) == lpm3);
+
+    /* Back asleep after the handler */
+    CHECK(run_instructions(cpu, 10) == 2);
+    CHECK(cpu->r6 == 1 && cpu->r5 == 0);
+    CHECK(cpu->sr == lpm3 && cpu->pc == CODE + 4 && cpu->sp == STACK);
+
+    /* Awake for good, taken by run_instructions() */
+    assert_interrupt(t->mcu, 2);
+    CHECK(run_instructions(cpu, 3) == 3);
+    CHECK(cpu->r5 == 1 && cpu->pc == CODE + 6);
+    CHECK(cpu->sr == SR_GIE && cpu->sp == STACK);
+    CHECK(t->mcu->stats.interrupts == 2);
+    CHECK(accepted_count == 2 && accepted[0] == 1 && accepted[1] == 2);
+  }
+}
+
+int main(void) {
+  test_mcu_t *t = test_mcu_create();
+
+  set_interrupt_accept_cb(t->mcu, record_accepted);
+  test_priority(t);
+  test_nmi(t);
+  test_frame(t);
+  test_pushed_flags(t);
+  test_wake_up(t);
+
+  test_mcu_destroy(t);
+  return test_result("test_interrupt");
+}
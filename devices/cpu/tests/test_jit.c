@@ -0,0 +1,86 @@
+/*
+  This file is part of MSP430 Emulator
+
+  MSP430 Emulator is free software: you can redistribute it and/or
+  modify it under the terms of the GNU General Public License as
+  published by the Free Software Foundation, either version 3 of the
+  License, or (at your option) any later version.
+
+  MSP430 Emulator is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with MSP430 Emulator.
+  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+//##########+++ Block Translator Test +++##########
+//# Rewrites a hot loop until the translated code fills
+//# the code memory of the MCU, and checks that the loop
+//# is still translated after that.
+//################################################
+
+#include "../block.h"
+#include "../jit.h"
+#include "test.h"
+
+#define CODE 0x4400
+#define OPS 31
+
+/* ADD 2(R4), 4(R5), OPS times, and JMP back */
+static void load_loop(test_mcu_t *t) {
+  int i;
+
+  for (i = 0; i < OPS; i++) {
+    put_word(t, CODE + 6 * i, 0x5495);
+    put_word(t, CODE + 6 * i + 2, 2);
+    put_word(t, CODE + 6 * i + 4, 4);
+  }
+  put_word(t, CODE + 6 * OPS, 0x3C00 | (0x3FF & -(3 * OPS + 1)));
+  flush_blocks(t->mcu);
+}
+
+/* Every rewrite leaves the old translation behind. When code memory runs
+ * out, it is emptied, and the loop is translated again */
+static void test_code_memory_full(test_mcu_t *t) {
+  Cpu *cpu = &t->mcu->cpu;
+  size_t used = 0;
+  int round, flushes = 0;
+
+  set_engine(t->mcu, ENGINE_JIT);
+  load_loop(t);
+  initialize_msp_registers(cpu);
+  cpu->r4 = 0x2000;
+  cpu->r5 = 0x2100;
+  cpu->sp = 0x3000;
+
+  for (round = 0; round < 300; round++) {
+    cpu->pc = CODE;
+    run_instructions(cpu, (OPS + 1) * JIT_THRESHOLD);
+    if (t->mcu->jit_code == NULL) { /* No JIT on this host */
+      return;
+    }
+
+    if (t->mcu->jit_used < used) {
+      flushes++;
+      run_instructions(cpu, (OPS + 1) * JIT_THRESHOLD);
+    }
+    CHECK(get_block(t->mcu, CODE)->native != NULL);
+    used = t->mcu->jit_used;
+
+    mem_write(&t->mcu->bus, CODE + 2, 2 * round, WORD);
+  }
+  CHECK(flushes > 0);
+}
+
+int main(void) {
+  test_mcu_t *t = test_mcu_create();
+
+  test_code_memory_full(t);
+
+  test_mcu_destroy(t);
+  return test_result("test_jit");
+}
@@ -0,0 +1,196 @@
+/*
+  This file is part of MSP430 Emulator
+
+  MSP430 Emulator is free software: you can redistribute it and/or
+  modify it under the terms of the GNU General Public License as
+  published by the Free Software Foundation, either version 3 of the
+  License, or (at your option) any later version.
+
+  MSP430 Emulator is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with MSP430 Emulator.
+  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+//##########+++ Address Space Test +++##########
+//# Changes the code under every engine after it has been
+//# cached, by every path that changes what memory holds,
+//# and checks that the new code runs, also with a write
+//# hook of the embedder installed.
+//##############################################
+
+#include "test.h"
+
+#define CODE 0x4400
+
+/* MOV #value, R4 ; JMP $ */
+static void put_code(uint8_t *mem, uint16_t address, uint16_t value) {
+  const uint16_t words[] = {0x4034, value, 0x3FFF};
+  size_t i;
+
+  for (i = 0; i < 3; i++) {
+    mem[address + 2 * i] = words[i];
+    mem[address + 2 * i + 1] = words[i] >> 8;
+  }
+}
+
+/* Run the code at an address often enough for every engine to cache it,
+ * and translate it for ENGINE_JIT, and return R4 */
+static uint16_t run_code(test_mcu_t *t, uint16_t address) {
+  Cpu *cpu = &t->mcu->cpu;
+  int i;
+
+  for (i = 0; i < 100; i++) {
+    cpu->pc = address;
+    cpu->r4 = 0;
+    run_instructions(cpu, 2);
+  }
+  return cpu->r4;
+}
+
+/* Replacing the whole address space with another image */
+static void test_remap(test_mcu_t *t) {
+  static uint8_t a[0x10000], b[0x10000];
+  engine_t engine;
+
+  put_code(a, CODE, 0x1111);
+  put_code(b, CODE, 0x2222);
+
+  for (engine = ENGINE_REFERENCE; engine <= ENGINE_JIT; engine++) {
+    set_engine(t->mcu, engine);
+    CHECK(map_host_memory(&t->mcu->bus, 0, a, 0x10000, true));
+    CHECK(run_code(t, CODE) == 0x1111);
+    CHECK(map_host_memory(&t->mcu->bus, 0, b, 0x10000, true));
+    CHECK(run_code(t, CODE) == 0x2222);
+    CHECK(map_host_memory(&t->mcu->bus, CODE, a + CODE, MEM_PAGE_SIZE, true));
+    CHECK(run_code(t, CODE) == 0x1111);
+    CHECK(unmap_host_memory(&t->mcu->bus, 0, 0x10000));
+  }
+}
+
+/* A device over four lines, with the code in the middle */
+static uint8_t device_code[0x100];
+
+static uint16_t device_read(void *context, uint16_t offset, access_t atype) {
+  uint16_t value = device_code[offset];
+
+  if (atype == WORD) {
+    value |= device_code[offset + 1] << 8;
+  }
+  return value;
+}
+
+/* Mapping a device over cached code, and unmapping it */
+static void test_device(test_mcu_t *t) {
+  engine_t engine;
+
+  put_code(t->mem, CODE + 0x80, 0x1111);
+  put_code(device_code, 0x80, 0x2222);
+  flush_decoded_ops(t->mcu);
+
+  for (engine = ENGINE_REFERENCE; engine <= ENGINE_JIT; engine++) {
+    set_engine(t->mcu, engine);
+    CHECK(run_code(t, CODE + 0x80) == 0x1111);
+    CHECK(map_device(&t->mcu->bus, CODE, sizeof device_code, device_read,
+                     NULL, NULL));
+    CHECK(run_code(t, CODE + 0x80) == 0x2222);
+    CHECK(unmap_device(&t->mcu->bus, CODE, sizeof device_code));
+    CHECK(run_code(t, CODE + 0x80) == 0x1111);
+  }
+}
+
+/* A 256-byte burst that starts two lines before cached code, through the
+ * memory callbacks and into host memory */
+static void test_burst(test_mcu_t *t) {
+  static uint8_t ram[0x100];
+  uint8_t burst[0x100];
+  uint16_t words[0x80];
+  engine_t engine;
+  int mapped, i;
+
+  for (mapped = 0; mapped < 2; mapped++) {
+    uint8_t *mem = mapped ? ram : t->mem + CODE;
+
+    if (mapped) {
+      CHECK(map_host_memory(&t->mcu->bus, CODE, ram, sizeof ram, true));
+    }
+
+    for (engine = ENGINE_REFERENCE; engine <= ENGINE_JIT; engine++) {
+      set_engine(t->mcu, engine);
+      put_code(mem, 0x80, 0x1111);
+      flush_decoded_ops(t->mcu);
+      CHECK(run_code(t, CODE + 0x80) == 0x1111);
+
+      memset(burst, 0xFF, sizeof burst);
+      put_code(burst, 0x80, 0x2222);
+      mem_write_bytes(&t->mcu->bus, CODE, burst, sizeof burst);
+      CHECK(run_code(t, CODE + 0x80) == 0x2222);
+
+      put_code(burst, 0x80, 0x3333);
+      for (i = 0; i < 0x80; i++) {
+        words[i] = burst[2 * i] | burst[2 * i + 1] << 8;
+      }
+      mem_write_words(&t->mcu->bus, CODE, words, 0x80);
+      CHECK(run_code(t, CODE + 0x80) == 0x3333);
+    }
+  }
+  CHECK(unmap_host_memory(&t->mcu->bus, CODE, sizeof ram));
+}
+
+/* Writes seen by the embedder's hook */
+static uint32_t notified_writes;
+static uint16_t notified_address;
+static size_t notified_len;
+
+static void record_write(void *user, uint16_t address, size_t len) {
+  notified_writes++;
+  notified_address = address;
+  notified_len = len;
+}
+
+/* An embedder's write hook sees writes, and cached code under them is still
+ * dropped */
+static void test_write_notify(test_mcu_t *t) {
+  engine_t engine;
+
+  set_write_notify_cb(t->mcu, record_write);
+  for (engine = ENGINE_REFERENCE; engine <= ENGINE_JIT; engine++) {
+    set_engine(t->mcu, engine);
+    put_code(t->mem, CODE + 0x100, 0x1111);
+    flush_decoded_ops(t->mcu);
+    CHECK(run_code(t, CODE + 0x100) == 0x1111);
+
+    notified_writes = 0;
+    mem_write(&t->mcu->bus, CODE + 0x102, 0x2222, WORD);
+    CHECK(notified_writes == 1);
+    CHECK(notified_address == CODE + 0x102 && notified_len == 2);
+    CHECK(run_code(t, CODE + 0x100) == 0x2222);
+
+    mem_write_words(&t->mcu->bus, CODE + 0x102, (const uint16_t[]){0x3333},
+                    1);
+    CHECK(notified_writes == 2);
+    CHECK(run_code(t, CODE + 0x100) == 0x3333);
+
+    /* Writes to plain data are seen as well */
+    mem_write(&t->mcu->bus, 0x2000, 0x4444, BYTE);
+    CHECK(notified_writes == 3);
+    CHECK(notified_address == 0x2000 && notified_len == 1);
+  }
+  set_write_notify_cb(t->mcu, NULL);
+}
+
+int main(void) {
+  test_mcu_t *t = test_mcu_create();
+
+  test_remap(t);
+  test_device(t);
+  test_burst(t);
+  test_write_notify(t);
+
+  test_mcu_destroy(t);
+  return test_result("test_memory");
+}
@@ -0,0 +1,300 @@
+/*
+  This file is part of MSP430 Emulator
+
+  MSP430 Emulator is free software: you can redistribute it and/or
+  modify it under the terms of the GNU General Public License as
+  published by the Free Software Foundation, either version 3 of the
+  License, or (at your option) any later version.
+
+  MSP430 Emulator is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with MSP430 Emulator.
+  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+//##########+++ Execution Profiler Test +++##########
+//# Profiles a program with fused pairs, a call and a
+//# delay loop on every engine, through run_instructions()
+//# and through run(), also eliding the delay loop, against
+//# ENGINE_REFERENCE stepped one instruction at a time, and
+//# reads the written profiles back.
+//##################################################
+
+#include "../profiler.h"
+#include "../run.h"
+#include "test.h"
+
+#define CODE 0x4400
+#define DELAY (CODE + 2 * 29)
+#define SUB (CODE + 2 * 37)
+#define STACK 0x3000
+
+static const engine_t engines[] = {ENGINE_REFERENCE, ENGINE_PREDECODE,
+                                   ENGINE_THREADED, ENGINE_BLOCK, ENGINE_JIT};
+
+#define ENGINES (sizeof engines / sizeof engines[0])
+
+/* Twenty times: a copy loop, a loop of ALU + Jcc pairs, a call and a delay
+ * loop; then the CPU off */
+static const uint16_t program[] = {
+    0x403C, 0x0014, /* MOV #20, R12 */
+    0x4034, 0x2000, /* outer: MOV #0x2000, R4 */
+    0x4035, 0x2400, /* MOV #0x2400, R5 */
+    0x4036, 0x0028, /* MOV #40, R6 */
+    0x44B5, 0x0000, /* copy: MOV @R4+, 0(R5) */
+    0x5325,         /* ADD #2, R5 */
+    0x8316,         /* SUB #1, R6 */
+    0x23FB,         /* JNZ copy */
+    0x4037, 0x0032, /* MOV #50, R7 */
+    0x5408,         /* loop: ADD R4, R8 */
+    0x9038, 0x0100, /* CMP #0x100, R8 */
+    0x2801,         /* JLO skip */
+    0x4308,         /* MOV #0, R8 */
+    0xB317,         /* skip: BIT #1, R7 */
+    0x2401,         /* JZ even */
+    0x5339,         /* ADD #-1, R9 */
+    0x5337,         /* even: ADD #-1, R7 */
+    0x23F6,         /* JNZ loop */
+    0x12B0, SUB,    /* CALL #sub */
+    0x403A, 0x0064, /* MOV #100, R10 */
+    0x831A,         /* delay: SUB #1, R10 */
+    0x23FE,         /* JNZ delay */
+    0x831C,         /* SUB #1, R12 */
+    0x23E1,         /* JNZ outer */
+    0xD032, 0x0010, /* BIS #CPUOFF, SR */
+    0x3FFF,         /* JMP $ */
+    0x3FFF,         /* JMP $ */
+    0x1207,         /* sub: PUSH R7 */
+    0x5317,         /* ADD #1, R7 */
+    0x4137,         /* POP R7 */
+    0x4130,         /* RET */
+};
+
+#define PROGRAM_WORDS (sizeof program / sizeof program[0])
+
+static void start(test_mcu_t *t, engine_t engine) {
+  Cpu *cpu = &t->mcu->cpu;
+  size_t i;
+
+  for (i = 0; i < PROGRAM_WORDS; i++) {
+    put_word(t, CODE + 2 * i, program[i]);
+  }
+  set_engine(t->mcu, engine);
+  flush_decoded_ops(t->mcu);
+  flush_blocks(t->mcu);
+  initialize_msp_registers(cpu);
+  cpu->pc = CODE;
+  cpu->sp = STACK;
+  t->cycles = 0;
+  t->mcu->stats.instructions = 0;
+  reset_profiler(t->mcu);
+}
+
+/* The profile of ENGINE_REFERENCE, one instruction at a time */
+static profile_entry_t reference[0x10000];
+
+static void profile_reference(test_mcu_t *t) {
+  uint32_t address;
+
+  start(t, ENGINE_REFERENCE);
+  CHECK(start_profiler(t->mcu));
+  while (run_instructions(&t->mcu->cpu, 1)) {
+  }
+  stop_profiler(t->mcu);
+  CHECK(t->mcu->cpu.pc == CODE + 2 * 35);
+
+  for (address = 0; address < 0x10000; address++) {
+    reference[address] = get_profile_entry(t->mcu, address);
+  }
+  CHECK(reference[CODE + 2 * 8].executions == 20 * 40);
+  CHECK(reference[DELAY].executions == 20 * 100);
+  CHECK(reference[SUB].executions == 20);
+  CHECK(reference[CODE + 2 * 35].executions == 0);
+}
+
+/* The profile matches the reference, and adds up to what was charged */
+static bool same_profile(test_mcu_t *t) {
+  uint64_t executions = 0, cycles = 0;
+  uint32_t address;
+  bool same = true;
+
+  for (address = 0; address < 0x10000; address++) {
+    profile_entry_t entry = get_profile_entry(t->mcu, address);
+
+    same &= entry.executions == reference[address].executions &&
+            entry.cycles == reference[address].cycles;
+    executions += entry.executions;
+    cycles += entry.cycles;
+  }
+  return same && executions == t->mcu->stats.instructions &&
+         cycles == t->cycles;
+}
+
+static void test_engines(test_mcu_t *t) {
+  run_stats_t stats;
+  size_t e;
+
+  for (e = 0; e < ENGINES; e++) {
+    start(t, engines[e]);
+    CHECK(start_profiler(t->mcu));
+    while (run_instructions(&t->mcu->cpu, 7)) {
+    }
+    stop_profiler(t->mcu);
+    if (!same_profile(t)) {
+      fprintf(stderr, "run_instructions() on engine %d\n", engines[e]);
+      CHECK(false);
+    }
+
+    start(t, engines[e]);
+    CHECK(start_profiler(t->mcu));
+    CHECK(run(&t->mcu->cpu, RUN_UNLIMITED, RUN_UNLIMITED, &stats) ==
+          STOP_CPU_OFF);
+    stop_profiler(t->mcu);
+    if (!same_profile(t)) {
+      fprintf(stderr, "run() on engine %d\n", engines[e]);
+      CHECK(false);
+    }
+
+    /* Stepped by run(), which then elides the delay loop */
+    start(t, engines[e]);
+    set_breakpoint(t->mcu, DELAY - 4);
+    CHECK(start_profiler(t->mcu));
+    while (run(&t->mcu->cpu, RUN_UNLIMITED, RUN_UNLIMITED, &stats) ==
+           STOP_BREAKPOINT) {
+      CHECK(t->mcu->cpu.pc == DELAY - 4);
+    }
+    stop_profiler(t->mcu);
+    clear_breakpoint(t->mcu, DELAY - 4);
+    CHECK(t->mcu->cpu.sr & SR_CPU_OFF);
+    if (!same_profile(t)) {
+      fprintf(stderr, "run() with a breakpoint on engine %d\n", engines[e]);
+      CHECK(false);
+    }
+  }
+}
+
+/* Counts are kept while stopped, carry on after a restart, and are cleared
+ * by reset_profiler() */
+static void test_stop(test_mcu_t *t) {
+  start(t, ENGINE_BLOCK);
+  CHECK(run_instructions(&t->mcu->cpu, 100) == 100);
+  CHECK(get_profile_entry(t->mcu, CODE).executions == 0);
+
+  CHECK(start_profiler(t->mcu));
+  run_instructions(&t->mcu->cpu, 10000);
+  stop_profiler(t->mcu);
+  run_instructions(&t->mcu->cpu, 10000);
+  CHECK(get_profile_entry(t->mcu, CODE + 2 * 8).executions <= 20 * 40);
+  CHECK(start_profiler(t->mcu));
+  while (run_instructions(&t->mcu->cpu, 10000)) {
+  }
+  stop_profiler(t->mcu);
+  CHECK(get_profile_entry(t->mcu, DELAY).executions < 20 * 100);
+
+  reset_profiler(t->mcu);
+  CHECK(get_profile_entry(t->mcu, DELAY).executions == 0);
+}
+
+static uint64_t get_le(const uint8_t *p, size_t size) {
+  uint64_t value = 0;
+
+  while (size--) {
+    value = value << 8 | p[size];
+  }
+  return value;
+}
+
+/* The binary profile holds the addresses that ran, in ascending order */
+static void test_write_profile(test_mcu_t *t) {
+  uint8_t header[sizeof PROFILE_MAGIC - 1 + 6], record[18];
+  uint32_t address, count = 0, records = 0;
+  int32_t last = -1;
+  FILE *file = tmpfile();
+
+  for (address = 0; address < 0x10000; address++) {
+    count += reference[address].executions != 0;
+  }
+  memcpy(t->mcu->profile_table, reference, sizeof reference);
+
+  CHECK(file != NULL && write_profile(t->mcu, file));
+  rewind(file);
+  CHECK(fread(header, sizeof header, 1, file) == 1);
+  CHECK(memcmp(header, PROFILE_MAGIC, sizeof PROFILE_MAGIC - 1) == 0);
+  CHECK(get_le(header + sizeof PROFILE_MAGIC - 1, 2) == PROFILE_VERSION);
+  CHECK(get_le(header + sizeof PROFILE_MAGIC + 1, 4) == count);
+
+  while (fread(record, sizeof record, 1, file) == 1) {
+    address = get_le(record, 2);
+    CHECK((int32_t)address > last);
+    CHECK(reference[address].executions != 0);
+    CHECK(get_le(record + 2, 8) == reference[address].executions);
+    CHECK(get_le(record + 10, 8) == reference[address].cycles);
+    last = address;
+    records++;
+  }
+  CHECK(records == count && feof(file));
+  fclose(file);
+}
+
+static const char *symbolize(void *context, uint16_t address) {
+  return address >= SUB ? "sub" : context;
+}
+
+/* One "function;0xADDR cycles" line per address that ran */
+static void test_write_folded_profile(test_mcu_t *t) {
+  char function[8];
+  unsigned int address;
+  unsigned long long cycles;
+  uint32_t count = 0, lines;
+  int symbols;
+  FILE *file;
+
+  for (address = 0; address < 0x10000; address++) {
+    count += reference[address].executions != 0;
+  }
+
+  for (symbols = 0; symbols < 2; symbols++) {
+    file = tmpfile();
+    CHECK(file != NULL);
+    CHECK(write_folded_profile(t->mcu, file, symbols ? symbolize : NULL,
+                               "main"));
+    rewind(file);
+    for (lines = 0;; lines++) {
+      if (symbols) {
+        if (fscanf(file, "%7[^;];0x%4X %llu\n", function, &address,
+                   &cycles) != 3) {
+          break;
+        }
+        CHECK(strcmp(function, address >= SUB ? "sub" : "main") == 0);
+      } else if (fscanf(file, "0x%4X %llu\n", &address, &cycles) != 2) {
+        break;
+      }
+      CHECK(address < 0x10000 && reference[address].executions != 0);
+      CHECK(cycles == reference[address].cycles);
+    }
+    CHECK(lines == count && feof(file));
+    fclose(file);
+  }
+}
+
+int main(void) {
+  test_mcu_t *t = test_mcu_create();
+
+#ifdef MSP430_PROFILER
+  profile_reference(t);
+  test_engines(t);
+  test_stop(t);
+  test_write_profile(t);
+  test_write_folded_profile(t);
+#else
+  CHECK(!start_profiler(t->mcu));
+#endif
+
+  test_mcu_destroy(t);
+  return test_result("test_profiler");
+}
@@ -0,0 +1,567 @@
+/*
+  This file is part of MSP430 Emulator
+
+  MSP430 Emulator is free software: you can redistribute it and/or
+  modify it under the terms of the GNU General Public License as
+  published by the Free Software Foundation, either version 3 of the
+  License, or (at your option) any later version.
+
+  MSP430 Emulator is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with MSP430 Emulator.
+  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+//##########+++ Batch Execution Test +++##########
+//# Checks the budgets and stop reasons of run() on every
+//# engine.
+//################################################
+
+#include "../interrupt.h"
+#include "../run.h"
+#include "test.h"
+#include <string.h>
+
+#define CODE 0x4400
+#define HANDLER 0x5000
+
+static const engine_t engines[] = {ENGINE_REFERENCE, ENGINE_PREDECODE,
+                                   ENGINE_THREADED, ENGINE_BLOCK, ENGINE_JIT};
+
+#define ENGINES (sizeof engines / sizeof engines[0])
+
+static void load(test_mcu_t *t, uint16_t address, const uint16_t *words,
+                 size_t count) {
+  size_t i;
+
+  for (i = 0; i < count; i++) {
+    put_word(t, address + 2 * i, words[i]);
+  }
+  flush_decoded_ops(t->mcu);
+  flush_blocks(t->mcu);
+}
+
+static void reset(test_mcu_t *t, engine_t engine) {
+  Cpu *cpu = &t->mcu->cpu;
+
+  initialize_msp_registers(cpu);
+  cpu->pc = CODE;
+  cpu->sp = 0x3000;
+  set_engine(t->mcu, engine);
+  t->mcu->stats.cycles = 0;
+}
+
+/* run() without its shortcuts: ENGINE_REFERENCE one instruction at a time,
+ * stopping where run() stops */
+static stop_reason_t step_run(test_mcu_t *t, uint64_t max_cycles,
+                              uint64_t max_instructions, run_stats_t *stats) {
+  msp430_t *mcu = t->mcu;
+  uint64_t start_cycles = mcu->stats.cycles;
+  engine_t engine = get_engine(mcu);
+  stop_reason_t reason;
+
+  set_engine(mcu, ENGINE_REFERENCE);
+  stats->instructions = 0;
+  for (;;) {
+    if (mcu->stats.cycles - start_cycles >= max_cycles) {
+      reason = STOP_CYCLES;
+      break;
+    } else if (stats->instructions >= max_instructions) {
+      reason = STOP_INSTRUCTIONS;
+      break;
+    } else if (stats->instructions && has_breakpoint(mcu, mcu->cpu.pc)) {
+      reason = STOP_BREAKPOINT;
+      break;
+    }
+
+    stats->instructions += run_instructions(&mcu->cpu, 1);
+
+    if (!mcu->cpu.running) {
+      reason = STOP_ERROR;
+      break;
+    } else if ((mcu->cpu.sr & SR_CPU_OFF) && !interrupt_ready(&mcu->cpu)) {
+      reason = STOP_CPU_OFF;
+      break;
+    }
+  }
+
+  stats->cycles = mcu->stats.cycles - start_cycles;
+  stats->idle_cycles = 0;
+  set_engine(mcu, engine);
+  return reason;
+}
+
+/* The next wake-up event, at a value of stats.cycles, and the mode the
+ * last call was made in */
+static uint64_t wake_at = RUN_UNLIMITED;
+static power_mode_t wake_mode;
+
+static uint64_t test_wakeup(void *user, power_mode_t mode) {
+  test_mcu_t *t = user;
+
+  wake_mode = mode;
+  if (wake_at == RUN_UNLIMITED) {
+    return RUN_UNLIMITED;
+  }
+  return wake_at > t->mcu->stats.cycles ? wake_at - t->mcu->stats.cycles : 0;
+}
+
+/* Single-source interrupts */
+static void deassert_accepted(void *user, uint8_t line) {
+  deassert_interrupt(((test_mcu_t *)user)->mcu, line);
+}
+
+/* An interrupt that is taken again after every RETI charges more cycles
+ * than the instructions alone, and must not stretch a slice past the
+ * cycle budget */
+static void test_cycle_budget_with_interrupts(test_mcu_t *t) {
+  static const uint16_t loop[] = {
+      0xD232, /* EINT */
+      0x5314, /* ADD #1, R4 */
+      0x3FFE, /* JMP $-2 */
+  };
+  uint64_t max_cycles;
+  size_t e;
+
+  load(t, CODE, loop, 3);
+  put_word(t, HANDLER, 0x1300); /* RETI */
+  put_word(t, INTERRUPT_VECTORS, HANDLER);
+
+  for (e = 0; e < ENGINES; e++) {
+    for (max_cycles = 1; max_cycles < 2000; max_cycles += 7) {
+      run_stats_t stats;
+
+      reset(t, engines[e]);
+      deassert_interrupt(t->mcu, 0);
+      run(&t->mcu->cpu, 10, RUN_UNLIMITED, NULL);
+      assert_interrupt(t->mcu, 0);
+
+      run(&t->mcu->cpu, max_cycles, RUN_UNLIMITED, &stats);
+      CHECK(stats.cycles >= max_cycles);
+      CHECK(stats.cycles < max_cycles + MAX_STEP_CYCLES);
+    }
+  }
+  deassert_interrupt(t->mcu, 0);
+}
+
+static void test_instruction_budget(test_mcu_t *t) {
+  static const uint16_t loop[] = {
+      0x5314, /* ADD #1, R4 */
+      0x3FFE, /* JMP $-2 */
+  };
+  uint64_t max_instructions;
+  size_t e;
+
+  load(t, CODE, loop, 2);
+  for (e = 0; e < ENGINES; e++) {
+    for (max_instructions = 1; max_instructions < 100; max_instructions++) {
+      run_stats_t stats;
+
+      reset(t, engines[e]);
+      CHECK(run(&t->mcu->cpu, RUN_UNLIMITED, max_instructions, &stats) ==
+            STOP_INSTRUCTIONS);
+      CHECK(stats.instructions == max_instructions);
+      CHECK(t->mcu->cpu.r4 == (max_instructions + 1) / 2);
+      CHECK(stats.cycles == t->mcu->stats.cycles);
+    }
+  }
+}
+
+static void test_breakpoints(test_mcu_t *t) {
+  static const uint16_t loop[] = {
+      0x5314, /* ADD #1, R4 */
+      0x5315, /* ADD #1, R5 */
+      0x3FFD, /* JMP $-4 */
+  };
+  Cpu *cpu = &t->mcu->cpu;
+  run_stats_t stats;
+  size_t e;
+
+  load(t, CODE, loop, 3);
+  for (e = 0; e < ENGINES; e++) {
+    reset(t, engines[e]);
+    set_breakpoint(t->mcu, CODE + 2);
+    set_breakpoint(t->mcu, CODE + 2); /* Counted once */
+    CHECK(has_breakpoint(t->mcu, CODE + 2) && !has_breakpoint(t->mcu, CODE));
+
+    CHECK(run(cpu, RUN_UNLIMITED, 100, &stats) == STOP_BREAKPOINT);
+    CHECK(cpu->pc == CODE + 2 && stats.instructions == 1);
+    CHECK(cpu->r4 == 1 && cpu->r5 == 0);
+
+    /* Resuming runs the instruction at the breakpoint */
+    CHECK(run(cpu, RUN_UNLIMITED, 100, &stats) == STOP_BREAKPOINT);
+    CHECK(cpu->pc == CODE + 2 && stats.instructions == 3);
+    CHECK(cpu->r4 == 2 && cpu->r5 == 1);
+
+    /* Budgets are checked first */
+    CHECK(run(cpu, RUN_UNLIMITED, 3, &stats) == STOP_INSTRUCTIONS);
+    CHECK(cpu->pc == CODE + 2 && cpu->r5 == 2);
+
+    set_breakpoint(t->mcu, CODE + 4);
+    CHECK(run(cpu, RUN_UNLIMITED, 100, &stats) == STOP_BREAKPOINT);
+    CHECK(cpu->pc == CODE + 4 && stats.instructions == 1);
+
+    clear_breakpoint(t->mcu, CODE + 2);
+    CHECK(!has_breakpoint(t->mcu, CODE + 2));
+    CHECK(run(cpu, RUN_UNLIMITED, 100, &stats) == STOP_BREAKPOINT);
+    CHECK(cpu->pc == CODE + 4 && stats.instructions == 3);
+
+    set_breakpoint(t->mcu, CODE);
+    clear_breakpoints(t->mcu);
+    CHECK(!has_breakpoint(t->mcu, CODE) && !has_breakpoint(t->mcu, CODE + 4));
+    CHECK(run(cpu, RUN_UNLIMITED, 100, &stats) == STOP_INSTRUCTIONS);
+    CHECK(stats.instructions == 100);
+  }
+}
+
+static void test_cpu_off(test_mcu_t *t) {
+  static const uint16_t code[] = {
+      0x5314,         /* ADD #1, R4 */
+      0xD032, 0x0018, /* BIS #GIE | CPUOFF, SR */
+      0x5315,         /* ADD #1, R5 */
+  };
+  Cpu *cpu = &t->mcu->cpu;
+  run_stats_t stats;
+  size_t e;
+
+  load(t, CODE, code, 4);
+  for (e = 0; e < ENGINES; e++) {
+    reset(t, engines[e]);
+    CHECK(run(cpu, RUN_UNLIMITED, RUN_UNLIMITED, &stats) == STOP_CPU_OFF);
+    CHECK(stats.instructions == 2 && stats.idle_cycles == 0);
+    CHECK(cpu->pc == CODE + 6 && cpu->r4 == 1 && cpu->r5 == 0);
+    CHECK(cpu->sr & SR_CPU_OFF);
+
+    /* Nothing runs while the CPU stays off */
+    CHECK(run(cpu, RUN_UNLIMITED, RUN_UNLIMITED, &stats) == STOP_CPU_OFF);
+    CHECK(stats.instructions == 0 && stats.cycles == 0);
+    CHECK(cpu->pc == CODE + 6);
+  }
+}
+
+/* JMP $ is skipped up to the event as if it had been stepped */
+static void test_jump_to_itself(test_mcu_t *t) {
+  static const uint64_t waits[] = {1, 2, 3, 4, 5, 100, 101, 70001};
+  Cpu *cpu = &t->mcu->cpu;
+  run_stats_t stats, ref;
+  size_t e, i;
+
+  load(t, CODE, (const uint16_t[]){0x3FFF /* JMP $ */}, 1);
+  load(t, HANDLER, (const uint16_t[]){0x1300 /* RETI */}, 1);
+  put_word(t, INTERRUPT_VECTORS, HANDLER);
+  for (e = 0; e < ENGINES; e++) {
+    /* Without a callback it is executed */
+    reset(t, engines[e]);
+    set_wakeup_cb(t->mcu, NULL);
+    CHECK(run(cpu, 100, RUN_UNLIMITED, &stats) == STOP_CYCLES);
+    CHECK(stats.instructions == 50 && stats.idle_cycles == 0);
+
+    set_wakeup_cb(t->mcu, test_wakeup);
+    for (i = 0; i < sizeof waits / sizeof waits[0]; i++) {
+      reset(t, ENGINE_REFERENCE);
+      step_run(t, waits[i], RUN_UNLIMITED, &ref);
+
+      reset(t, engines[e]);
+      t->cycles = 0;
+      wake_at = waits[i];
+      CHECK(run(cpu, RUN_UNLIMITED, RUN_UNLIMITED, &stats) == STOP_WAKEUP);
+      CHECK(wake_mode == POWER_ACTIVE && cpu->pc == CODE);
+      CHECK(stats.cycles == ref.cycles && t->cycles == ref.cycles);
+      CHECK(stats.instructions == ref.instructions);
+      CHECK(stats.idle_cycles == stats.cycles);
+
+      /* Budgets that end first, unless the jump that uses them up also
+       * reaches the event */
+      reset(t, ENGINE_REFERENCE);
+      step_run(t, waits[i] / 2, RUN_UNLIMITED, &ref);
+      reset(t, engines[e]);
+      CHECK(run(cpu, waits[i] / 2, RUN_UNLIMITED, &stats) ==
+            (ref.cycles >= waits[i] ? STOP_WAKEUP : STOP_CYCLES));
+      CHECK(stats.cycles == ref.cycles);
+      CHECK(stats.instructions == ref.instructions);
+
+      reset(t, engines[e]);
+      CHECK(run(cpu, RUN_UNLIMITED, 1, &stats) ==
+            (stats.cycles >= waits[i] ? STOP_WAKEUP : STOP_INSTRUCTIONS));
+      CHECK(stats.instructions == 1);
+    }
+
+    /* A ready interrupt is taken instead, here straight into RETI */
+    reset(t, engines[e]);
+    t->mcu->stats.interrupts = 0;
+    cpu->sr = SR_GIE;
+    wake_at = 1000;
+    assert_interrupt(t->mcu, 0);
+    CHECK(run(cpu, RUN_UNLIMITED, 1, &stats) == STOP_INSTRUCTIONS);
+    CHECK(t->mcu->stats.interrupts == 1 && cpu->pc == CODE);
+    CHECK(stats.idle_cycles == 0);
+    deassert_interrupt(t->mcu, 0);
+  }
+  set_wakeup_cb(t->mcu, NULL);
+  wake_at = RUN_UNLIMITED;
+}
+
+/* The CPU off is skipped to the event, whose interrupt wakes it */
+static void test_low_power(test_mcu_t *t) {
+  static const uint16_t code[] = {
+      0xD032, 0x00D8, /* BIS #GIE | CPUOFF | SCG0 | SCG1, SR */
+      0x5315,         /* ADD #1, R5 */
+      0x3FFF,         /* JMP $ */
+  };
+  static const uint16_t handler[] = {
+      0xC0B1, 0x00D0, 0x0000, /* BIC #CPUOFF | SCG0 | SCG1, 0(SP) */
+      0x1300,                 /* RETI */
+  };
+  Cpu *cpu = &t->mcu->cpu;
+  run_stats_t stats, ref;
+  size_t e;
+
+  load(t, CODE, code, 4);
+  load(t, HANDLER, handler, 4);
+  put_word(t, INTERRUPT_VECTORS, HANDLER);
+  set_wakeup_cb(t->mcu, test_wakeup);
+  set_interrupt_accept_cb(t->mcu, deassert_accepted);
+
+  reset(t, ENGINE_REFERENCE);
+  step_run(t, RUN_UNLIMITED, 1, &ref); /* Cycles of the BIS */
+
+  for (e = 0; e < ENGINES; e++) {
+    reset(t, engines[e]);
+    t->mcu->stats.interrupts = 0;
+    wake_at = 1000;
+    CHECK(run(cpu, RUN_UNLIMITED, RUN_UNLIMITED, &stats) == STOP_WAKEUP);
+    CHECK(wake_mode == POWER_LPM3 && cpu->pc == CODE + 4);
+    CHECK(stats.instructions == 1 && stats.cycles == 1000);
+    CHECK(stats.idle_cycles == 1000 - ref.cycles);
+
+    /* The event is due: nothing is skipped until it is handled */
+    CHECK(run(cpu, RUN_UNLIMITED, RUN_UNLIMITED, &stats) == STOP_WAKEUP);
+    CHECK(stats.cycles == 0);
+
+    /* Its interrupt ends the skip, and the handler leaves LPM3 */
+    assert_interrupt(t->mcu, 0);
+    wake_at = RUN_UNLIMITED;
+    CHECK(run(cpu, RUN_UNLIMITED, 3, &stats) == STOP_INSTRUCTIONS);
+    CHECK(stats.idle_cycles == 0 && t->mcu->stats.interrupts == 1);
+    CHECK(cpu->pc == CODE + 6 && cpu->r5 == 1);
+    CHECK(!(cpu->sr & SR_CPU_OFF) && (cpu->sr & SR_GIE));
+
+    /* No event: off for good, or until the cycle budget */
+    reset(t, engines[e]);
+    CHECK(run(cpu, RUN_UNLIMITED, RUN_UNLIMITED, &stats) == STOP_CPU_OFF);
+    CHECK(stats.instructions == 1 && stats.idle_cycles == 0);
+    CHECK(run(cpu, 5000, RUN_UNLIMITED, &stats) == STOP_CYCLES);
+    CHECK(stats.cycles == 5000 && stats.idle_cycles == 5000);
+    CHECK(cpu->pc == CODE + 4);
+  }
+  set_wakeup_cb(t->mcu, NULL);
+  set_interrupt_accept_cb(t->mcu, NULL);
+}
+
+/* Countdown loops at CODE: the count instruction, JNZ back to it, then
+ * ADD #1, R5 ; JMP $ */
+typedef struct delay_case {
+  uint16_t count[2];
+  size_t length;
+} delay_case_t;
+
+static const delay_case_t delay_cases[] = {
+    {{0x8314}, 1},         /* SUB #1, R4 */
+    {{0x5334}, 1},         /* ADD #-1, R4 */
+    {{0x8324}, 1},         /* SUB #2, R4 */
+    {{0x8034, 3}, 2},      /* SUB #3, R4 */
+    {{0x8034, 0xFFFE}, 2}, /* SUB #0xFFFE, R4 */
+};
+
+#define DELAY_CASES (sizeof delay_cases / sizeof delay_cases[0])
+
+/* Where a run ended */
+typedef struct outcome {
+  stop_reason_t reason;
+  run_stats_t stats;
+  uint16_t regs[16];
+} outcome_t;
+
+static void load_delay_loop(test_mcu_t *t, const delay_case_t *c) {
+  uint16_t code[5];
+  size_t i;
+
+  for (i = 0; i < c->length; i++) {
+    code[i] = c->count[i];
+  }
+  code[i++] = 0x2000 | (uint16_t)(-(int)c->length - 1 & 0x3FF); /* JNZ */
+  code[i++] = 0x5315;                                          /* ADD #1, R5 */
+  code[i++] = 0x3FFF;                                          /* JMP $ */
+  load(t, CODE, code, i);
+}
+
+static void start_delay_loop(test_mcu_t *t, engine_t engine, uint16_t count) {
+  Cpu *cpu = &t->mcu->cpu;
+  int i;
+
+  reset(t, engine);
+  for (i = 5; i < 16; i++) {
+    cpu->regs[i] = 0x1000 * i;
+  }
+  cpu->r4 = count;
+  cpu->sr = SR_C | SR_V;
+}
+
+static void run_delay_loop(test_mcu_t *t, bool stepped, uint64_t max_cycles,
+                           uint64_t max_instructions, outcome_t *out) {
+  Cpu *cpu = &t->mcu->cpu;
+
+  if (stepped) {
+    out->reason = step_run(t, max_cycles, max_instructions, &out->stats);
+  } else {
+    out->reason = run(cpu, max_cycles, max_instructions, &out->stats);
+  }
+  memcpy(out->regs, cpu->regs, sizeof out->regs);
+}
+
+static bool same_outcome(const outcome_t *a, const outcome_t *b) {
+  return a->reason == b->reason && a->stats.cycles == b->stats.cycles &&
+         a->stats.instructions == b->stats.instructions &&
+         memcmp(a->regs, b->regs, sizeof a->regs) == 0;
+}
+
+/* Elided loops end where stepping them ends, whichever budget stops them */
+static void test_delay_loop_budgets(test_mcu_t *t) {
+  static const uint16_t counts[] = {1, 2, 7, 0x100, 0x101, 0xFFFF};
+  static const struct {
+    uint64_t cycles, instructions;
+  } budgets[] = {
+      {RUN_UNLIMITED, 140000}, {1, RUN_UNLIMITED},     {2, RUN_UNLIMITED},
+      {4, RUN_UNLIMITED},      {5, RUN_UNLIMITED},     {100, RUN_UNLIMITED},
+      {101, RUN_UNLIMITED},    {1000, RUN_UNLIMITED},  {30001, RUN_UNLIMITED},
+      {RUN_UNLIMITED, 1},      {RUN_UNLIMITED, 2},     {RUN_UNLIMITED, 3},
+      {RUN_UNLIMITED, 101},    {RUN_UNLIMITED, 1000},  {RUN_UNLIMITED, 30001},
+      {1000, 400},
+  };
+  outcome_t ref, got;
+  size_t c, i, b, e;
+
+  for (c = 0; c < DELAY_CASES; c++) {
+    load_delay_loop(t, &delay_cases[c]);
+    for (i = 0; i < sizeof counts / sizeof counts[0]; i++) {
+      for (b = 0; b < sizeof budgets / sizeof budgets[0]; b++) {
+        start_delay_loop(t, ENGINE_REFERENCE, counts[i]);
+        run_delay_loop(t, true, budgets[b].cycles, budgets[b].instructions,
+                       &ref);
+        for (e = 0; e < ENGINES; e++) {
+          start_delay_loop(t, engines[e], counts[i]);
+          run_delay_loop(t, false, budgets[b].cycles, budgets[b].instructions,
+                         &got);
+          if (!same_outcome(&ref, &got)) {
+            fprintf(stderr, "case %zu count %04X budget %zu engine %d\n", c,
+                    counts[i], b, engines[e]);
+          }
+          CHECK(same_outcome(&ref, &got));
+        }
+      }
+    }
+  }
+}
+
+/* A breakpoint on either instruction of the loop stops every turn, one
+ * after it stops at the end */
+static void test_delay_loop_breakpoints(test_mcu_t *t) {
+  static const uint16_t breakpoints[] = {CODE, CODE + 2, CODE + 4};
+  static const size_t expected_stops[] = {9, 10, 1};
+  outcome_t ref[32], got;
+  size_t b, e, n, stops;
+
+  load_delay_loop(t, &delay_cases[0]);
+  for (b = 0; b < sizeof breakpoints / sizeof breakpoints[0]; b++) {
+    set_breakpoint(t->mcu, breakpoints[b]);
+
+    start_delay_loop(t, ENGINE_REFERENCE, 10);
+    for (stops = 0; stops < 32; stops++) {
+      run_delay_loop(t, true, RUN_UNLIMITED, 1000, &ref[stops]);
+      if (ref[stops].reason != STOP_BREAKPOINT) {
+        break;
+      }
+    }
+    CHECK(stops == expected_stops[b]);
+
+    for (e = 0; e < ENGINES; e++) {
+      start_delay_loop(t, engines[e], 10);
+      for (n = 0; n <= stops && n < 32; n++) {
+        run_delay_loop(t, false, RUN_UNLIMITED, 1000, &got);
+        CHECK(same_outcome(&ref[n], &got));
+      }
+    }
+    clear_breakpoint(t->mcu, breakpoints[b]);
+  }
+}
+
+/* A loop stops at a wake-up event before its last turn, whose interrupt is
+ * then taken at the same instruction as if the loop had been stepped */
+static void test_delay_loop_interrupts(test_mcu_t *t) {
+  static const uint64_t events[] = {1, 2, 3, 4, 5, 6, 7, 100, 101, 102, 299};
+  static const uint16_t handler[] = {
+      0x5316, /* ADD #1, R6 */
+      0x1300, /* RETI */
+  };
+  outcome_t ref[2], got;
+  size_t c, i, e;
+
+  load(t, HANDLER, handler, 2);
+  put_word(t, INTERRUPT_VECTORS, HANDLER);
+  set_interrupt_accept_cb(t->mcu, deassert_accepted);
+  set_wakeup_cb(t->mcu, test_wakeup);
+
+  for (c = 0; c < DELAY_CASES; c++) {
+    load_delay_loop(t, &delay_cases[c]);
+    for (i = 0; i < sizeof events / sizeof events[0]; i++) {
+      for (e = 0; e < ENGINES; e++) {
+        start_delay_loop(t, engines[e], 0x100);
+        t->mcu->cpu.sr |= SR_GIE;
+        wake_at = events[i];
+        run_delay_loop(t, false, RUN_UNLIMITED, 2000, &got);
+        CHECK(got.reason == STOP_WAKEUP && got.stats.cycles >= events[i]);
+
+        /* Stepped to the same instruction, unless the loop was done */
+        start_delay_loop(t, ENGINE_REFERENCE, 0x100);
+        t->mcu->cpu.sr |= SR_GIE;
+        wake_at = RUN_UNLIMITED;
+        run_delay_loop(t, true, RUN_UNLIMITED, got.stats.instructions, &ref[0]);
+        ref[0].reason = STOP_WAKEUP;
+        CHECK(same_outcome(&ref[0], &got));
+
+        assert_interrupt(t->mcu, 0);
+        run_delay_loop(t, true, RUN_UNLIMITED, 1000, &ref[1]);
+        CHECK(ref[1].regs[6] == 0x6001);
+
+        memcpy(t->mcu->cpu.regs, got.regs, sizeof got.regs);
+        set_engine(t->mcu, engines[e]);
+        assert_interrupt(t->mcu, 0);
+        run_delay_loop(t, false, RUN_UNLIMITED, 1000, &got);
+        CHECK(same_outcome(&ref[1], &got));
+      }
+    }
+  }
+  set_wakeup_cb(t->mcu, NULL);
+  set_interrupt_accept_cb(t->mcu, NULL);
+}
+
+int main(void) {
+  test_mcu_t *t = test_mcu_create();
+
+  test_cycle_budget_with_interrupts(t);
+  test_instruction_budget(t);
+  test_breakpoints(t);
+  test_cpu_off(t);
+  test_jump_to_itself(t);
+  test_low_power(t);
+  test_delay_loop_budgets(t);
+  test_delay_loop_breakpoints(t);
+  test_delay_loop_interrupts(t);
+
+  test_mcu_destroy(t);
+  return test_result("test_run");
+}
@@ -0,0 +1,176 @@
+/*
+  This file is part of MSP430 Emulator
+
+  MSP430 Emulator is free software: you can redistribute it and/or
+  modify it under the terms of the GNU General Public License as
+  published by the Free Software Foundation, either version 3 of the
+  License, or (at your option) any later version.
+
+  MSP430 Emulator is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with MSP430 Emulator.
+  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+//##########+++ Snapshot Test +++##########
+//# Takes several snapshots of an MCU running code that
+//# writes memory, under every engine, returns to each of
+//# them in turn, and forks one into a second MCU. Pages
+//# saved for more than one snapshot must be shared.
+//#########################################
+
+#include "test.h"
+#include <string.h>
+
+#define RAM 0x2000
+#define CODE (RAM + 0x80)
+#define DATA (RAM + 0x180)
+
+typedef struct machine {
+  test_mcu_t *t;
+  uint8_t ram[0x200];
+  uint32_t state[4]; /* Registered with the snapshots */
+} machine_t;
+
+static void machine_init(machine_t *m) {
+  m->t = test_mcu_create();
+  CHECK(map_host_memory(&m->t->mcu->bus, RAM, m->ram, sizeof m->ram, true));
+  CHECK(register_snapshot_state(m->t->mcu, m->state, sizeof m->state));
+}
+
+/* MOV #value, R4 ; MOV R4, &DATA ; JMP $ */
+static void put_code(uint8_t *code, uint16_t value) {
+  const uint16_t words[] = {0x4034, value, 0x4482, DATA, 0x3FFF};
+  size_t i;
+
+  for (i = 0; i < 5; i++) {
+    code[2 * i] = words[i];
+    code[2 * i + 1] = words[i] >> 8;
+  }
+}
+
+/* Run the code often enough for every engine to cache it, and return R4 */
+static uint16_t run_code(machine_t *m) {
+  Cpu *cpu = &m->t->mcu->cpu;
+  int i;
+
+  for (i = 0; i < 100; i++) {
+    cpu->pc = CODE;
+    cpu->r4 = 0;
+    run_instructions(cpu, 3);
+  }
+  return cpu->r4;
+}
+
+static uint16_t data_word(const uint8_t *ram) {
+  return ram[DATA - RAM] | ram[DATA - RAM + 1] << 8;
+}
+
+/* Two snapshots of the code before and after it is replaced and run */
+static void test_restore(machine_t *m, machine_t *fork) {
+  static uint8_t at_first[0x200], at_second[0x200];
+  uint8_t code[10];
+  snapshot_t first, second;
+  engine_t engine;
+  uint16_t page;
+
+  for (engine = ENGINE_REFERENCE; engine <= ENGINE_JIT; engine++) {
+    set_engine(m->t->mcu, engine);
+    set_engine(fork->t->mcu, engine);
+    memset(m->ram, 0, sizeof m->ram);
+    put_code(&m->ram[CODE - RAM], 0x1111);
+    flush_decoded_ops(m->t->mcu);
+    m->state[0] = 1;
+    memcpy(at_first, m->ram, sizeof m->ram);
+    CHECK(take_snapshot(&first, &m->t->mcu->cpu));
+    CHECK(run_code(m) == 0x1111);
+    CHECK(data_word(m->ram) == 0x1111);
+
+    put_code(code, 0x2222);
+    mem_write_bytes(&m->t->mcu->bus, CODE, code, sizeof code);
+    m->state[0] = 2;
+    memcpy(at_second, m->ram, sizeof m->ram);
+    CHECK(take_snapshot(&second, &m->t->mcu->cpu));
+    CHECK(run_code(m) == 0x2222);
+    CHECK(data_word(m->ram) == 0x2222);
+
+    CHECK(restore_snapshot(&first, &m->t->mcu->cpu));
+    CHECK(!memcmp(m->ram, at_first, sizeof m->ram));
+    CHECK(m->state[0] == 1);
+    CHECK(run_code(m) == 0x1111);
+
+    CHECK(restore_snapshot(&second, &m->t->mcu->cpu));
+    CHECK(!memcmp(m->ram, at_second, sizeof m->ram));
+    CHECK(m->state[0] == 2);
+    CHECK(run_code(m) == 0x2222);
+
+    /* The second MCU runs from the second snapshot on its own memory */
+    CHECK(restore_snapshot(&first, &m->t->mcu->cpu));
+    CHECK(snapshot_fork(&second, fork->t->mcu));
+    CHECK(!memcmp(fork->ram, at_second, sizeof fork->ram));
+    CHECK(fork->state[0] == 2);
+    CHECK(fork->t->mcu->cpu.mcu == fork->t->mcu);
+    CHECK(run_code(fork) == 0x2222);
+    CHECK(!memcmp(m->ram, at_first, sizeof m->ram));
+
+    free_snapshot(&first);
+    CHECK(!restore_snapshot(&first, &m->t->mcu->cpu));
+    CHECK(restore_snapshot(&second, &m->t->mcu->cpu));
+    CHECK(!memcmp(m->ram, at_second, sizeof m->ram));
+    free_snapshot(&second);
+    for (page = 0; page < MEM_PAGES; page++) {
+      CHECK(m->t->mcu->bus.protected_pages[page] == NULL);
+    }
+  }
+}
+
+/* A page written once after two snapshots is saved once for both */
+static void test_sharing(machine_t *m) {
+  uint16_t page = DATA >> MEM_PAGE_SHIFT;
+  snapshot_t first, second;
+
+  CHECK(take_snapshot(&first, &m->t->mcu->cpu));
+  CHECK(take_snapshot(&second, &m->t->mcu->cpu));
+  bus_write(&m->t->mcu->bus, DATA, 0x3333, WORD);
+  CHECK(first.pages[page] != NULL && first.pages[page] == second.pages[page]);
+  CHECK(first.pages[page] != NULL && first.pages[page]->refs == 2);
+
+  free_snapshot(&first);
+  CHECK(second.pages[page] != NULL && second.pages[page]->refs == 1);
+  CHECK(restore_snapshot(&second, &m->t->mcu->cpu));
+  CHECK(data_word(m->ram) != 0x3333);
+  free_snapshot(&second);
+}
+
+/* An MCU without the memory of the snapshot cannot take it */
+static void test_fork_mismatch(machine_t *m) {
+  test_mcu_t *t = test_mcu_create();
+  snapshot_t snap;
+
+  CHECK(take_snapshot(&snap, &m->t->mcu->cpu));
+  CHECK(!snapshot_fork(&snap, t->mcu));
+  CHECK(map_host_memory(&t->mcu->bus, RAM, m->ram, sizeof m->ram, true));
+  CHECK(!snapshot_fork(&snap, t->mcu));
+  free_snapshot(&snap);
+  test_mcu_destroy(t);
+}
+
+int main(void) {
+  static machine_t m, fork;
+
+  machine_init(&m);
+  machine_init(&fork);
+
+  test_restore(&m, &fork);
+  test_sharing(&m);
+  test_fork_mismatch(&m);
+
+  test_mcu_destroy(m.t);
+  test_mcu_destroy(fork.t);
+  return test_result("test_snapshot");
+}
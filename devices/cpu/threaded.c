@@ -0,0 +1,234 @@
+/*
+  This file is part of MSP430 Emulator
+
+  MSP430 Emulator is free software: you can redistribute it and/or
+  modify it under the terms of the GNU General Public License as
+  published by the Free Software Foundation, either version 3 of the
+  License, or (at your option) any later version.
+
+  MSP430 Emulator is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with MSP430 Emulator.
+  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+//##########+++ Threaded-Code Interpreter +++##########
+//# Every predecoded instruction carries the index of a
+//# handler specialized for its opcode and operand modes.
+//# Handlers end by jumping straight to the handler of the
+//# next instruction (computed goto), so the host branch
+//# predictor sees one indirect branch per handler instead
+//# of a single shared one.
+//#
+//# run_blocks() runs the same handlers over cached basic
+//# blocks: dispatch inside a block needs no cache lookup,
+//# and register reads and cycles are charged per block.
+//# Instruction pairs fused when the block was built run
+//# as a single handler, see fusion.h.
+//#####################################################
+
+#include "threaded.h"
+#include "block.h"
+#include "decoder.h"
+#include "execute.h"
+#include "execute_impl.h"
+#include "fusion.h"
+#include "handlers.h"
+#include "interrupt.h"
+
+/* Handler table entries */
+#define FI_LABEL(OPC, S, D, BW) &&formatI_##OPC##_##S##_##D##_##BW,
+#define FII_LABEL(OPC, S, BW) &&formatII_##OPC##_##S##_##BW,
+#define FIII_LABEL(C) &&formatIII_##C,
+
+/* Handler bodies, using the PROLOGUE and DISPATCH of the enclosing
+ * interpreter */
+#define FI_BODY(OPC, S, D, BW)                                                 \
+  formatI_##OPC##_##S##_##D##_##BW : PROLOGUE();                               \
+  exec_formatI(cpu, op, OP_##OPC, SRC_##S, DST_##D, BW_##BW);                  \
+  DISPATCH();
+#define FII_BODY(OPC, S, BW)                                                   \
+  formatII_##OPC##_##S##_##BW : PROLOGUE();                                    \
+  exec_formatII(cpu, op, OP_##OPC, SRC_##S, BW_##BW);                          \
+  DISPATCH();
+#define FIII_BODY(C)                                                           \
+  formatIII_##C : PROLOGUE();                                                  \
+  exec_formatIII(cpu, op, C);                                                  \
+  DISPATCH();
+
+/* Fused handlers for run_blocks(), see fusion.h. The first instruction of
+ * FC writes memory, which may drop the block */
+#define FJ_LABEL(OPC, S, BW) &&fused_##OPC##_##S##_##BW,
+#define FC_LABEL(BW) &&fused_copy_##BW,
+#define FJ_BODY(OPC, S, BW)                                                    \
+  fused_##OPC##_##S##_##BW : PROLOGUE();                                       \
+  exec_formatI(cpu, op, OP_##OPC, SRC_##S, DST_REG, BW_##BW);                  \
+  mcu->stats.fusions[FUSION_##OPC##_JCC]++;                                    \
+  op++;                                                                        \
+  PROLOGUE();                                                                  \
+  exec_fused_jump(cpu, op, FLAGS_KIND_##OPC);                                  \
+  DISPATCH();
+#define FC_BODY(BW)                                                            \
+  fused_copy_##BW : PROLOGUE();                                                \
+  exec_formatI(cpu, op, OP_MOV, SRC_INC, DST_IDX, BW_##BW);                    \
+  if (generation != mcu->block_generation) {                                   \
+    goto aborted;                                                              \
+  }                                                                            \
+  mcu->stats.fusions[FUSION_COPY]++;                                           \
+  op++;                                                                        \
+  PROLOGUE();                                                                  \
+  exec_formatI(cpu, op, OP_ADD, SRC_VAL, DST_REG, BW_W);                       \
+  DISPATCH();
+
+#define FLAGS_KIND_ADD FLAGS_ADD
+#define FLAGS_KIND_SUB FLAGS_SUB
+#define FLAGS_KIND_CMP FLAGS_SUB
+#define FLAGS_KIND_BIT FLAGS_LOGIC
+
+uint32_t run_threaded(Cpu *cpu, uint32_t count) {
+#define FI FI_LABEL
+#define FII FII_LABEL
+#define FIII FIII_LABEL
+  static const void *const handlers[] = {&&fallback, ALL_HANDLERS};
+#undef FI
+#undef FII
+#undef FIII
+  _Static_assert(sizeof handlers / sizeof handlers[0] == HANDLER_COUNT,
+                 "Handler table out of sync with handler index layout");
+
+  msp430_t *mcu = cpu->mcu;
+  const decoded_op_t *op;
+  instruction_t instr;
+  uint32_t executed = 0;
+
+#define PROLOGUE() exec_prologue(cpu, op)
+#define DISPATCH()                                                             \
+  do {                                                                         \
+    flush_register_notify(cpu);                                                \
+    if (executed == count) {                                                   \
+      return executed;                                                         \
+    }                                                                          \
+    poll_interrupts(cpu);                                                      \
+    executed++;                                                                \
+    if (cpu->pc & 1) {                                                         \
+      goto fallback;                                                           \
+    }                                                                          \
+    op = get_decoded_op(mcu, cpu->pc);                                         \
+    goto *handlers[op->handler];                                               \
+  } while (0)
+
+  DISPATCH();
+
+fallback: /* Misaligned, or may halt the CPU: run through the reference
+             decoder */
+  decode(cpu, fetch(cpu), NULL, &instr);
+  if (cpu_halted(cpu)) {
+    return executed;
+  }
+  DISPATCH();
+
+#define FI FI_BODY
+#define FII FII_BODY
+#define FIII FIII_BODY
+  ALL_HANDLERS
+#undef FI
+#undef FII
+#undef FIII
+#undef PROLOGUE
+#undef DISPATCH
+}
+
+uint32_t run_blocks(Cpu *cpu, uint32_t count) {
+#define FI FI_LABEL
+#define FII FII_LABEL
+#define FIII FIII_LABEL
+#define FJ FJ_LABEL
+#define FC FC_LABEL
+  static const void *const handlers[] = {&&fallback, ALL_HANDLERS
+                                             FUSED_HANDLERS};
+#undef FI
+#undef FII
+#undef FIII
+#undef FJ
+#undef FC
+  _Static_assert(sizeof handlers / sizeof handlers[0] == FUSED_HANDLER_END,
+                 "Handler table out of sync with fused handler layout");
+
+  msp430_t *mcu = cpu->mcu;
+  const basic_block_t *block;
+  const decoded_op_t *op, *end;
+  instruction_t instr;
+  uint32_t executed = 0;
+  uint32_t generation;
+
+  /* Register reads and cycles are charged once per block */
+#define PROLOGUE() (cpu->pc += 2 * op->length)
+#define DISPATCH()                                                             \
+  do {                                                                         \
+    if (generation != mcu->block_generation) {                                 \
+      goto aborted;                                                            \
+    }                                                                          \
+    if (++op < end) {                                                          \
+      goto *handlers[op->handler];                                             \
+    }                                                                          \
+    goto completed;                                                            \
+  } while (0)
+
+next:
+  flush_register_notify(cpu);
+  if (executed == count || cpu_halted(cpu)) {
+    return executed;
+  }
+  poll_interrupts(cpu); /* Between blocks only */
+
+  if (cpu->pc & 1) { /* Misaligned, run through the reference decoder */
+    decode(cpu, fetch(cpu), NULL, &instr);
+    executed++;
+    goto next;
+  }
+
+  block = get_block(mcu, cpu->pc);
+  if (block == NULL || block->count > count - executed) {
+    execute(cpu, get_decoded_op(mcu, cpu->pc), &instr);
+    executed++;
+    goto next;
+  }
+
+  op = block->ops;
+  end = op + block->count;
+  generation = mcu->block_generation;
+  goto *handlers[op->handler];
+
+completed:
+  executed += block->count;
+  charge_block(cpu, block, block->count);
+  goto next;
+
+aborted: /* A write dropped cached code, possibly this block */
+  executed += op - block->ops + 1;
+  charge_block(cpu, block, op - block->ops + 1);
+  goto next;
+
+fallback: /* Blocks never hold instructions that may halt the CPU */
+  decode(cpu, fetch(cpu), NULL, &instr);
+  DISPATCH();
+
+#define FI FI_BODY
+#define FII FII_BODY
+#define FIII FIII_BODY
+#define FJ FJ_BODY
+#define FC FC_BODY
+  ALL_HANDLERS
+  FUSED_HANDLERS
+#undef FI
+#undef FII
+#undef FIII
+#undef FJ
+#undef FC
+#undef PROLOGUE
+#undef DISPATCH
+}
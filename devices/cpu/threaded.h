@@ -0,0 +1,44 @@
+/*
+  This file is part of MSP430 Emulator
+
+  MSP430 Emulator is free software: you can redistribute it and/or
+  modify it under the terms of the GNU General Public License as
+  published by the Free Software Foundation, either version 3 of the
+  License, or (at your option) any later version.
+
+  MSP430 Emulator is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with MSP430 Emulator.
+  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef _THREADED_H_
+#define _THREADED_H_
+
+#include "predecode.h"
+#include "registers.h"
+
+/**
+ * @brief Execute instructions with the threaded-code interpreter. Each
+ * handler dispatches directly to the handler of the next instruction.
+ * @param cpu A pointer to the CPU structure
+ * @param count Number of instructions to execute
+ * @return Number of instructions executed
+ */
+uint32_t run_threaded(Cpu *cpu, uint32_t count);
+
+/**
+ * @brief Execute instructions with the threaded-code interpreter over cached
+ * basic blocks, see block.h. Static register read notifications and cycles
+ * are charged once per block, after it has run.
+ * @param cpu A pointer to the CPU structure
+ * @param count Number of instructions to execute
+ * @return Number of instructions executed
+ */
+uint32_t run_blocks(Cpu *cpu, uint32_t count);
+
+#endif
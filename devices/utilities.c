@@ -16,36 +16,19 @@ along with this program. If not, see <http://www.gnu.org/licenses
 */
 
 #include "utilities.h"
-#include "assert.h"
-
-// Writebacks for memory access
-static void (*write_memory_cb)(const uint32_t, uint8_t *const, size_t) = NULL;
-static void (*read_memory_cb)(const uint32_t, uint8_t *const, size_t) = NULL;
 
 // Set callback to write data to memory
-void set_write_memory_cb(void (*fptr)(const uint32_t, uint8_t *const, size_t)) {
-  write_memory_cb = fptr;
+void set_write_memory_cb(bus_t *bus,
+                         void (*fptr)(void *user, uint32_t address,
+                                      uint8_t *data, size_t len)) {
+  bus->write_memory_cb = fptr;
 }
 
 // Set callback to read data from memory
-void set_read_memory_cb(void (*fptr)(const uint32_t, uint8_t *const, size_t)) {
-  read_memory_cb = fptr;
-}
-
-void (*consume_cycles_cb)(uint16_t);
-void (*register_read_notify_cb)(uint16_t);
-void (*register_write_notify_cb)(uint16_t);
-
-void set_consume_cycles_cb(void (*functionPtr)(uint16_t)) {
-  consume_cycles_cb = functionPtr;
-}
-
-void set_register_read_notify_cb(void (*functionPtr)(uint16_t)) {
-  register_read_notify_cb = functionPtr;
-}
-
-void set_register_write_notify_cb(void (*functionPtr)(uint16_t)) {
-  register_write_notify_cb = functionPtr;
+void set_read_memory_cb(bus_t *bus,
+                        void (*fptr)(void *user, uint32_t address,
+                                     uint8_t *data, size_t len)) {
+  bus->read_memory_cb = fptr;
 }
 
 uint16_t pack16(const uint8_t *const data) {
@@ -70,79 +53,336 @@ void unpack16(uint8_t *const out, const uint16_t in) {
 #endif
 }
 
-uint16_t mem_read(uint16_t address, access_t atype) {
-  assert(read_memory_cb != NULL);
+static bool set_pages(bus_t *bus, uint16_t address, uint8_t *host, size_t len,
+                      bool writable) {
+  size_t first = address >> MEM_PAGE_SHIFT;
+  size_t i;
+
+  if ((address | len) & (MEM_PAGE_SIZE - 1) || address + len > 0x10000) {
+    return false;
+  }
+
+  for (i = 0; i < len >> MEM_PAGE_SHIFT; i++) {
+    bus->read_pages[first + i] = host ? host + (i << MEM_PAGE_SHIFT) : NULL;
+    bus->write_pages[first + i] = writable ? bus->read_pages[first + i] : NULL;
+    bus->protected_pages[first + i] = NULL;
+  }
+
+  // What the core reads at these addresses may have changed
+  if (len) {
+    mem_write_notify(bus, address, len);
+  }
+  return true;
+}
+
+bool map_host_memory(bus_t *bus, uint16_t address, uint8_t *host, size_t len,
+                     bool writable) {
+  return host != NULL && set_pages(bus, address, host, len, writable);
+}
+
+bool unmap_host_memory(bus_t *bus, uint16_t address, size_t len) {
+  return set_pages(bus, address, NULL, len, false);
+}
+
+uint8_t *writable_host_page(const bus_t *bus, uint16_t page) {
+  if (page >= MEM_PAGES) {
+    return NULL;
+  }
+  return bus->write_pages[page] ? bus->write_pages[page]
+                                : bus->protected_pages[page];
+}
+
+void protect_host_page(bus_t *bus, uint16_t page) {
+  if (page < MEM_PAGES && bus->write_pages[page] != NULL &&
+      bus->page_write_cb != NULL) {
+    bus->protected_pages[page] = bus->write_pages[page];
+    bus->write_pages[page] = NULL;
+  }
+}
+
+void protect_host_pages(bus_t *bus, void (*fptr)(void *context, uint16_t page),
+                        void *context) {
+  uint16_t page;
+
+  for (page = 0; page < MEM_PAGES; page++) {
+    if (bus->protected_pages[page] != NULL) {
+      bus->write_pages[page] = bus->protected_pages[page];
+      bus->protected_pages[page] = NULL;
+    }
+  }
+
+  bus->page_write_cb = fptr;
+  bus->page_context = context;
+  for (page = 0; page < MEM_PAGES; page++) {
+    protect_host_page(bus, page);
+  }
+}
+
+void set_bus_fault_cb(bus_t *bus,
+                      void (*fptr)(void *user, uint16_t address,
+                                   access_t atype, bool write)) {
+  bus->bus_fault_cb = fptr;
+}
+
+// Free the slots of devices that no address maps to any more
+static void release_devices(bus_t *bus) {
+  bool used[BUS_DEVICES + 1] = {false};
+  uint32_t a;
+  uint16_t i;
+
+  for (a = 0; a < 0x10000; a++) {
+    used[bus->device_map[a]] = true;
+  }
+  for (i = 1; i <= BUS_DEVICES; i++) {
+    if (!used[i]) {
+      memset(&bus->devices[i], 0, sizeof bus->devices[i]);
+    }
+  }
+}
+
+bool map_device(bus_t *bus, uint16_t address, size_t len, device_read_t read,
+                device_write_t write, void *context) {
+  uint16_t i;
+
+  if (address + len > 0x10000) {
+    return false;
+  }
+
+  for (i = 1; i <= BUS_DEVICES; i++) {
+    if (bus->devices[i].read == NULL && bus->devices[i].write == NULL) {
+      break;
+    }
+  }
+  if (i > BUS_DEVICES || (read == NULL && write == NULL)) {
+    return false;
+  }
+
+  bus->devices[i] = (bus_device_t){read, write, context, address};
+  memset(&bus->device_map[address], i, len);
+  release_devices(bus); /* Devices that are now covered entirely */
+
+  if (len) {
+    mem_write_notify(bus, address, len);
+  }
+  return true;
+}
+
+bool unmap_device(bus_t *bus, uint16_t address, size_t len) {
+  if (address + len > 0x10000) {
+    return false;
+  }
+
+  memset(&bus->device_map[address], 0, len);
+  release_devices(bus);
+
+  if (len) {
+    mem_write_notify(bus, address, len);
+  }
+  return true;
+}
+
+static void bus_fault(bus_t *bus, uint16_t address, access_t atype,
+                      bool write) {
+  if (bus->bus_fault_cb != NULL) {
+    bus->bus_fault_cb(bus->user, address, atype, write);
+  } else {
+    fprintf(stderr, "%04X\t[UNMAPPED %s %s]\n", address,
+            atype == WORD ? "WORD" : "BYTE", write ? "WRITE" : "READ");
+  }
+}
+
+/* Words are split into bytes where the two bytes are not handled the same
+ * way: one is in host memory, or they belong to different devices */
+static bool split_word(const bus_t *bus, uint16_t address, access_t atype,
+                       uint8_t *const *pages) {
+  uint16_t next = address + 1;
+
+  return atype == WORD &&
+         (pages[address >> MEM_PAGE_SHIFT] != NULL ||
+          pages[next >> MEM_PAGE_SHIFT] != NULL ||
+          bus->device_map[address] != bus->device_map[next]);
+}
+
+uint16_t bus_read(bus_t *bus, uint16_t address, access_t atype) {
+  const bus_device_t *device = &bus->devices[bus->device_map[address]];
   uint8_t tmp[2];
-  uint16_t res;
-  if (atype == WORD) {
-    read_memory_cb(address, tmp, 2);
-    res = pack16(tmp);
-  } else if (atype == BYTE) {
-    read_memory_cb(address, tmp, 1);
-    res = tmp[0];
-  }
-  return res;
+
+  if (split_word(bus, address, atype, bus->read_pages)) {
+    return mem_read(bus, address, BYTE) | mem_read(bus, address + 1, BYTE) << 8;
+  }
+
+  if (device != bus->devices) {
+    if (device->read != NULL) {
+      return device->read(device->context, address - device->base, atype);
+    }
+  } else if (bus->read_memory_cb != NULL) {
+    if (atype == WORD) {
+      bus->read_memory_cb(bus->user, address, tmp, 2);
+      return pack16(tmp);
+    }
+    bus->read_memory_cb(bus->user, address, tmp, 1);
+    return tmp[0];
+  }
+
+  bus_fault(bus, address, atype, false);
+  return atype == WORD ? VACANT_MEMORY
+                       : (VACANT_MEMORY >> 8 * (address & 1)) & 0xFF;
 }
 
-void mem_write(uint16_t address, uint16_t val, access_t atype) {
-  assert(write_memory_cb != NULL);
+void bus_write(bus_t *bus, uint16_t address, uint16_t val, access_t atype) {
+  const bus_device_t *device = &bus->devices[bus->device_map[address]];
   uint8_t data[2];
-  if (atype == WORD) {
-    unpack16(data, val);
-    write_memory_cb(address, data, 2);
-  } else if (atype == BYTE) {
-    data[0] = val;
-    write_memory_cb(address, data, 1);
+  uint16_t page = address >> MEM_PAGE_SHIFT;
+
+  // First write to a protected page: report it, then write as usual
+  if (bus->protected_pages[page] != NULL) {
+    bus->write_pages[page] = bus->protected_pages[page];
+    bus->protected_pages[page] = NULL;
+    bus->page_write_cb(bus->page_context, page);
+    mem_write(bus, address, val, atype);
+    return;
   }
+
+  if (split_word(bus, address, atype, bus->write_pages)) {
+    mem_write(bus, address, val & 0xFF, BYTE);
+    mem_write(bus, address + 1, val >> 8, BYTE);
+    return;
+  }
+
+  if (device != bus->devices) {
+    if (device->write == NULL) {
+      bus_fault(bus, address, atype, true);
+      return;
+    }
+    device->write(device->context, address - device->base, val, atype);
+  } else if (bus->write_memory_cb != NULL) {
+    if (atype == WORD) {
+      unpack16(data, val);
+      bus->write_memory_cb(bus->user, address, data, 2);
+    } else {
+      data[0] = val;
+      bus->write_memory_cb(bus->user, address, data, 1);
+    }
+  } else {
+    bus_fault(bus, address, atype, true);
+    return;
+  }
+
+  mem_write_notify(bus, address, atype == WORD ? 2 : 1);
 }
 
-/**
- * @brief Get a pointer to the register specified by the numeric register
- * value
- * @param cpu A pointer to the CPU structure
- * @param reg The numeric value of the register
- * @return Pointer to the register in question, NULL if register doesn't exist
- */
-int16_t *get_reg_ptr(Cpu *cpu, uint8_t reg) {
-
-  switch (reg) {
-  case 0x0:
-    return &cpu->pc;
-  case 0x1:
-    return &cpu->sp;
-  case 0x2:
-    return &cpu->sr;
-  case 0x3:
-    return &cpu->cg2;
-  case 0x4:
-    return &cpu->r4;
-  case 0x5:
-    return &cpu->r5;
-  case 0x6:
-    return &cpu->r6;
-  case 0x7:
-    return &cpu->r7;
-  case 0x8:
-    return &cpu->r8;
-  case 0x9:
-    return &cpu->r9;
-  case 0xA:
-    return &cpu->r10;
-  case 0xB:
-    return &cpu->r11;
-  case 0xC:
-    return &cpu->r12;
-  case 0xD:
-    return &cpu->r13;
-  case 0xE:
-    return &cpu->r14;
-  case 0xF:
-    return &cpu->r15;
+/* Longest write transaction of a burst. Writes are copied, since the
+ * callback gets a buffer it may modify */
+#define BURST_BYTES 256
+
+/* Bytes from address on, up to len, that go to the memory callbacks: no
+ * host memory, protected or not, no device, and no wrap around the end of
+ * the address space */
+static size_t callback_run(const bus_t *bus, uint16_t address, size_t len,
+                           uint8_t *const *pages, bool present) {
+  size_t n = 0;
+
+  while (present && n < len && address + n < 0x10000 &&
+         pages[(address + n) >> MEM_PAGE_SHIFT] == NULL &&
+         bus->protected_pages[(address + n) >> MEM_PAGE_SHIFT] == NULL &&
+         bus->device_map[address + n] == 0) {
+    n++;
+  }
+  return n;
+}
 
-  default: {
-    puts("Invalid Register Number");
-    return 0;
+void mem_read_words(bus_t *bus, uint16_t address, uint16_t *words,
+                    size_t count) {
+  size_t i = 0, n, j;
+
+  while (i < count) {
+    uint16_t a = address + 2 * i;
+
+    n = callback_run(bus, a, 2 * (count - i), bus->read_pages,
+                     bus->read_memory_cb != NULL) /
+        2;
+    if (n < 2) {
+      words[i++] = mem_read(bus, a, WORD);
+      continue;
+    }
+
+    // Read into the words themselves, then unpack in place
+    bus->read_memory_cb(bus->user, a, (uint8_t *)&words[i], 2 * n);
+    for (j = i; j < i + n; j++) {
+      words[j] = pack16((const uint8_t *)&words[j]);
+    }
+    i += n;
   }
+}
+
+void mem_write_words(bus_t *bus, uint16_t address, const uint16_t *words,
+                     size_t count) {
+  uint8_t data[BURST_BYTES];
+  size_t i = 0, n, j;
+
+  while (i < count) {
+    uint16_t a = address + 2 * i;
+
+    n = callback_run(bus, a, 2 * (count - i), bus->write_pages,
+                     bus->write_memory_cb != NULL) /
+        2;
+    if (n < 2) {
+      mem_write(bus, a, words[i++], WORD);
+      continue;
+    }
+
+    if (n > sizeof data / 2) {
+      n = sizeof data / 2;
+    }
+    for (j = 0; j < n; j++) {
+      unpack16(&data[2 * j], words[i + j]);
+    }
+    bus->write_memory_cb(bus->user, a, data, 2 * n);
+    mem_write_notify(bus, a, 2 * n);
+    i += n;
+  }
+}
+
+void mem_read_bytes(bus_t *bus, uint16_t address, uint8_t *bytes, size_t len) {
+  size_t i = 0, n;
+
+  while (i < len) {
+    uint16_t a = address + i;
+
+    n = callback_run(bus, a, len - i, bus->read_pages,
+                     bus->read_memory_cb != NULL);
+    if (n < 2) {
+      bytes[i++] = mem_read(bus, a, BYTE);
+      continue;
+    }
+
+    bus->read_memory_cb(bus->user, a, &bytes[i], n);
+    i += n;
+  }
+}
+
+void mem_write_bytes(bus_t *bus, uint16_t address, const uint8_t *bytes,
+                     size_t len) {
+  uint8_t data[BURST_BYTES];
+  size_t i = 0, n;
+
+  while (i < len) {
+    uint16_t a = address + i;
+
+    n = callback_run(bus, a, len - i, bus->write_pages,
+                     bus->write_memory_cb != NULL);
+    if (n < 2) {
+      mem_write(bus, a, bytes[i++], BYTE);
+      continue;
+    }
+
+    if (n > sizeof data) {
+      n = sizeof data;
+    }
+    memcpy(data, &bytes[i], n);
+    bus->write_memory_cb(bus->user, a, data, n);
+    mem_write_notify(bus, a, n);
+    i += n;
   }
 }
 
@@ -37,35 +37,273 @@ struct istruct {
 typedef struct istruct instruction_t;
 
 void reg_num_to_name(uint8_t source_reg, char *reg_name);
-int16_t *get_reg_ptr(Cpu *cpu, uint8_t reg);
 
-void set_write_memory_cb(void (*fptr)(const uint32_t, uint8_t *const, size_t));
-void set_read_memory_cb(void (*fptr)(const uint32_t, uint8_t *const, size_t));
-
-void set_consume_cycles_cb(void (*functionPtr)(uint16_t));
-void set_register_read_notify_cb(void (*functionPtr)(uint16_t));
-void set_register_write_notify_cb(void (*functionPtr)(uint16_t));
 uint16_t pack16(const uint8_t *const data);
 void unpack16(uint8_t *const out, const uint16_t in);
 
-extern void (*consume_cycles_cb)(uint16_t);
-extern void (*register_read_notify_cb)(uint16_t);
-extern void (*register_write_notify_cb)(uint16_t);
+/* Host memory is mapped in pages of this many bytes */
+#define MEM_PAGE_SHIFT 6
+#define MEM_PAGE_SIZE (1u << MEM_PAGE_SHIFT)
+#define MEM_PAGES (0x10000 >> MEM_PAGE_SHIFT)
+
+/* Handlers of a peripheral mapped with map_device(). The offset is from the
+ * start of the device's range */
+typedef uint16_t (*device_read_t)(void *context, uint16_t offset,
+                                  access_t atype);
+typedef void (*device_write_t)(void *context, uint16_t offset, uint16_t val,
+                               access_t atype);
+
+/* Most devices mapped at a time */
+#define BUS_DEVICES 255
+
+/* What reads of unmapped memory return, as on the MSP430 (JMP $) */
+#define VACANT_MEMORY 0x3FFF
+
+typedef struct bus_device {
+  device_read_t read;
+  device_write_t write;
+  void *context;
+  uint16_t base;
+} bus_device_t;
+
+/* The address space of one emulated MCU. All-zero is an empty bus, on which
+ * every access is a bus fault. Buses share nothing, so that each can be used
+ * from its own thread */
+typedef struct bus {
+  void *user; /* Passed to the memory and bus fault callbacks */
+  void (*read_memory_cb)(void *user, uint32_t address, uint8_t *data,
+                         size_t len);
+  void (*write_memory_cb)(void *user, uint32_t address, uint8_t *data,
+                          size_t len);
+  void (*bus_fault_cb)(void *user, uint16_t address, access_t atype,
+                       bool write);
+
+  /* Observer for every write that changes memory, through mem_write() or
+   * the mapping functions below. msp430_create() installs the one that
+   * keeps decoded code coherent, embedders hook in with
+   * set_write_notify_cb() */
+  void (*write_notify_cb)(void *context, uint16_t address, size_t len);
+  void *notify_context;
+
+  /* Host memory behind each page, NULL where the callbacks are used. Pages
+   * that are mapped read-only are NULL in write_pages */
+  uint8_t *read_pages[MEM_PAGES];
+  uint8_t *write_pages[MEM_PAGES];
+
+  /* Writable pages that are write-protected, see protect_host_pages() */
+  uint8_t *protected_pages[MEM_PAGES];
+  void (*page_write_cb)(void *context, uint16_t page);
+  void *page_context;
+
+  /* Peripherals, by address. Entry 0 of devices is no device */
+  bus_device_t devices[BUS_DEVICES + 1];
+  uint8_t device_map[0x10000];
+} bus_t;
+
+void set_write_memory_cb(bus_t *bus,
+                         void (*fptr)(void *user, uint32_t address,
+                                      uint8_t *data, size_t len));
+void set_read_memory_cb(bus_t *bus,
+                        void (*fptr)(void *user, uint32_t address,
+                                     uint8_t *data, size_t len));
+
+static inline void mem_write_notify(bus_t *bus, uint16_t address, size_t len) {
+  if (bus->write_notify_cb != NULL) {
+    bus->write_notify_cb(bus->notify_context, address, len);
+  }
+}
+
+/**
+ * @brief Back a range of the address space with host memory, such as RAM,
+ * flash or information memory. The core reads and writes it directly, and
+ * the memory callbacks only see the rest. Words in host memory are stored
+ * little-endian, like the MSP430 and its firmware images, regardless of
+ * TARGET_BIG_ENDIAN. Changes the embedder makes to mapped memory by itself
+ * are not seen by the predecoded instruction cache, see
+ * invalidate_decoded_ops()
+ * @param bus The bus
+ * @param address First address, a multiple of MEM_PAGE_SIZE
+ * @param host Host memory holding len bytes
+ * @param len Number of bytes, a multiple of MEM_PAGE_SIZE
+ * @param writable false to send writes to write_memory_cb, for example flash
+ * that is programmed through a controller
+ * @return false if the range is not page aligned or exceeds the address space
+ */
+bool map_host_memory(bus_t *bus, uint16_t address, uint8_t *host, size_t len,
+                     bool writable);
+
+/**
+ * @brief Return a range mapped with map_host_memory() to the callbacks
+ * @param bus The bus
+ * @param address First address, a multiple of MEM_PAGE_SIZE
+ * @param len Number of bytes, a multiple of MEM_PAGE_SIZE
+ * @return false if the range is not page aligned or exceeds the address space
+ */
+bool unmap_host_memory(bus_t *bus, uint16_t address, size_t len);
+
+/**
+ * @brief Write-protect the writable host memory pages. The first write to
+ * each page after that calls the callback with the page number, before the
+ * write. The page is then writable again. NULL lifts all protection. Used to
+ * find the pages a snapshot has to save, see snapshot.h
+ * @param bus The bus
+ * @param fptr The callback
+ * @param context Passed to the callback
+ */
+void protect_host_pages(bus_t *bus, void (*fptr)(void *context, uint16_t page),
+                        void *context);
+
+/**
+ * @brief Write-protect one writable host memory page again, after its first
+ * write was reported to the callback of protect_host_pages()
+ * @param bus The bus
+ * @param page Page number, address >> MEM_PAGE_SHIFT
+ */
+void protect_host_page(bus_t *bus, uint16_t page);
+
+/**
+ * @brief Get the host memory behind a writable page, whether or not it is
+ * write-protected
+ * @param bus The bus
+ * @param page Page number, address >> MEM_PAGE_SHIFT
+ * @return The page, or NULL if it is not writable host memory
+ */
+uint8_t *writable_host_page(const bus_t *bus, uint16_t page);
+
+/**
+ * @brief Let a peripheral handle the accesses to a range of addresses, in
+ * place of read_memory_cb and write_memory_cb. Word accesses that fall
+ * partly outside the range are split into bytes. A later mapping replaces
+ * an earlier one where they overlap, host memory takes precedence over both
+ * @param bus The bus
+ * @param address First address
+ * @param len Number of bytes
+ * @param read Handler for reads, NULL to trap them as unmapped
+ * @param write Handler for writes, NULL to trap them as unmapped
+ * @param context Passed to the handlers
+ * @return false if the range exceeds the address space, or BUS_DEVICES
+ * devices are mapped already
+ */
+bool map_device(bus_t *bus, uint16_t address, size_t len, device_read_t read,
+                device_write_t write, void *context);
+
+/**
+ * @brief Remove devices mapped with map_device() from a range of addresses
+ * @param bus The bus
+ * @param address First address
+ * @param len Number of bytes
+ * @return false if the range exceeds the address space
+ */
+bool unmap_device(bus_t *bus, uint16_t address, size_t len);
+
+/**
+ * @brief Trap accesses to addresses that neither host memory, a device nor
+ * the memory callbacks handle. Reads return VACANT_MEMORY. Without a
+ * callback, or NULL, they are reported on stderr. To halt the CPU, the
+ * callback can clear cpu->running, or raise an NMI as the MSP430 does for
+ * vacant memory accesses
+ * @param bus The bus
+ * @param fptr The callback, gets the address, access type and whether it
+ * was a write
+ */
+void set_bus_fault_cb(bus_t *bus,
+                      void (*fptr)(void *user, uint16_t address,
+                                   access_t atype, bool write));
+
+/**
+ * @brief Read consecutive words, as if by mem_read() on each. Stretches of
+ * addresses that read_memory_cb handles are read in a single call, for buses
+ * where a transaction has a high fixed cost
+ * @param bus The bus
+ * @param address Address of the first word
+ * @param words Receives count values in host endianness
+ * @param count Number of words
+ */
+void mem_read_words(bus_t *bus, uint16_t address, uint16_t *words,
+                    size_t count);
+
+/**
+ * @brief Write consecutive words, as if by mem_write() on each, see
+ * mem_read_words()
+ * @param bus The bus
+ * @param address Address of the first word
+ * @param words count values in host endianness
+ * @param count Number of words
+ */
+void mem_write_words(bus_t *bus, uint16_t address, const uint16_t *words,
+                     size_t count);
 
 /**
- * @brief Read memory value from SystemC bus. Returns data in host endianness
+ * @brief Read consecutive bytes, as if by mem_read() on each, see
+ * mem_read_words()
+ * @param bus The bus
+ * @param address Address of the first byte
+ * @param bytes Receives len bytes
+ * @param len Number of bytes
+ */
+void mem_read_bytes(bus_t *bus, uint16_t address, uint8_t *bytes, size_t len);
+
+/**
+ * @brief Write consecutive bytes, as if by mem_write() on each, see
+ * mem_read_words()
+ * @param bus The bus
+ * @param address Address of the first byte
+ * @param bytes len bytes
+ * @param len Number of bytes
+ */
+void mem_write_bytes(bus_t *bus, uint16_t address, const uint8_t *bytes,
+                     size_t len);
+
+/* Accesses that mem_read() and mem_write() do not handle inline: pages that
+ * are not host memory, and words that straddle two pages */
+uint16_t bus_read(bus_t *bus, uint16_t address, access_t atype);
+void bus_write(bus_t *bus, uint16_t address, uint16_t val, access_t atype);
+
+/**
+ * @brief Read memory value from SystemC bus, or from host memory mapped with
+ * map_host_memory(). Returns data in host endianness
+ * @param bus The bus
  * @param address address to read from
  * @param atype access type (byte or word)
  * @return value in host endianness
  */
-uint16_t mem_read(uint16_t address, access_t atype);
+static inline uint16_t mem_read(bus_t *bus, uint16_t address, access_t atype) {
+  const uint8_t *page = bus->read_pages[address >> MEM_PAGE_SHIFT];
+  uint16_t offset = address & (MEM_PAGE_SIZE - 1);
+
+  if (page != NULL) {
+    if (atype == BYTE) {
+      return page[offset];
+    } else if (offset != MEM_PAGE_SIZE - 1) {
+      return page[offset] | (uint16_t)page[offset + 1] << 8;
+    }
+  }
+  return bus_read(bus, address, atype);
+}
 
 /**
- * @brief Write memory value to SystemC bus. Accepts data in host endianness
+ * @brief Write memory value to SystemC bus, or to host memory mapped with
+ * map_host_memory(). Accepts data in host endianness
+ * @param bus The bus
  * @param address address to read from
  * @param val value to write, in host endianness
  * @param atype access type (byte or word)
  */
-void mem_write(uint16_t address, uint16_t val, access_t);
+static inline void mem_write(bus_t *bus, uint16_t address, uint16_t val,
+                             access_t atype) {
+  uint8_t *page = bus->write_pages[address >> MEM_PAGE_SHIFT];
+  uint16_t offset = address & (MEM_PAGE_SIZE - 1);
+
+  if (page == NULL || (atype == WORD && offset == MEM_PAGE_SIZE - 1)) {
+    bus_write(bus, address, val, atype);
+    return;
+  }
+
+  page[offset] = val;
+  if (atype == WORD) {
+    page[offset + 1] = val >> 8;
+  }
+  mem_write_notify(bus, address, atype == WORD ? 2 : 1);
+}
 
 #endif